@@ -0,0 +1,112 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <streambuf>
+
+#include "json_writer.h"
+
+//
+// Writes records like pstrip's, nested deeper than the writer's fast
+// path now and then, to a stream which discards them, and counts the
+// heap allocations the writer makes along the way. Once the first record
+// has sized everything, there should be none; if there are any, it says
+// so and fails.
+//
+
+namespace {
+  unsigned long allocations = 0;
+
+  class Null_buf: public std::streambuf {
+  protected:
+    std::streamsize xsputn(const char*, std::streamsize n) { return n; }
+    int overflow(int c) { return c; }
+  };
+
+  constexpr JSON_key PATH(JSON_key::plain("path"));
+  constexpr JSON_key DISPLAY_PATH(JSON_key::plain("display path"));
+  constexpr JSON_key IDENTIFIER(JSON_key::plain("identifier"));
+  constexpr JSON_key SETS(JSON_key::plain("sets"));
+  constexpr JSON_key ENTRY_TYPE(JSON_key::plain("entry type"));
+  constexpr JSON_key VALUE_TYPE(JSON_key::plain("value type"));
+  constexpr JSON_key SUBJECT(JSON_key::plain("MESSAGE_SUBJECT"));
+  constexpr JSON_key NESTED(JSON_key::plain("nested"));
+
+  const unsigned int ENTRIES = 10;
+  const unsigned int DEEP = 100;
+
+  void write_record(JSON_writer& json, unsigned long i) {
+    json.object_open();
+    json.object_member_write(PATH, "/x.pst/0/1/2");
+    json.object_member_write(DISPLAY_PATH, "/x.pst/Inbox/Sub/hello \"world\"");
+    json.object_member_write(IDENTIFIER, (uint32_t) i);
+
+    json.array_member_open(SETS);
+    json.array_open();
+    for (unsigned int e = 0; e < ENTRIES; ++e) {
+      json.object_open();
+      json.object_member_write(ENTRY_TYPE, (uint32_t) 0x37);
+      json.object_member_write(VALUE_TYPE, (uint32_t) 0x1f);
+      json.object_member_write(SUBJECT, "Re: the quarterly numbers\n");
+      json.object_close();
+    }
+    json.array_close();
+    json.array_member_close();
+
+    // past the 64 scopes of the fast path
+    if (i % 100 == 0) {
+      for (unsigned int d = 0; d < DEEP; ++d) {
+        json.object_member_open(NESTED);
+      }
+      for (unsigned int d = 0; d < DEEP; ++d) {
+        json.object_member_close();
+      }
+    }
+
+    json.object_close();
+    json.reset();
+  }
+}
+
+void* operator new(size_t size) {
+  ++allocations;
+  if (void* p = std::malloc(size ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+  std::free(p);
+}
+
+int main(int argc, char** argv) {
+  const unsigned long records = argc > 1 ? std::strtoul(argv[1], 0, 10) : 200000;
+
+  Null_buf buf;
+  std::ostream out(&buf);
+  JSON_writer json(out);
+
+  // the first record sizes the writer's state
+  write_record(json, 0);
+
+  const unsigned long before = allocations;
+  const std::chrono::steady_clock::time_point start(std::chrono::steady_clock::now());
+
+  for (unsigned long i = 1; i <= records; ++i) {
+    write_record(json, i);
+  }
+
+  const std::chrono::duration<double, std::nano> elapsed(std::chrono::steady_clock::now() - start);
+  const unsigned long made = allocations - before;
+
+  std::cout << records << " records, "
+            << elapsed.count() / (records ? records : 1) << " ns each, "
+            << made << " allocations" << std::endl;
+
+  return made ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include "arrow_writer.h"
+
+//
+// One decoded property value, destined for an Arrow column.
+//
+struct Arrow_cell {
+  Arrow_cell(): type(NONE), integer(0), real(0.0) {}
+
+  // NONE is a missing value; the rest are Arrow_writer::Type + 1
+  enum Type { NONE, INT32, INT64, DOUBLE, BOOL, TIMESTAMP, BINARY, UTF8 };
+
+  Type type;
+  int64_t integer;
+  double real;
+  std::string bytes;
+};
+
+//
+// Exports items as Arrow IPC files, one per item type, with a row per
+// item and set, and a column per selected entry type. Since the value
+// type of an entry type isn't known up front, each table holds back its
+// first batch of rows and takes each column's type from the first value
+// in it; columns without any value there become UTF8. Values which turn
+// out not to match their column's type are written as null and counted.
+//
+class Arrow_export {
+public:
+  Arrow_export(const std::string& dir,
+               const std::vector<uint32_t>& entry_types,
+               const std::vector<std::string>& column_names,
+               size_t batch_size);
+
+  static const size_t NPOS = size_t(-1);
+
+  // the column for an entry type, or NPOS if it wasn't selected
+  size_t column(uint32_t etype) const {
+    std::unordered_map<uint32_t, size_t>::const_iterator i(columns.find(etype));
+    return i == columns.end() ? NPOS : i->second;
+  }
+
+  size_t column_count() const { return names.size(); }
+
+  void add_row(const std::string& table, const std::string& path,
+               uint32_t identifier, uint32_t set,
+               const std::vector<Arrow_cell>& cells);
+
+  void close();
+
+  // values written as null because of a type mismatch, by column
+  const std::map<std::string, unsigned long>& mismatches() const {
+    return mismatched;
+  }
+
+private:
+  struct Row {
+    std::string path;
+    uint32_t identifier;
+    uint32_t set;
+    std::vector<Arrow_cell> cells;
+  };
+
+  struct Table {
+    boost::shared_ptr<Arrow_writer> writer;
+    std::vector<Row> pending;
+  };
+
+  void open_table(const std::string& name, Table& table);
+
+  void write_row(Arrow_writer& writer, const Row& row);
+
+  std::string dir;
+  std::unordered_map<uint32_t, size_t> columns;
+  std::vector<std::string> names;
+  size_t batch_size;
+
+  std::map<std::string, Table> tables;
+  std::map<std::string, unsigned long> mismatched;
+};
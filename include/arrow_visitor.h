@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "arrow_export.h"
+#include "pstrip.h"
+
+struct Context;
+
+//
+// Exports a row per item and set to an Arrow_export, with the values of
+// the selected entry types as its cells. Only the selected entries'
+// values are decoded, and multi-value ones aren't. Errors go to
+// ctx.errors.
+//
+class Arrow_visitor: public Pst_visitor {
+public:
+  Arrow_visitor(Arrow_export& a, Context& c):
+    arrow(a), ctx(c), col(0), multi_valued(a.column_count(), false) {}
+
+  void set_begin(const Pst_item& item, uint32_t set);
+
+  bool entry_type(const Pst_item& item, const Pst_entry& entry);
+
+  void value(const Pst_item& item, const Pst_entry& entry, const Pst_value& v);
+
+  void set_end(const Pst_item& item, uint32_t set);
+  void values_end(const Pst_item& item);
+  void item_end(const Pst_item& item);
+
+  void error(const Pst_error& e);
+
+private:
+  Arrow_export& arrow;
+  Context& ctx;
+
+  // the row being filled, and the column of the entry being decoded
+  std::vector<Arrow_cell> cells;
+  size_t col;
+
+  // columns with multi-value entries, which are reported once, for the
+  // first item with one, and left null
+  std::vector<bool> multi_valued;
+};
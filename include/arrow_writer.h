@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+//
+// Writes one table as an Arrow IPC file (Feather v2), without any Arrow
+// library: the flatbuffer metadata is built by hand. Rows are appended
+// a value at a time and written as a record batch every batch_size rows.
+//
+class Arrow_writer {
+public:
+  enum Type { INT32, INT64, DOUBLE, BOOL, TIMESTAMP, BINARY, UTF8 };
+
+  struct Column {
+    std::string name;
+    Type type;
+  };
+
+  Arrow_writer(const std::string& filename,
+               const std::vector<Column>& columns,
+               size_t batch_size);
+
+  ~Arrow_writer();
+
+  Arrow_writer(const Arrow_writer&) = delete;
+  Arrow_writer& operator=(const Arrow_writer&) = delete;
+
+  const std::vector<Column>& schema() const { return cols; }
+
+  // Each row gets exactly one value or null per column, in any order,
+  // followed by end_row(). Values must match the column type: append()
+  // with an int64_t for INT32, INT64 and TIMESTAMP (microseconds since
+  // the Unix epoch), with a double for DOUBLE, a bool for BOOL and bytes
+  // for BINARY and UTF8.
+  void append_null(size_t col);
+  void append(size_t col, int64_t value);
+  void append(size_t col, double value);
+  void append(size_t col, bool value);
+  void append(size_t col, const uint8_t* value, size_t length);
+
+  void end_row();
+
+  // Writes any pending rows and the footer.
+  void close();
+
+private:
+  struct Builder {
+    Builder(): null_count(0) {}
+
+    std::vector<uint8_t> validity;
+    std::vector<uint8_t> data;
+    std::vector<int32_t> offsets;
+    int64_t null_count;
+  };
+
+  struct Block {
+    int64_t offset;
+    int32_t metadata_length;
+    int64_t body_length;
+  };
+
+  void set_valid(size_t col, bool valid);
+
+  void write_batch();
+
+  Block write_message(const std::vector<uint8_t>& metadata,
+                      const std::vector<uint8_t>& body);
+
+  void reset_builders();
+
+  std::ofstream out;
+  std::vector<Column> cols;
+  size_t batch_size;
+
+  std::vector<Builder> builders;
+  int64_t rows;
+
+  std::vector<Block> batches;
+  int64_t position;
+  bool closed;
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "decode_error.h"
+
+// what to make of MESSAGE_BODY_COMPRESSED_RTF values
+enum Rtf_mode {
+  RTF_COMPRESSED,   // the compressed blob, as for any binary value
+  RTF_DECOMPRESSED, // the RTF
+  RTF_BODY          // the HTML or text the RTF encapsulates, if any
+};
+
+//
+// Decompresses an LZFu (or uncompressed "MELA") RTF blob, as described
+// in MS-OXRTFCP, checking its CRC.
+//
+Decode_error decompress_rtf(const uint8_t* data, size_t len, std::string& rtf);
+
+enum Rtf_encapsulation { RTF_NATIVE, RTF_HTML, RTF_TEXT };
+
+//
+// Recovers the HTML or plain text encapsulated in RTF, as described in
+// MS-OXRTFEX. Returns RTF_NATIVE, leaving body alone, if the RTF does
+// not encapsulate anything. Characters given as code page bytes rather
+// than as \u are decoded for windows-1252, which is what Outlook writes,
+// and replaced with U+FFFD for any other code page.
+//
+Rtf_encapsulation deencapsulate_rtf(const std::string& rtf, std::string& body);
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "compressed_rtf.h"
+#include "decode_error.h"
+#include "error_log.h"
+#include "pff.h"
+#include "pstrip.h"
+
+class Filetime_format;
+class JSON_writer;
+class Named_properties;
+class Seen_set;
+
+//
+// Everything item processing needs besides the item: where records and
+// errors go, how values are rendered, and the state shared by every
+// handle on the PST.
+//
+struct Context {
+  Context(JSON_writer& j, Error_log& e, Named_properties& n, Filetime_format& t):
+    json(j), errors(e), names(n), name_dictionary(false), times(t),
+    semantic(false), rtf(RTF_COMPRESSED), seen(0), cancel(0) {}
+
+  JSON_writer& json;
+  Error_log& errors;
+
+  // shared by every handle on the PST, so IDs are the same for all
+  Named_properties& names;
+
+  // when set, named properties are written by ID, and the names once,
+  // in a dictionary at the end
+  bool name_dictionary;
+
+  Filetime_format& times;
+
+  // when set, item types with an extractor get one compact record each
+  bool semantic;
+
+  Rtf_mode rtf;
+
+  // if set, emails already in it get a short reference record instead of
+  // their own, and the rest are added to it
+  Seen_set* seen;
+
+  // if set, the work is abandoned at the next item once *cancel is true
+  const std::atomic<bool>* cancel;
+};
+
+inline void check_cancel(const Context& ctx) {
+  if (ctx.cancel && *ctx.cancel) {
+    throw Cancelled();
+  }
+}
+
+inline void report(Context& ctx, const char* category, const std::string& path, const Decode_error& e, long s = Error_log::NONE, long en = Error_log::NONE, long i = Error_log::NONE) {
+  // the message is formatted only if the error will actually be written
+  if (ctx.errors.admit(category)) {
+    ctx.errors.write(category, path, s, en, i, e.line(), e.message());
+  }
+}
+
+inline void report(Context& ctx, const char* category, const std::string& path, const libpff_error& e, long s = Error_log::NONE, long en = Error_log::NONE, long i = Error_log::NONE) {
+  ctx.errors.report(category, path, s, en, i, e.line(), e.message());
+}
+
+inline void report(Context& ctx, const Pst_error& e) {
+  if (ctx.errors.admit(e.category())) {
+    ctx.errors.write(e.category(), e.path(), e.set(), e.entry(), e.element(), e.line(), e.message());
+  }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <ostream>
+#include <string>
+
+#include <boost/function.hpp>
+
+//
+// A job, as requested: the members of a flat JSON object, with strings
+// unescaped and other values as they were written.
+//
+typedef std::map<std::string, std::string> Job_request;
+
+// Throws std::runtime_error if line is not a flat JSON object.
+Job_request parse_job_request(const std::string& line);
+
+//
+// Runs a job, writing its output to out. cancel is set when the job is
+// cancelled, and the runner should then give up as soon as it can.
+//
+typedef boost::function<
+  void (const Job_request& req, std::ostream& out, const std::atomic<bool>& cancel)
+> Job_runner;
+
+//
+// Serves jobs on a UNIX domain socket, with workers running them, until
+// SIGINT or SIGTERM. The socket is only open to the daemon's user. A
+// client sends one request per connection, on one line:
+//
+//   {"id": "a1", "file": "/data/x.pst", ...}
+//
+// The job's output comes back over the connection, unless the request
+// names an "output" file for it in output_dir, which jobs can't do if it
+// is empty. Either way, the output is followed by a status record:
+//
+//   {"job": "a1", "status": "done"|"cancelled"|"failed", "error": ...}
+//
+// after which the connection is closed. Closing the connection early
+// cancels a job writing to it, as of its next write; any job can be
+// cancelled by a request of the form
+//
+//   {"cancel": "a1"}
+//
+// on another connection, which is answered with a status record for the
+// cancel request itself. Only jobs with an "id" can be cancelled that way,
+// and ids must be unique among the jobs queued or running.
+//
+void serve(const std::string& socket_path, unsigned int workers, const std::string& output_dir, const Job_runner& run);
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include <libpff.h>
+
+//
+// A failure in the per-value decode layer. Unlike libpff_error, this is
+// returned rather than thrown, and the libpff error is only formatted
+// into a message if someone asks for it, i.e., if the error is actually
+// written.
+//
+class Decode_error {
+public:
+  Decode_error(): error(0), text(0), src_line(0) {}
+
+  Decode_error(libpff_error_t*& e, uint32_t line):
+    error(e), text(0), src_line(line)
+  {
+    e = 0;
+  }
+
+  Decode_error(const char* t, uint32_t line):
+    error(0), text(t), src_line(line) {}
+
+  Decode_error(Decode_error&& other):
+    error(other.error), text(other.text), src_line(other.src_line)
+  {
+    other.error = 0;
+    other.text = 0;
+  }
+
+  Decode_error& operator=(Decode_error&& other) {
+    std::swap(error, other.error);
+    std::swap(text, other.text);
+    std::swap(src_line, other.src_line);
+    return *this;
+  }
+
+  Decode_error(const Decode_error&) = delete;
+  Decode_error& operator=(const Decode_error&) = delete;
+
+  ~Decode_error() {
+    if (error) {
+      libpff_error_free(&error);
+    }
+  }
+
+  bool failed() const { return error || text; }
+
+  uint32_t line() const { return src_line; }
+
+  std::string message() const {
+    if (error) {
+      char buf[MAXLEN];
+      libpff_error_sprint(error, buf, MAXLEN);
+      return buf;
+    }
+
+    return text ? text : "";
+  }
+
+private:
+  static const size_t MAXLEN = 1024;
+
+  libpff_error_t* error;
+  const char* text;
+  uint32_t src_line;
+};
+
+//
+// Either a decoded value or the Decode_error explaining why there isn't
+// one.
+//
+template <typename T> class Decoded {
+public:
+  Decoded(const T& v): val(v) {}
+
+  Decoded(Decode_error&& e): val(), err(std::move(e)) {}
+
+  bool ok() const { return !err.failed(); }
+
+  const T& value() const { return val; }
+
+  Decode_error& error() { return err; }
+
+private:
+  T val;
+  Decode_error err;
+};
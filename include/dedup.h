@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+struct Context;
+struct Pst_item;
+
+// A 128-bit hash identifying a message across PSTs.
+struct Fingerprint {
+  Fingerprint(): hi(0), lo(0) {}
+
+  bool operator==(const Fingerprint& o) const { return hi == o.hi && lo == o.lo; }
+
+  // as 32 hex digits
+  std::string hex() const;
+
+  uint64_t hi;
+  uint64_t lo;
+};
+
+struct Fingerprint_hash {
+  size_t operator()(const Fingerprint& fp) const { return fp.lo; }
+};
+
+//
+// Sets fp to the fingerprint of an email, from the Message-ID in its
+// transport headers, its client submit time, sender, subject and plain
+// text body, with case and whitespace normalized where they may differ
+// between copies. Returns false for items of any other type, emails with
+// neither a Message-ID nor a submit time, and emails which couldn't be
+// read, the errors for which go to ctx.
+//
+bool message_fingerprint(const Pst_item& item, Fingerprint& fp, Context& ctx);
+
+//
+// The fingerprints seen so far, safe to share between threads. If given
+// a journal file, the set starts out with the fingerprints in it, and
+// adds those it sees to it, so runs one after another share the set.
+// The journal is a plain sequence of 16-byte fingerprints.
+//
+class Seen_set {
+public:
+  explicit Seen_set(const char* journal = 0);
+
+  Seen_set(const Seen_set&) = delete;
+  Seen_set& operator=(const Seen_set&) = delete;
+
+  // Returns whether fp is new, adding it if so. It goes to the journal
+  // only once committed, when its record has been written, and erase
+  // takes back one which never was.
+  bool insert(const Fingerprint& fp);
+  void commit(const Fingerprint& fp);
+  void erase(const Fingerprint& fp);
+
+  // Writes out the journal's buffer.
+  void flush();
+
+private:
+  static const size_t SHARDS = 64;
+
+  // one lock per shard, so threads seldom wait on each other
+  struct Shard {
+    std::mutex mutex;
+    std::unordered_set<Fingerprint, Fingerprint_hash> seen;
+  };
+
+  Shard shards[SHARDS];
+
+  std::mutex journal_mutex;
+  std::ofstream out;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class JSON_writer;
+
+struct Error_record {
+  std::string category;
+  std::string path;
+  long set;
+  long entry;
+  long element;
+  uint32_t line;
+  std::string message;
+};
+
+//
+// Collects errors as structured records instead of flushing a line to
+// std::cerr for each one. Records are written either as NDJSON to a
+// buffered stream, or held back and emitted into the main output as
+// error records after the item during which they occurred. At most
+// limit records are written per category; the rest are only counted,
+// and the counts are written by write_summary().
+//
+class Error_log {
+public:
+  Error_log(std::ostream& o, unsigned long limit);
+  Error_log(JSON_writer& j, unsigned long limit);
+
+  static const long NONE = -1;
+
+  // Counts an error against its category and returns whether it is to
+  // be written; formatting its message can be skipped otherwise.
+  bool admit(const char* category);
+
+  // Writes an error which has been admitted.
+  void write(const char* category, const std::string& path,
+             long set, long entry, long element,
+             uint32_t line, const std::string& message);
+
+  void report(const char* category, const std::string& path,
+              long set, long entry, long element,
+              uint32_t line, const std::string& message);
+
+  void report(const char* category, const std::string& path,
+              uint32_t line, const std::string& message)
+  {
+    report(category, path, NONE, NONE, NONE, line, message);
+  }
+
+  void flush_pending();
+
+  // Writes the pending errors but those with path, which belong to the
+  // item whose record is about to be written, and follow it.
+  void flush_pending_except(const std::string& path);
+
+  void write_summary();
+
+  void flush();
+
+private:
+  struct Counts {
+    Counts(): reported(0), suppressed(0) {}
+
+    unsigned long reported;
+    unsigned long suppressed;
+  };
+
+  void write_ndjson(const Error_record& rec);
+  void write_inline(const Error_record& rec);
+
+  std::ostream* out;
+  JSON_writer* json;
+  unsigned long limit;
+
+  // transparent comparison, so lookups by category need no std::string
+  typedef std::map<std::string, Counts, std::less<> > Count_map;
+
+  Count_map counts;
+  std::vector<Error_record> pending;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//
+// Renders FILETIMEs (100ns ticks since 1601-01-01 UTC) as JSON values:
+// as the raw tick count, as an RFC 3339 string, or as nanoseconds since
+// the Unix epoch. Dates are computed arithmetically rather than with
+// gmtime, and the date part of the last string is kept, since items
+// processed in sequence mostly share a day.
+//
+class Filetime_format {
+public:
+  enum Style { TICKS, RFC3339, EPOCH_NS };
+
+  Filetime_format(Style s);
+
+  Style style() const { return sty; }
+
+  // enough for any value in any style
+  static const size_t MAXLEN = 40;
+
+  // Writes ft as a JSON value to buf, which must hold MAXLEN chars, and
+  // returns its length.
+  size_t format(uint64_t ft, char* buf);
+
+private:
+  size_t format_rfc3339(uint64_t ft, char* buf);
+
+  Style sty;
+
+  // the day the date prefix is for, in days since 1601-01-01
+  uint64_t day;
+  char date[16];
+  size_t date_len;
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <string>
+#include <utility>
+
+#include <boost/shared_ptr.hpp>
+
+//
+// Keeps up to capacity idle handles open, by key, so they can be taken
+// again instead of reopened; the least recently given back are closed
+// first. A handle is used by one taker at a time, so several jobs on the
+// same file each get their own. Capacities are small, so lookups are
+// linear.
+//
+template <typename T> class Handle_cache {
+public:
+  typedef boost::shared_ptr<T> Ptr;
+
+  explicit Handle_cache(size_t c): capacity(c) {}
+
+  // An idle handle for key, or an empty pointer if there is none.
+  Ptr take(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (typename List::iterator i(idle.begin()); i != idle.end(); ++i) {
+      if (i->first == key) {
+        Ptr h(i->second);
+        idle.erase(i);
+        return h;
+      }
+    }
+
+    return Ptr();
+  }
+
+  // Makes a handle for key idle again.
+  void give(const std::string& key, const Ptr& h) {
+    List evicted;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      idle.push_front(std::make_pair(key, h));
+      while (idle.size() > capacity) {
+        evicted.splice(evicted.end(), idle, --idle.end());
+      }
+    }
+
+    // evicted handles are closed here, outside the lock
+  }
+
+private:
+  // most recently given back first
+  typedef std::list<std::pair<std::string, Ptr> > List;
+
+  std::mutex mutex;
+  size_t capacity;
+  List idle;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+#include <libbfio.h>
+
+#include "mapped_file.h"
+
+//
+// A run of bytes in a disk image.
+//
+struct Extent {
+  uint64_t offset;
+  uint64_t length;
+};
+
+typedef std::vector<Extent> Extent_list;
+
+//
+// Reads a fragment list: one extent per line, as a decimal offset and
+// length separated by whitespace. Blank lines and lines starting with
+// '#' are skipped.
+//
+Extent_list read_extents(const char* filename);
+
+//
+// A disk image, opened for reading.
+//
+class Image_file {
+public:
+  explicit Image_file(const char* filename);
+  ~Image_file();
+
+  Image_file(const Image_file&) = delete;
+  Image_file& operator=(const Image_file&) = delete;
+
+  int descriptor() const { return fd; }
+
+  uint64_t size() const { return len; }
+
+private:
+  int fd;
+  uint64_t len;
+};
+
+typedef boost::shared_ptr<Image_file> ImageFilePtr;
+
+//
+// Creates a libbfio handle presenting the extents of an image, in order,
+// as one file. Reads are served from the mapping of the image if there
+// is one, and with pread otherwise. Throws if an extent lies outside the
+// image.
+//
+libbfio_handle_t* create_range_handle(const ImageFilePtr& image,
+                                      const MappedFilePtr& mapped,
+                                      const Extent_list& extents);
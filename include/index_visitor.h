@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+#include "pstrip.h"
+
+class Index_writer;
+
+//
+// Passes everything on to another visitor, indexing the string values of
+// the selected entry types along the way, under their items' identifiers,
+// or for the recipients, attachments and other items under a message,
+// under the message's, since theirs can't be looked up. Values and
+// sub-items are walked for the index even where the other visitor wants
+// none, as with --semantic, without it seeing them or any errors they
+// cause.
+//
+class Index_visitor: public Pst_visitor {
+public:
+  Index_visitor(Pst_visitor& inner, Index_writer& index, const std::vector<uint32_t>& entry_types);
+
+  int item_begin(const Pst_item& item);
+
+  void values_begin(const Pst_item& item, uint32_t sets, uint32_t entries);
+  void set_begin(const Pst_item& item, uint32_t set);
+  void entry_begin(const Pst_item& item, uint32_t set, uint32_t entry);
+
+  bool entry_type(const Pst_item& item, const Pst_entry& entry);
+
+  void value(const Pst_item& item, const Pst_entry& entry, const Pst_value& v);
+
+  void multi_value_begin(const Pst_item& item, const Pst_entry& entry, size_t count);
+  void element(const Pst_item& item, const Pst_entry& entry, size_t i, const Pst_value& v);
+  void multi_value_end(const Pst_item& item, const Pst_entry& entry);
+
+  void entry_end(const Pst_item& item, uint32_t set, uint32_t entry);
+  void set_end(const Pst_item& item, uint32_t set);
+  void values_end(const Pst_item& item);
+
+  void item_end(const Pst_item& item);
+
+  void error(const Pst_error& e);
+
+private:
+  Pst_visitor& inner;
+  Index_writer& index;
+  std::unordered_set<uint32_t> etypes;
+
+  // the items being walked, innermost last
+  struct Frame {
+    // what values are indexed under, if known
+    uint32_t owner;
+    bool owner_known;
+
+    bool folder;
+
+    // whether the other visitor sees the item's sub-items
+    bool inner_sub_items;
+  };
+
+  std::vector<Frame> frames;
+
+  // whether the other visitor wants the current item's values, and the
+  // current entry's value, or errors at this point; and whether the index
+  // wants the current entry's value
+  bool inner_values;
+  bool inner_entry;
+  bool index_entry;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+class JSON_writer;
+
+//
+// What extracting part of a PST would involve: how many items of each
+// type, how many property values, and how many bytes of messages and
+// attachments, by their MESSAGE_SIZE and ATTACHMENT_SIZE.
+//
+struct Inventory_counts {
+  Inventory_counts(): entries(0), message_bytes(0), attachment_bytes(0) {}
+
+  void add(const Inventory_counts& other);
+
+  // Writes the counts as members of the current object.
+  void write(JSON_writer& json) const;
+
+  // by item type name
+  std::map<std::string, unsigned long> items;
+  uint64_t entries;
+  uint64_t message_bytes;
+  uint64_t attachment_bytes;
+};
+
+//
+// A folder in the inventory: the counts for the items in it, down to but
+// not including its subfolders, which have their own.
+//
+struct Inventory_folder {
+  Inventory_folder(): identifier(0) {}
+
+  // Writes the folder as an object, its subfolders nested in it, with the
+  // totals for everything under it; returns those totals.
+  Inventory_counts write(JSON_writer& json) const;
+
+  // As write, but as members of the current object.
+  Inventory_counts write_members(JSON_writer& json) const;
+
+  std::string path;
+  std::string dpath;
+  uint32_t identifier; // 0 if the folder is not an item
+
+  Inventory_counts counts;
+  std::vector<Inventory_folder> folders;
+};
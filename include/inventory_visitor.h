@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+
+#include "inventory.h"
+#include "pstrip.h"
+
+struct Context;
+
+//
+// Counts the items walked into an Inventory_folder, giving each folder
+// among them a subfolder of its own. Of the values, only the numbers of
+// sets and entries, and the sizes, are read; sub-items, attachments and
+// unknowns are counted with the item they are under. Errors go to
+// ctx.errors.
+//
+class Inventory_visitor: public Pst_visitor {
+public:
+  explicit Inventory_visitor(Context& c): ctx(c), base(0) {}
+
+  // Counts the items walked from now on into folder.
+  void count_into(Inventory_folder& folder) { base = &folder; }
+
+  int item_begin(const Pst_item& item);
+  void item_end(const Pst_item& item);
+
+  void error(const Pst_error& e);
+
+private:
+  void count_attachments(const Pst_item& item, Inventory_counts& counts);
+
+  Context& ctx;
+  Inventory_folder* base;
+
+  // where the items begun and not yet ended count what is under them,
+  // innermost last
+  std::vector<Inventory_folder*> open;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "dedup.h"
+#include "pstrip.h"
+
+class JSON_key;
+struct Context;
+
+//
+// Writes a JSON record per item to ctx.json: its path, type, identifier,
+// and every set of entries with their values, rendered as ctx says. With
+// ctx.semantic, items with an extractor get its compact record instead,
+// sub-items included. With ctx.seen, emails get a fingerprint, and those
+// seen before only a reference to it, without values or sub-items; the
+// fingerprint goes to the journal once the item is done. Errors go to
+// ctx.errors, and those held back for inline output follow the record
+// they belong to, or for errors raised while walking an item's sub-items,
+// the records of those.
+//
+class Json_visitor: public Pst_visitor {
+public:
+  explicit Json_visitor(Context& c): ctx(c), sets_open(false) {}
+  ~Json_visitor();
+
+  int item_begin(const Pst_item& item);
+
+  void values_begin(const Pst_item& item, uint32_t sets, uint32_t entries);
+  void set_begin(const Pst_item& item, uint32_t set);
+  void entry_begin(const Pst_item& item, uint32_t set, uint32_t entry);
+
+  bool entry_type(const Pst_item& item, const Pst_entry& entry);
+
+  bool utf16_strings() const { return true; }
+
+  void value(const Pst_item& item, const Pst_entry& entry, const Pst_value& v);
+
+  void multi_value_begin(const Pst_item& item, const Pst_entry& entry, size_t count);
+  void element(const Pst_item& item, const Pst_entry& entry, size_t i, const Pst_value& v);
+  void multi_value_end(const Pst_item& item, const Pst_entry& entry);
+
+  void entry_end(const Pst_item& item, uint32_t set, uint32_t entry);
+  void set_end(const Pst_item& item, uint32_t set);
+  void values_end(const Pst_item& item);
+
+  void item_end(const Pst_item& item);
+
+  void error(const Pst_error& e);
+
+private:
+  void write_duplicate(const Pst_item& item, const Fingerprint& fp);
+  void write_rtf(const Pst_item& item, const Pst_entry& entry, JSON_key key, const Pst_value& v);
+
+  Context& ctx;
+  bool sets_open;
+
+  // the items begun and not yet ended, innermost last
+  struct Open_item {
+    Open_item(): fingerprinted(false) {}
+
+    // whether fp was added to ctx.seen for the item
+    bool fingerprinted;
+    Fingerprint fp;
+  };
+
+  std::vector<Open_item> open;
+};
@@ -1,16 +1,28 @@
 #pragma once
 
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
 #include <ostream>
-#include <stack>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <vector>
 
 class indent {
 public:
   indent(unsigned int d): depth(d) {}
 
   std::ostream& operator()(std::ostream& out) const {
-    for (unsigned int i = 0; i < depth; ++i) {
-      out << ' ';
+    // a run of blanks at a time, deeper indents taking several
+    static const char BLANKS[] = "                                                                ";
+    static const unsigned int RUN = sizeof(BLANKS) - 1;
+
+    for (unsigned int left = depth; left > 0; ) {
+      const unsigned int n = std::min(left, RUN);
+      out.write(BLANKS, n);
+      left -= n;
     }
     return out;
   }
@@ -21,51 +33,68 @@ private:
 
 std::ostream& operator<<(std::ostream& out, indent func);
 
+// Writes the escape sequence for c to out, if it needs one, returning its
+// length, or 0 if c stands for itself.
+size_t json_escape(char c, char* out);
+
+// Writes the len bytes of UTF-8 at s as a JSON string, escaped.
+void write_json_string(std::ostream& out, const char* s, size_t len);
+
 class quote {
 public:
+  quote(std::string_view s): str(s) {}
+
   quote(const std::string& s): str(s) {}
 
   quote(const char* s): str(s) {}
 
   std::ostream& operator()(std::ostream& out) const {
-    out << '"';
-
-// TODO: handle U+0000 - U+001F properly
-    const std::string::const_iterator e(str.end());
-    for (std::string::const_iterator i(str.begin()); i != e; ++i) {
-      switch (*i) {
-      case '"':
-      case '\\':
-        out << '\\' << *i;
-        break;
-      case '\b':
-        out << "\\b";
-        break;
-      case '\f':
-        out << "\\f";
-        break;
-      case '\n':
-        out << "\\n";
-        break;
-      case '\r':
-        out << "\\r";
-        break;
-      case '\t':
-        out << "\\t";
-        break;
-      default:
-        out << *i;
+    write_json_string(out, str.data(), str.size());
+    return out;
+  }
+
+private:
+  std::string_view str;
+};
+
+std::ostream& operator<<(std::ostream& out, quote func);
+
+//
+// The key of an object member. Keys are escaped as they are written,
+// except those made with JSON_key::plain, which have nothing to escape,
+// and are best made once, as constants:
+//
+//   constexpr JSON_key PATH(JSON_key::plain("path"));
+//
+class JSON_key {
+public:
+  constexpr JSON_key(std::string_view k): str(k), escape(true) {}
+
+  constexpr JSON_key(const char* k): str(k), escape(true) {}
+
+  JSON_key(const std::string& k): str(k), escape(true) {}
+
+  // In a constant expression, a key with anything to escape won't compile.
+  static constexpr JSON_key plain(std::string_view k) {
+    for (size_t i = 0; i < k.size(); ++i) {
+      if ((unsigned char) k[i] < 0x20 || k[i] == '"' || k[i] == '\\') {
+        throw std::logic_error("JSON key needs escaping");
       }
     }
 
-    return out << '"';
+    return JSON_key(k, false);
   }
 
+  std::string_view text() const { return str; }
+
+  bool needs_escaping() const { return escape; }
+
 private:
-  std::string str;
-};
+  constexpr JSON_key(std::string_view k, bool e): str(k), escape(e) {}
 
-std::ostream& operator<<(std::ostream& out, quote func);
+  std::string_view str;
+  bool escape;
+};
 
 class JSON_writer {
 public:
@@ -77,44 +106,58 @@ public:
   void array_open();
   void array_close();
 
-  void object_member_open(const std::string& key);
+  void object_member_open(JSON_key key);
   void object_member_close();
 
-  void array_member_open(const std::string& key);
+  void array_member_open(JSON_key key);
   void array_member_close();
 
-  void key_write(const std::string& key);
+  void key_write(JSON_key key);
 
   void value_write_null();
   void value_write_true();
   void value_write_false();
 
   template <typename T> void value_write(const T& value) {
-    out << value;
+    number_write(value);
   }
 
   void value_write(const std::string& value);
+  void value_write(std::string_view value);
   void value_write(char* value);
   void value_write(const char* value);
   void value_write(const unsigned char* value, size_t length);
 
-  template <typename T> void object_member_write(const std::string& key,
+  // writes a value which is already JSON-encoded
+  void value_write_raw(const std::string& json);
+  void value_write_raw(const char* json, size_t length);
+
+  template <typename T> void object_member_write(JSON_key key,
                                                  const T& value)
   {
     key_write(key);
     value_write(value);
   }
 
-  void object_member_write_null(const std::string& key);
-  void object_member_write_true(const std::string& key);
-  void object_member_write_false(const std::string& key);
+  void object_member_write_null(JSON_key key);
+  void object_member_write_true(JSON_key key);
+  void object_member_write_false(JSON_key key);
 
-  void object_member_write(const std::string& key, char* value);
-  void object_member_write(const std::string& key, const char* value);
+  void object_member_write(JSON_key key, char* value);
+  void object_member_write(JSON_key key, const char* value);
 
-  void object_member_write(const std::string& key,
+  void object_member_write(JSON_key key,
                            const unsigned char* value, size_t length);
 
+  // value is a string in UTF-16LE, as in utf16.h
+  void object_member_write_utf16le(JSON_key key,
+                                   const uint8_t* value, size_t size);
+
+  void object_member_write_raw(JSON_key key,
+                               const std::string& json);
+  void object_member_write_raw(JSON_key key,
+                               const char* json, size_t length);
+
   template <typename T> void array_member_write(const T& value) {
     next_element();
     value_write(value);
@@ -125,15 +168,31 @@ public:
   void array_member_write_false();
 
   void array_member_write(const std::string& value);
+  void array_member_write(std::string_view value);
   void array_member_write(char* value);
   void array_member_write(const char* value);
   void array_member_write(const unsigned char* value, size_t length);
+  void array_member_write_utf16le(const uint8_t* value, size_t size);
+
+  void array_member_write_raw(const char* json, size_t length);
 
   void reset();
 
 private:
+  // integers; to_chars involves neither locale nor allocation
+  template <typename T> void number_write(T value) {
+    char buf[24];
+    out.write(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr - buf);
+  }
+
+  void number_write(bool value);
+
+  // shortest representations which round-trip
+  void number_write(float value);
+  void number_write(double value);
+
   void next_element();
-  void write_key(const std::string& key);
+  void write_key(JSON_key key);
 
   void scope_open(char delim);
   void scope_close(char delim);
@@ -141,9 +200,19 @@ private:
   void member_scope_open(char delim);
   void member_scope_close(char delim);
 
+  void push();
+
+  // whether the scope at depth d has no children yet, and setting it
+  bool is_first_child(unsigned int d) const;
+  void set_first_child(unsigned int d, bool first);
+
   std::ostream& out;
   unsigned int depth;
-  std::stack<bool> first_child;
+
+  // bit d is set while the scope at depth d has no children yet; scopes
+  // nested deeper than its bits go in deep, which reset leaves allocated
+  uint64_t first_child;
+  std::vector<bool> deep;
 
   static const char* KVSEP;
 };
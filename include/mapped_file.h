@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+#include <boost/shared_ptr.hpp>
+
+#include <libbfio.h>
+
+//
+// A read-only memory mapping of a whole file.
+//
+class Mapped_file {
+public:
+  explicit Mapped_file(const char* filename);
+  ~Mapped_file();
+
+  Mapped_file(const Mapped_file&) = delete;
+  Mapped_file& operator=(const Mapped_file&) = delete;
+
+  const uint8_t* data() const { return addr; }
+
+  uint64_t size() const { return len; }
+
+  enum Access { RANDOM, SEQUENTIAL };
+
+  // Tells the kernel how the mapping is about to be read.
+  void advise(Access access);
+
+private:
+  uint8_t* addr;
+  uint64_t len;
+};
+
+typedef boost::shared_ptr<Mapped_file> MappedFilePtr;
+
+//
+// Creates a libbfio handle which serves reads from the mapping. All
+// handles created for the same mapping, including the clones libpff
+// makes of them, share it.
+//
+libbfio_handle_t* create_mapped_handle(const MappedFilePtr& mapped);
+
+void destroy_bfio_handle(libbfio_handle_t* handle);
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <libpff.h>
+
+#include "decode_error.h"
+
+class JSON_writer;
+
+//
+// Resolves named properties through the name-to-ID map once per PST
+// rather than once per entry. libpff hands out the same map entry for
+// every entry naming the same property, so resolutions are cached by map
+// entry; map entries from another handle on the same PST fall back to a
+// lookup by name, so a property has one ID however it was reached. The
+// name is JSON-encoded when it is resolved, not each time it is written.
+//
+class Named_properties {
+public:
+  // The ID of the property nkey names, resolving it if it is new. IDs
+  // are dense, in order of first appearance.
+  Decoded<uint32_t> resolve(libpff_name_to_id_map_entry_t* nkey);
+
+  size_t size() const { return props.size(); }
+
+  // Writes the property's name as a member of the current object.
+  void write(uint32_t id, JSON_writer& json) const;
+
+  // Writes every property resolved so far, with its ID, as one record.
+  void write_dictionary(JSON_writer& json) const;
+
+private:
+  struct Property {
+    const char* key;
+    std::string value;
+  };
+
+  std::unordered_map<libpff_name_to_id_map_entry_t*, uint32_t> by_entry;
+  std::unordered_map<std::string, uint32_t> by_name;
+  std::vector<Property> props;
+};
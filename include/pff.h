@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <exception>
+#include <sstream>
+#include <string>
+
+#include <boost/shared_ptr.hpp>
+
+// libbfio must come first, for libpff to declare its libbfio functions
+#include <libbfio.h>
+#include <libpff.h>
+
+#include "decode_error.h"
+
+//
+// Thin wrappers over the libpff calls the traversals share, which throw
+// libpff_error instead of returning -1.
+//
+
+typedef boost::shared_ptr<libpff_file_t> FilePtr;
+typedef boost::shared_ptr<libpff_item_t> ItemPtr;
+typedef boost::shared_ptr<libpff_multi_value_t> MultiValuePtr;
+
+class libpff_error: public std::exception {
+public:
+  libpff_error(libpff_error_t*& error, uint32_t line): src_line(line) {
+    char buf[MAXLEN];
+    libpff_error_sprint(error, buf, MAXLEN);
+    libpff_error_free(&error);
+    init(buf);
+  }
+
+  libpff_error(const std::string& s, uint32_t line): src_line(line) {
+    init(s);
+  }
+
+  virtual ~libpff_error() throw() {}
+
+  virtual const char* what() const throw() { return msg.c_str(); }
+
+  uint32_t line() const { return src_line; }
+
+  const std::string& message() const { return text; }
+
+private:
+  void init(const std::string& s) {
+    text = s;
+
+    std::stringstream ss;
+    ss << src_line << ": " << s;
+    msg = ss.str();
+  }
+
+  static const size_t MAXLEN = 1024;
+
+  uint32_t src_line;
+  std::string text;
+  std::string msg;
+};
+
+static const char* const UNSUPPORTED = "unsupported value type";
+
+libpff_file_t* create_file(const char* filename);
+libpff_file_t* create_file(libbfio_handle_t* handle);
+void destroy_file(libpff_file_t* file);
+
+libpff_item_t* get_root(libpff_file_t* file);
+libpff_item_t* get_child(libpff_item_t* parent, int pos);
+
+libpff_item_t* get_sub_folder(libpff_item_t* folder, int pos);
+
+// null if the folder has no unknowns
+libpff_item_t* get_unknowns(libpff_item_t* folder);
+
+libpff_item_t* get_orphan(libpff_file_t* file, int pos);
+libpff_item_t* get_item(libpff_file_t* file, uint32_t id);
+libpff_item_t* get_recovered(libpff_file_t* file, int pos);
+void destroy_item(libpff_item_t* item);
+
+Decoded<libpff_multi_value_t*> get_multivalue(libpff_item_t* item, uint32_t s, uint32_t etype, uint8_t flags);
+void destroy_multivalue(libpff_multi_value_t* mv);
+
+// Sets name to the item's display name, unless it has none.
+bool get_display_name(libpff_item_t* item, std::string& name);
+
+const char* item_type_string(uint32_t itype);
+const char* entry_type_string(uint32_t etype);
+
+template <typename T, typename G> T get_attrib(G getter) {
+  libpff_error_t* error = 0;
+
+  T value;
+  if (getter(&value, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+  return value;
+}
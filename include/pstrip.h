@@ -0,0 +1,276 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <libpff.h>
+
+class Decode_error;
+class libpff_error;
+
+//
+// The traversal behind pstrip, for embedding: a Pst_walker walks the items
+// of a PST and hands what it decodes to a Pst_visitor, typed, without
+// serializing anything. pstrip's JSON and Arrow outputs are visitors.
+//
+
+// Thrown to abandon work which has been cancelled.
+class Cancelled: public std::exception {
+public:
+  const char* what() const noexcept { return "cancelled"; }
+};
+
+//
+// A decoded property value. Integers and booleans are in integer, floats
+// and doubles in real, and FILETIMEs, as they are, in filetime. The data
+// of strings, GUIDs and binary values is in a buffer of the walker's,
+// valid only during the callback it is passed to, and always followed by
+// a NUL; strings are UTF-8, and their size excludes the NUL. Strings
+// stored as UTF-16LE are passed as they are, with utf16 set and without
+// a NUL, to visitors which ask for them so; see utf16.h. The GUIDs and
+// binary elements of multi-values point into the entry's own data, with
+// no NUL after them. Currency elements are in integer, in units of 1/10000,
+// and application times in real, as OLE dates.
+//
+struct Pst_value {
+  Pst_value(): kind(NIL), integer(0), filetime(0), real(0.0), data(0), size(0), utf16(false) {}
+
+  enum Kind {
+    NIL, INT16, INT32, INT64, FLOAT, DOUBLE, BOOLEAN, FILETIME,
+    STRING, BINARY, GUID
+  };
+
+  Kind kind;
+  int64_t integer;
+  uint64_t filetime;
+  double real;
+  const uint8_t* data;
+  size_t size;
+  bool utf16;
+};
+
+// An entry of an item, i.e., a property of one of its sets.
+struct Pst_entry {
+  uint32_t set;
+  uint32_t entry;
+  uint32_t entry_type;
+  uint32_t value_type;
+
+  // the value type libpff finds for the entry type, if it can find any
+  uint32_t matched_value_type;
+
+  // the named property the entry type stands for, if any
+  libpff_name_to_id_map_entry_t* name;
+};
+
+struct Pst_item {
+  Pst_item(libpff_item_t* h, const std::string& p, const std::string& d):
+    handle(h), path(p), dpath(d),
+    type(LIBPFF_ITEM_TYPE_UNDEFINED), type_known(false),
+    identifier(0), identifier_known(false) {}
+
+  libpff_item_t* handle;
+  const std::string& path;
+  const std::string& dpath;
+
+  // UNDEFINED and 0 respectively if they can't be read
+  uint8_t type;
+  bool type_known;
+  uint32_t identifier;
+  bool identifier_known;
+};
+
+//
+// A failure to read or decode something, with where it happened. The
+// message is only formatted if asked for.
+//
+class Pst_error {
+public:
+  static const long NONE = -1;
+
+  Pst_error(const char* category, const std::string& path,
+            const Decode_error& e,
+            long set = NONE, long entry = NONE, long element = NONE):
+    cat(category), p(path), s(set), en(entry), el(element),
+    derr(&e), lerr(0) {}
+
+  Pst_error(const char* category, const std::string& path,
+            const libpff_error& e,
+            long set = NONE, long entry = NONE, long element = NONE):
+    cat(category), p(path), s(set), en(entry), el(element),
+    derr(0), lerr(&e) {}
+
+  const char* category() const { return cat; }
+  const std::string& path() const { return p; }
+  long set() const { return s; }
+  long entry() const { return en; }
+  long element() const { return el; }
+
+  // the source line where it was detected
+  uint32_t line() const;
+
+  std::string message() const;
+
+private:
+  const char* cat;
+  const std::string& p;
+  long s;
+  long en;
+  long el;
+  const Decode_error* derr;
+  const libpff_error* lerr;
+};
+
+//
+// Receives what a Pst_walker finds. For each item, the walker calls
+// item_begin, and if asked to, walks the values:
+//
+//   values_begin
+//     set_begin
+//       entry_begin, entry_type, value or multi_value_begin, element...,
+//       multi_value_end, entry_end
+//     ...
+//     set_end
+//   ...
+//   values_end
+//
+// and then, if asked to, the sub-items, and for folders the unknowns,
+// before item_end. Values which are absent are skipped; errors may come
+// between any of these calls.
+//
+class Pst_visitor {
+public:
+  virtual ~Pst_visitor() {}
+
+  // what item_begin wants walked
+  enum { VALUES = 1, SUB_ITEMS = 2 };
+
+  virtual int item_begin(const Pst_item&) { return VALUES | SUB_ITEMS; }
+
+  virtual void values_begin(const Pst_item&, uint32_t /*sets*/, uint32_t /*entries*/) {}
+  virtual void set_begin(const Pst_item&, uint32_t /*set*/) {}
+  virtual void entry_begin(const Pst_item&, uint32_t /*set*/, uint32_t /*entry*/) {}
+
+  // Returns whether the value of the entry is wanted.
+  virtual bool entry_type(const Pst_item&, const Pst_entry&) { return true; }
+
+  // Returns whether strings may come as UTF-16LE, to be transcoded
+  // straight to wherever they are going.
+  virtual bool utf16_strings() const { return false; }
+
+  virtual void value(const Pst_item&, const Pst_entry&, const Pst_value&) {}
+
+  virtual void multi_value_begin(const Pst_item&, const Pst_entry&, size_t /*count*/) {}
+  virtual void element(const Pst_item&, const Pst_entry&, size_t /*i*/, const Pst_value&) {}
+  virtual void multi_value_end(const Pst_item&, const Pst_entry&) {}
+
+  virtual void entry_end(const Pst_item&, uint32_t /*set*/, uint32_t /*entry*/) {}
+  virtual void set_end(const Pst_item&, uint32_t /*set*/) {}
+
+  // called even if the values couldn't be read
+  virtual void values_end(const Pst_item&) {}
+
+  virtual void item_end(const Pst_item&) {}
+
+  virtual void error(const Pst_error&) {}
+};
+
+//
+// Picks a fraction of items, by their identifiers alone: the same items
+// for the same seed on every run, and at a lower rate, a subset of those
+// picked at a higher one, so samples and later full runs line up.
+//
+class Pst_sample {
+public:
+  // rate is in (0, 1]
+  Pst_sample(double rate, uint64_t seed);
+
+  bool picks(uint32_t identifier) const;
+
+private:
+  uint64_t key;
+  uint64_t threshold;
+  bool all;
+};
+
+//
+// The display path of the item at path, the i-th of the item at dpath:
+// dpath/name, by its display name, or dpath/i if it has none or it can't
+// be read, in which case the error goes to visitor, if there is one.
+//
+std::string display_path(libpff_item_t* item, const std::string& path, const std::string& dpath, uint32_t i, Pst_visitor* visitor = 0);
+
+//
+// Walks items, reporting them to a visitor. Paths are as in pstrip's
+// records: /name/i/j/... by position, with display paths by display name.
+// Failures are reported to the visitor, and the walk goes on with the
+// next entry or item; only failures to get at the root of a walk throw
+// libpff_error.
+//
+class Pst_walker {
+public:
+  explicit Pst_walker(Pst_visitor& v): visitor(v), cancel(0), sample(0) {}
+
+  // If set, walks throw Cancelled at the next item once *c is true.
+  void set_cancel(const std::atomic<bool>* c) { cancel = c; }
+
+  // If set, walks skip the items in folders, orphans and recovered items
+  // which s doesn't pick, along with everything under them, but not
+  // folders. Everything under an item kept is walked.
+  void set_sample(const Pst_sample* s) { sample = s; }
+
+  // Returns whether the sample, if any, keeps the item: a folder, one
+  // it picks, or one whose type or identifier can't be read, so that
+  // walking it reports why.
+  bool sampled(libpff_item_t* item) const;
+
+  // Sub-items, orphans and recovered items are numbered from 0; walks
+  // of them take the ones from begin up to, but not including, end, or
+  // all the rest if end is negative.
+  static const int ALL = -1;
+
+  // name is what paths start with, usually the file's name
+  void walk_tree(libpff_file_t* file, const std::string& name);
+  void walk_orphans(libpff_file_t* file, const std::string& name, int begin = 0, int end = ALL);
+
+  // the file must have been through libpff_file_recover_items
+  void walk_recovered(libpff_file_t* file, const std::string& name, int begin = 0, int end = ALL);
+
+  // what walk_item walks besides the item: nothing else, the unknowns
+  // if it is a folder, or those and all its sub-items as well
+  enum Scope { ITEM, UNKNOWNS, SUB_ITEMS };
+
+  void walk_item(libpff_item_t* item, const std::string& path, const std::string& dpath, Scope scope = SUB_ITEMS);
+
+  void walk_sub_items(libpff_item_t* item, const std::string& path, const std::string& dpath, int begin = 0, int end = ALL);
+
+  // the unknowns of a folder, at path/unknowns
+  void walk_unknowns(libpff_item_t* folder, const std::string& path, const std::string& dpath);
+
+  // as ::display_path, with errors going to the walker's visitor
+  std::string display_path(libpff_item_t* child, const std::string& path, const std::string& dpath, uint32_t i) const {
+    return ::display_path(child, path, dpath, i, &visitor);
+  }
+
+private:
+  // sampling says whether the items are those the sample picks from
+  void walk_children(libpff_item_t* item, const std::string& path, const std::string& dpath, int begin, int end, bool sampling);
+  template <typename C, typename G> void walk_items(C item_count_getter, G item_getter, const std::string& path, const std::string& dpath, int begin, int end, bool sampling);
+
+  void walk_values(const Pst_item& item);
+  Decode_error walk_entry(const Pst_item& item, uint32_t s, uint32_t e);
+  Decode_error walk_single_value(const Pst_item& item, const Pst_entry& entry, const uint8_t* raw, size_t raw_size);
+  int read_string(const Pst_item& item, const Pst_entry& entry, const uint8_t* raw, size_t raw_size, Pst_value& v, libpff_error_t** error);
+  Decode_error walk_multi_value(const Pst_item& item, const Pst_entry& entry, const uint8_t* raw, size_t raw_size);
+
+  Pst_visitor& visitor;
+  const std::atomic<bool>* cancel;
+  const Pst_sample* sample;
+
+  // reused for every string and binary value
+  std::vector<uint8_t> buf;
+};
@@ -0,0 +1,14 @@
+#pragma once
+
+struct Context;
+struct Fingerprint;
+struct Pst_item;
+
+//
+// Writes an email, contact, appointment or task as one compact record
+// of the properties consumers actually use, read through libpff's typed
+// message accessors, with its recipients and attachment metadata inline.
+// Returns false, writing nothing, for items of any other type, or of a
+// type which couldn't be read. The fingerprint, if any, is written too.
+//
+bool write_semantic_record(const Pst_item& item, Context& ctx, const Fingerprint* fp = 0);
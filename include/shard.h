@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <libpff.h>
+
+struct Context;
+class Pst_walker;
+
+//
+// One of N shares of the items of a PST, for N processes, on as many
+// machines, to extract between them without talking to each other:
+// every process plans the same way, and takes its own share. The plan
+// measures the tree by its folders' sub-item counts, without opening
+// any messages, and cuts it into units of about equal numbers of items:
+// runs of sub-items with all that is under them, and for folders too
+// big for one unit, the folder on its own, its sub-items cut up the same
+// way, and then its unknowns. Messages are never cut up, so each is
+// walked whole, as item_begin asks.
+// A share is a run of consecutive units, so each process reads a part
+// of the tree, and writes its items in the order a whole run would,
+// for pstrip-merge to put back together. The orphans and recovered
+// items are shared out in equal ranges. Nothing is reported while
+// planning; the walks of the shares report what fails.
+//
+class Pst_shard {
+public:
+  // share is from 0 up to shares
+  Pst_shard(libpff_file_t* file, const std::string& name, unsigned int share, unsigned int shares);
+
+  // Walks the share's part of the tree, and then of the orphans.
+  void walk(libpff_file_t* file, Pst_walker& walker, Context& ctx) const;
+
+  // Walks the share's part of the recovered items; the file must have
+  // been through libpff_file_recover_items.
+  void walk_recovered(libpff_file_t* file, Pst_walker& walker) const;
+
+  // Parses I/N, where I counts from 1, into share and shares.
+  static void parse(const std::string& arg, unsigned int& share, unsigned int& shares);
+
+private:
+  struct Node;
+
+  struct Unit {
+    enum Kind { ITEM, SUB_ITEMS, UNKNOWNS };
+
+    Kind kind;
+
+    // the folder, or for SUB_ITEMS the parent, unless that is the root
+    bool root;
+    uint32_t identifier;
+
+    // of the folder, or for ITEM, of its parent, with its index in it
+    std::string path;
+    std::string dpath;
+    int index;
+
+    // the range of SUB_ITEMS
+    int begin;
+    int end;
+  };
+
+  void cut(const Node& node, const std::string& path, const std::string& parent_dpath, bool root);
+  void add(const Unit& unit, uint64_t weight);
+  void add_range(const Node& node, const std::string& path, bool root, int begin, int end, uint64_t weight);
+
+  // the range of count things which falls to this share
+  void share_of(int count, int& begin, int& end) const;
+
+  std::string name;
+  unsigned int share;
+  unsigned int shares;
+
+  // items to a unit, the items in all units, and in those so far
+  uint64_t target;
+  uint64_t total;
+  uint64_t done;
+
+  // this share's units, in the order of a whole walk
+  std::vector<Unit> units;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//
+// A full-text index of item identifiers by term. Terms are runs of ASCII
+// letters and digits and of non-ASCII UTF-8 bytes, with ASCII lowercased,
+// of 2 to Tokenizer::MAX_TERM bytes; anything longer is skipped.
+//
+// The file starts with MAGIC, followed by the posting lists, one per term:
+// a varint count and the identifiers in ascending order, as varint deltas.
+// Then comes the dictionary, in term order: for each term, the varint
+// lengths of the prefix it shares with the previous term and of the rest,
+// the rest, and the varint delta of its posting list's offset from the
+// previous one's. The file ends with the dictionary's offset and the
+// number of terms, as little-endian 64-bit integers.
+//
+
+// Splits text into terms, as the index does.
+class Tokenizer {
+public:
+  static const size_t MAX_TERM = 64;
+
+  Tokenizer(const char* text, size_t len): p(text), end(text + len) {}
+
+  bool next(std::string& term);
+
+private:
+  const char* p;
+  const char* end;
+};
+
+//
+// Builds an index in memory, a segment at a time. A segment which grows
+// past segment_postings postings is written out to filename.N; close()
+// merges the segments into filename.
+//
+class Index_writer {
+public:
+  explicit Index_writer(const std::string& filename,
+                        size_t segment_postings = 1 << 24);
+
+  // removes the segments
+  ~Index_writer();
+
+  Index_writer(const Index_writer&) = delete;
+  Index_writer& operator=(const Index_writer&) = delete;
+
+  // Indexes the terms of text under id.
+  void add(uint32_t id, const char* text, size_t len);
+
+  void close();
+
+private:
+  // per term, identifiers in the order added, but without repeats
+  typedef std::unordered_map<std::string, std::vector<uint32_t> > Postings;
+
+  void write_segment(const std::string& name);
+
+  static bool by_term(const Postings::iterator& a, const Postings::iterator& b);
+
+  std::string filename;
+  size_t segment_postings;
+
+  Postings postings;
+  size_t count;
+
+  std::vector<std::string> segments;
+  bool closed;
+};
+
+//
+// Looks terms up in an index. The dictionary is read up front; posting
+// lists are read as needed.
+//
+class Index_reader {
+public:
+  explicit Index_reader(const std::string& filename);
+
+  // Sets ids to the identifiers indexed under term, in ascending order.
+  void lookup(const std::string& term, std::vector<uint32_t>& ids);
+
+  // Sets ids to the identifiers indexed under any term starting with
+  // prefix, in ascending order.
+  void lookup_prefix(const std::string& prefix, std::vector<uint32_t>& ids);
+
+  // the terms, in ascending order, and their posting lists by position
+  size_t term_count() const { return terms.size(); }
+  const std::string& term(size_t t) const { return terms[t]; }
+  void postings(size_t t, std::vector<uint32_t>& ids);
+
+private:
+  std::string filename;
+  std::ifstream in;
+  std::vector<std::string> terms;
+
+  // of each posting list, and of the dictionary after the last
+  std::vector<uint64_t> offsets;
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+//
+// Tracing of the hot paths, for chrome://tracing or Perfetto. Spans are
+// recorded into a ring buffer per thread, without locks, keeping the
+// latest capacity spans of each thread, and written out at the end as
+// Chrome trace event JSON. Only every sample-th item is traced, along
+// with the spans inside it. Until Trace::start, a span costs a load and
+// a branch.
+//
+class Trace {
+public:
+  static void start(unsigned int sample = 1, size_t capacity = 1 << 18);
+
+  static bool on() { return enabled.load(std::memory_order_relaxed); }
+
+  // Writes every span recorded; the threads recording them must be done.
+  static void write(std::ostream& out);
+
+private:
+  static std::atomic<bool> enabled;
+};
+
+//
+// Records the time from its construction to its destruction as a span,
+// if tracing is on and the item it is in, if any, is sampled. The name,
+// category and argument name must outlive the trace, as literals do.
+//
+class Trace_span {
+public:
+  Trace_span(const char* n, const char* c):
+    name(n), cat(c), arg_name(0), arg_value(0), begin(0)
+  {
+    if (Trace::on()) {
+      start();
+    }
+  }
+
+  Trace_span(const char* n, const char* c, const char* a, uint64_t value):
+    name(n), cat(c), arg_name(a), arg_value(value), begin(0)
+  {
+    if (Trace::on()) {
+      start();
+    }
+  }
+
+  ~Trace_span() {
+    end();
+  }
+
+  Trace_span(const Trace_span&) = delete;
+  Trace_span& operator=(const Trace_span&) = delete;
+
+  // Ends the span before its destruction.
+  void end() {
+    if (begin) {
+      finish();
+      begin = 0;
+    }
+  }
+
+  // Sets the span's argument, for when it is only known later.
+  void arg(const char* a, uint64_t value) {
+    arg_name = a;
+    arg_value = value;
+  }
+
+private:
+  void start();
+  void finish();
+
+  const char* name;
+  const char* cat;
+  const char* arg_name;
+  uint64_t arg_value;
+
+  // in ns since the trace started, plus one, or 0 if not recording
+  uint64_t begin;
+};
+
+//
+// A span for an item, which decides whether the item is sampled, and
+// with it the spans inside it, up to the next item.
+//
+class Trace_item_span {
+public:
+  Trace_item_span(): arg_name(0), arg_value(0), begin(0), active(false), outer_sampled(false) {
+    if (Trace::on()) {
+      enter();
+    }
+  }
+
+  ~Trace_item_span() {
+    if (active) {
+      leave();
+    }
+  }
+
+  Trace_item_span(const Trace_item_span&) = delete;
+  Trace_item_span& operator=(const Trace_item_span&) = delete;
+
+  void arg(const char* a, uint64_t value) {
+    arg_name = a;
+    arg_value = value;
+  }
+
+private:
+  void enter();
+  void leave();
+
+  const char* arg_name;
+  uint64_t arg_value;
+  uint64_t begin;
+  bool active;
+
+  // whether the enclosing item was sampled
+  bool outer_sampled;
+};
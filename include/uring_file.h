@@ -0,0 +1,128 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include <libbfio.h>
+
+//
+// A file read through io_uring, in blocks held in a small cache. A read
+// which misses submits the block it wants along with those after it in
+// one system call, and waits only for its own; the rest land in the
+// cache as they complete. Each reader has a readahead window, which
+// doubles, up to the depth of the queue, while it keeps reading into
+// its window, and shrinks back to one block when it jumps, so that the
+// device has a queue of reads to work on during scans, and random reads
+// cost no more than before. libpff doesn't reveal where an item's data
+// lies, so the reads can only be predicted from those before them.
+//
+class Uring_file {
+public:
+  // Reads of depth blocks at most are in flight at once.
+  Uring_file(const char* filename, unsigned int depth);
+  ~Uring_file();
+
+  Uring_file(const Uring_file&) = delete;
+  Uring_file& operator=(const Uring_file&) = delete;
+
+  uint64_t size() const { return len; }
+
+  // Where a reader is reading, to read ahead of it.
+  struct Stream {
+    Stream(): next(0), window(0) {}
+
+    // the block after the last one read ahead, and how many to read
+    uint64_t next;
+    unsigned int window;
+  };
+
+  // Reads up to size bytes at offset into buf, fewer at the end of the
+  // file, and returns how many, or -1 with errno set.
+  ssize_t read(Stream& stream, uint64_t offset, uint8_t* buf, size_t size);
+
+private:
+  struct Block {
+    enum State { EMPTY, PENDING, READY };
+
+    Block(): index(0), state(EMPTY), length(0), error(0), used(0) {}
+
+    uint64_t index;
+    State state;
+    size_t length;
+    int error;
+
+    // when it was last read, for eviction
+    uint64_t used;
+  };
+
+  void close_all();
+
+  // the slot holding block index, or -1
+  long find(uint64_t index) const;
+
+  void read_ahead(Stream& stream, uint64_t index, bool hit);
+
+  // Queues a read of the block unless it is cached or pending, returning
+  // false if the queue is full; flush submits what is queued.
+  bool submit(uint64_t index);
+  void flush();
+
+  // Waits for a read to complete, or for another thread to see one.
+  void wait(std::unique_lock<std::mutex>& lock);
+  void reap();
+
+  int fd;
+  uint64_t len;
+  unsigned int depth;
+
+  // the ring, and the memory it shares with the kernel
+  int ring;
+  void* sq_ring;
+  size_t sq_ring_size;
+  void* cq_ring;
+  size_t cq_ring_size;
+  void* sqes;
+  size_t sqes_size;
+  unsigned int* sq_tail;
+  unsigned int* sq_mask;
+  unsigned int* sq_array;
+  unsigned int* cq_head;
+  unsigned int* cq_tail;
+  unsigned int* cq_mask;
+  void* cqes;
+
+  std::mutex mutex;
+  std::condition_variable reaped;
+
+  // whether a thread is waiting on the ring for completions
+  bool reaping;
+  unsigned int queued;
+  unsigned int in_flight;
+
+  // the errno of a failure of the ring itself, after which reads fail
+  int broken;
+
+  std::vector<Block> blocks;
+  std::vector<iovec> iovecs;
+  std::unordered_map<uint64_t, size_t> slots;
+  uint8_t* buffer;
+  uint64_t clock;
+};
+
+typedef boost::shared_ptr<Uring_file> UringFilePtr;
+
+//
+// Creates a libbfio handle which reads through the file. All handles
+// created for it, including the clones libpff makes of them, share its
+// ring and cache, each with a readahead window of its own.
+//
+libbfio_handle_t* create_uring_handle(const UringFilePtr& file);
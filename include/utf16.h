@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+//
+// Conversion of strings as PSTs store them, in UTF-16LE, without going
+// through libpff. Strings end at their first U+0000, if any; unpaired
+// surrogates, and an odd byte at the end, become U+FFFD. Runs of ASCII,
+// which most text is, are done 8 code units at a time with SSE2, where
+// the target has it.
+//
+
+// Appends the UTF-8 of the size bytes of UTF-16LE at in to out, and
+// returns its length.
+size_t utf16le_to_utf8(const uint8_t* in, size_t size, std::vector<uint8_t>& out);
+
+// Writes the size bytes of UTF-16LE at in as a JSON string, transcoding
+// and escaping it in one pass.
+void write_json_utf16le(std::ostream& out, const uint8_t* in, size_t size);
+
+bool is_ascii(const uint8_t* in, size_t size);
@@ -0,0 +1,130 @@
+#include "arrow_export.h"
+
+namespace {
+
+// path, identifier, set
+const size_t FIXED_COLUMNS = 3;
+
+}
+
+Arrow_export::Arrow_export(const std::string& d,
+                           const std::vector<uint32_t>& entry_types,
+                           const std::vector<std::string>& column_names,
+                           size_t bs):
+  dir(d), names(column_names), batch_size(bs)
+{
+  for (size_t i = 0; i < entry_types.size(); ++i) {
+    columns[entry_types[i]] = i;
+  }
+}
+
+void Arrow_export::add_row(const std::string& table, const std::string& path,
+                           uint32_t identifier, uint32_t set,
+                           const std::vector<Arrow_cell>& cells)
+{
+  Table& t = tables[table];
+
+  const Row row = { path, identifier, set, cells };
+
+  if (t.writer) {
+    write_row(*t.writer, row);
+    return;
+  }
+
+  t.pending.push_back(row);
+  if (t.pending.size() == batch_size) {
+    open_table(table, t);
+  }
+}
+
+void Arrow_export::open_table(const std::string& name, Table& t) {
+  std::vector<Arrow_writer::Column> schema;
+
+  const Arrow_writer::Column path = { "path", Arrow_writer::UTF8 };
+  const Arrow_writer::Column id = { "identifier", Arrow_writer::INT64 };
+  const Arrow_writer::Column set = { "set", Arrow_writer::INT32 };
+  schema.push_back(path);
+  schema.push_back(id);
+  schema.push_back(set);
+
+  // each column takes the type of its first value
+  for (size_t c = 0; c < names.size(); ++c) {
+    Arrow_writer::Column col = { names[c], Arrow_writer::UTF8 };
+
+    for (std::vector<Row>::const_iterator r(t.pending.begin());
+         r != t.pending.end(); ++r) {
+      if (r->cells[c].type != Arrow_cell::NONE) {
+        col.type = static_cast<Arrow_writer::Type>(r->cells[c].type - 1);
+        break;
+      }
+    }
+
+    schema.push_back(col);
+  }
+
+  t.writer.reset(new Arrow_writer(dir + '/' + name + ".arrow", schema, batch_size));
+
+  for (std::vector<Row>::const_iterator r(t.pending.begin());
+       r != t.pending.end(); ++r) {
+    write_row(*t.writer, *r);
+  }
+
+  t.pending.clear();
+}
+
+void Arrow_export::write_row(Arrow_writer& w, const Row& row) {
+  w.append(0, reinterpret_cast<const uint8_t*>(row.path.data()), row.path.size());
+  w.append(1, (int64_t) row.identifier);
+  w.append(2, (int64_t) row.set);
+
+  for (size_t c = 0; c < row.cells.size(); ++c) {
+    const Arrow_cell& cell = row.cells[c];
+    const size_t col = FIXED_COLUMNS + c;
+
+    if (cell.type == Arrow_cell::NONE) {
+      w.append_null(col);
+      continue;
+    }
+
+    if (cell.type - 1 != w.schema()[col].type) {
+      ++mismatched[names[c]];
+      w.append_null(col);
+      continue;
+    }
+
+    switch (cell.type) {
+    case Arrow_cell::INT32:
+    case Arrow_cell::INT64:
+    case Arrow_cell::TIMESTAMP:
+      w.append(col, cell.integer);
+      break;
+    case Arrow_cell::DOUBLE:
+      w.append(col, cell.real);
+      break;
+    case Arrow_cell::BOOL:
+      w.append(col, cell.integer != 0);
+      break;
+    case Arrow_cell::BINARY:
+    case Arrow_cell::UTF8:
+      w.append(col, reinterpret_cast<const uint8_t*>(cell.bytes.data()),
+               cell.bytes.size());
+      break;
+    case Arrow_cell::NONE:
+      break;
+    }
+  }
+
+  w.end_row();
+}
+
+void Arrow_export::close() {
+  for (std::map<std::string, Table>::iterator i(tables.begin());
+       i != tables.end(); ++i) {
+    // tables smaller than a batch are still waiting for their schema
+    if (!i->second.writer) {
+      open_table(i->first, i->second);
+    }
+
+    i->second.writer->close();
+  }
+}
@@ -0,0 +1,93 @@
+#include "arrow_visitor.h"
+#include "context.h"
+
+namespace {
+  // FILETIMEs count 100ns intervals since 1601-01-01
+  int64_t filetime_to_unix_micros(uint64_t ft) {
+    static const int64_t EPOCH_DIFF = 116444736000000000LL;
+
+    const int64_t d = (int64_t) ft - EPOCH_DIFF;
+    return d / 10 - (d % 10 < 0);
+  }
+}
+
+void Arrow_visitor::set_begin(const Pst_item&, uint32_t) {
+  cells.assign(arrow.column_count(), Arrow_cell());
+}
+
+bool Arrow_visitor::entry_type(const Pst_item& item, const Pst_entry& entry) {
+  col = arrow.column(entry.entry_type);
+  if (col == Arrow_export::NPOS) {
+    return false;
+  }
+
+  if (entry.value_type & LIBPFF_VALUE_TYPE_MULTI_VALUE_FLAG) {
+    // columns hold single values
+    if (!multi_valued[col]) {
+      multi_valued[col] = true;
+      report(ctx, "value", item.path, Decode_error(UNSUPPORTED, __LINE__), entry.set, entry.entry);
+    }
+    return false;
+  }
+
+  return true;
+}
+
+void Arrow_visitor::value(const Pst_item&, const Pst_entry&, const Pst_value& v) {
+  Arrow_cell& cell = cells[col];
+
+  switch (v.kind) {
+  case Pst_value::NIL:
+    // a null is a null
+    return;
+  case Pst_value::INT16:
+  case Pst_value::INT32:
+    cell.type = Arrow_cell::INT32;
+    cell.integer = v.integer;
+    break;
+  case Pst_value::INT64:
+    cell.type = Arrow_cell::INT64;
+    cell.integer = v.integer;
+    break;
+  case Pst_value::FLOAT:
+  case Pst_value::DOUBLE:
+    cell.type = Arrow_cell::DOUBLE;
+    cell.real = v.real;
+    break;
+  case Pst_value::BOOLEAN:
+    cell.type = Arrow_cell::BOOL;
+    cell.integer = v.integer;
+    break;
+  case Pst_value::FILETIME:
+    cell.type = Arrow_cell::TIMESTAMP;
+    cell.integer = filetime_to_unix_micros(v.filetime);
+    break;
+  case Pst_value::STRING:
+    cell.type = Arrow_cell::UTF8;
+    cell.bytes.assign((const char*) v.data, v.size);
+    break;
+  case Pst_value::BINARY:
+  case Pst_value::GUID:
+    cell.type = Arrow_cell::BINARY;
+    cell.bytes.assign((const char*) v.data, v.size);
+    break;
+  }
+}
+
+void Arrow_visitor::set_end(const Pst_item& item, uint32_t set) {
+  arrow.add_row(item_type_string(item.type), item.path, item.identifier, set, cells);
+}
+
+void Arrow_visitor::values_end(const Pst_item&) {
+  // errors held back for inline output follow the item they belong to
+  ctx.errors.flush_pending();
+}
+
+void Arrow_visitor::item_end(const Pst_item&) {
+  // and those raised while walking its sub-items follow those
+  ctx.errors.flush_pending();
+}
+
+void Arrow_visitor::error(const Pst_error& e) {
+  report(ctx, e);
+}
@@ -0,0 +1,512 @@
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include "arrow_writer.h"
+#include "trace.h"
+
+namespace {
+
+//
+// Just enough of a flatbuffer builder for the Arrow IPC metadata. Like
+// the real one, it builds back to front, so that every object precedes
+// (i.e., is created before) the objects referring to it. The bytes are
+// kept in reverse, each value pushed most significant byte first, so
+// that reversing them at the end gives the buffer. Offsets to objects
+// are measured from the end of the buffer. Assumes a little-endian host.
+//
+class Flatbuffer {
+public:
+  Flatbuffer(): minalign(1), object_start(0) {}
+
+  uint32_t size() const { return buf.size(); }
+
+  void pad(size_t n) { buf.insert(buf.end(), n, 0); }
+
+  // Pads so that, once additional bytes are prepended, the buffer is
+  // aligned for a value of size align.
+  void prep(size_t align, size_t additional) {
+    minalign = std::max(minalign, align);
+    pad((~(buf.size() + additional) + 1) & (align - 1));
+  }
+
+  template <typename T> void put(T value) {
+    uint8_t b[sizeof(T)];
+    std::memcpy(b, &value, sizeof(T));
+    for (size_t i = sizeof(T); i > 0; --i) {
+      buf.push_back(b[i-1]);
+    }
+  }
+
+  template <typename T> void prepend(T value) {
+    prep(sizeof(T), 0);
+    put(value);
+  }
+
+  void prepend_offset(uint32_t off) {
+    prep(sizeof(uint32_t), 0);
+    put<uint32_t>(size() - off + sizeof(uint32_t));
+  }
+
+  uint32_t create_string(const std::string& s) {
+    prep(sizeof(uint32_t), s.size() + 1);
+    buf.push_back(0);
+    buf.insert(buf.end(), s.rbegin(), s.rend());
+    put<uint32_t>(s.size());
+    return size();
+  }
+
+  // Elements are then prepended last to first.
+  void start_vector(size_t elem_size, size_t count, size_t align) {
+    prep(sizeof(uint32_t), elem_size * count);
+    prep(align, elem_size * count);
+  }
+
+  uint32_t end_vector(size_t count) {
+    put<uint32_t>(count);
+    return size();
+  }
+
+  uint32_t create_offset_vector(const std::vector<uint32_t>& offs) {
+    start_vector(sizeof(uint32_t), offs.size(), sizeof(uint32_t));
+    for (size_t i = offs.size(); i > 0; --i) {
+      prepend_offset(offs[i-1]);
+    }
+    return end_vector(offs.size());
+  }
+
+  void start_table(size_t fields) {
+    vtable.assign(fields, 0);
+    object_start = size();
+  }
+
+  template <typename T> void add_scalar(size_t field, T value) {
+    prepend(value);
+    vtable[field] = size();
+  }
+
+  void add_offset(size_t field, uint32_t off) {
+    prepend_offset(off);
+    vtable[field] = size();
+  }
+
+  uint32_t end_table() {
+    // placeholder for the offset to the vtable
+    prepend<int32_t>(0);
+    const uint32_t object = size();
+
+    for (size_t i = vtable.size(); i > 0; --i) {
+      put<uint16_t>(vtable[i-1] ? object - vtable[i-1] : 0);
+    }
+    put<uint16_t>(object - object_start);
+    put<uint16_t>((vtable.size() + 2) * sizeof(uint16_t));
+
+    // the vtable precedes the table
+    const int32_t soff = size() - object;
+    uint8_t b[sizeof(int32_t)];
+    std::memcpy(b, &soff, sizeof(int32_t));
+    for (size_t i = 0; i < sizeof(int32_t); ++i) {
+      buf[object - 1 - i] = b[i];
+    }
+
+    return object;
+  }
+
+  std::vector<uint8_t> finish(uint32_t root) {
+    prep(minalign, sizeof(uint32_t));
+    prepend_offset(root);
+    return std::vector<uint8_t>(buf.rbegin(), buf.rend());
+  }
+
+private:
+  std::vector<uint8_t> buf;
+  size_t minalign;
+
+  std::vector<uint32_t> vtable;
+  uint32_t object_start;
+};
+
+// from Schema.fbs, Message.fbs, File.fbs
+const int16_t METADATA_V5 = 4;
+
+const uint8_t TYPE_INT = 2;
+const uint8_t TYPE_FLOATING_POINT = 3;
+const uint8_t TYPE_BINARY = 4;
+const uint8_t TYPE_UTF8 = 5;
+const uint8_t TYPE_BOOL = 6;
+const uint8_t TYPE_TIMESTAMP = 10;
+
+const int16_t PRECISION_DOUBLE = 2;
+const int16_t TIME_UNIT_MICROSECOND = 2;
+
+const uint8_t HEADER_SCHEMA = 1;
+const uint8_t HEADER_RECORD_BATCH = 3;
+
+const char MAGIC[] = "ARROW1";
+
+uint32_t build_type(Flatbuffer& fb, Arrow_writer::Type type, uint8_t& tag) {
+  uint32_t tz = 0;
+  if (type == Arrow_writer::TIMESTAMP) {
+    tz = fb.create_string("UTC");
+  }
+
+  switch (type) {
+  case Arrow_writer::INT32:
+  case Arrow_writer::INT64:
+    tag = TYPE_INT;
+    fb.start_table(2);
+    fb.add_scalar<int32_t>(0, type == Arrow_writer::INT32 ? 32 : 64);
+    fb.add_scalar<uint8_t>(1, 1);
+    break;
+  case Arrow_writer::DOUBLE:
+    tag = TYPE_FLOATING_POINT;
+    fb.start_table(1);
+    fb.add_scalar<int16_t>(0, PRECISION_DOUBLE);
+    break;
+  case Arrow_writer::BOOL:
+    tag = TYPE_BOOL;
+    fb.start_table(0);
+    break;
+  case Arrow_writer::TIMESTAMP:
+    tag = TYPE_TIMESTAMP;
+    fb.start_table(2);
+    fb.add_offset(1, tz);
+    fb.add_scalar<int16_t>(0, TIME_UNIT_MICROSECOND);
+    break;
+  case Arrow_writer::BINARY:
+    tag = TYPE_BINARY;
+    fb.start_table(0);
+    break;
+  case Arrow_writer::UTF8:
+    tag = TYPE_UTF8;
+    fb.start_table(0);
+    break;
+  }
+
+  return fb.end_table();
+}
+
+uint32_t build_schema(Flatbuffer& fb,
+                      const std::vector<Arrow_writer::Column>& cols)
+{
+  std::vector<uint32_t> fields;
+
+  for (std::vector<Arrow_writer::Column>::const_iterator i(cols.begin());
+       i != cols.end(); ++i) {
+    const uint32_t name = fb.create_string(i->name);
+
+    uint8_t tag = 0;
+    const uint32_t type = build_type(fb, i->type, tag);
+
+    fb.start_vector(sizeof(uint32_t), 0, sizeof(uint32_t));
+    const uint32_t children = fb.end_vector(0);
+
+    // Field
+    fb.start_table(7);
+    fb.add_offset(0, name);
+    fb.add_offset(3, type);
+    fb.add_offset(5, children);
+    fb.add_scalar<uint8_t>(1, 1);
+    fb.add_scalar<uint8_t>(2, tag);
+    fields.push_back(fb.end_table());
+  }
+
+  const uint32_t fieldv = fb.create_offset_vector(fields);
+
+  // Schema; endianness defaults to little
+  fb.start_table(4);
+  fb.add_offset(1, fieldv);
+  return fb.end_table();
+}
+
+std::vector<uint8_t> build_message(Flatbuffer& fb, uint8_t tag,
+                                   uint32_t header, int64_t body_length)
+{
+  fb.start_table(5);
+  fb.add_scalar<int64_t>(3, body_length);
+  fb.add_offset(2, header);
+  fb.add_scalar<int16_t>(0, METADATA_V5);
+  fb.add_scalar<uint8_t>(1, tag);
+  return fb.finish(fb.end_table());
+}
+
+void append_buffer(std::vector<uint8_t>& body,
+                   std::vector<std::pair<int64_t, int64_t> >& buffers,
+                   const uint8_t* data, size_t length)
+{
+  buffers.push_back(std::make_pair(body.size(), length));
+  body.insert(body.end(), data, data + length);
+  // buffers start at multiples of 8 in the body
+  body.resize((body.size() + 7) & ~size_t(7), 0);
+}
+
+}
+
+Arrow_writer::Arrow_writer(const std::string& filename,
+                           const std::vector<Column>& columns,
+                           size_t bs):
+  out(filename.c_str(), std::ios::binary),
+  cols(columns), batch_size(bs), builders(columns.size()), rows(0),
+  position(0), closed(false)
+{
+  if (!out) {
+    throw std::runtime_error("cannot open " + filename);
+  }
+
+  // magic, padded to 8
+  out.write(MAGIC, 6);
+  out.write("\0\0", 2);
+  position = 8;
+
+  Flatbuffer fb;
+  const uint32_t schema = build_schema(fb, cols);
+  write_message(build_message(fb, HEADER_SCHEMA, schema, 0),
+                std::vector<uint8_t>());
+
+  reset_builders();
+}
+
+Arrow_writer::~Arrow_writer() {
+  try {
+    close();
+  }
+  catch (...) {
+  }
+}
+
+void Arrow_writer::reset_builders() {
+  for (size_t c = 0; c < builders.size(); ++c) {
+    Builder& b = builders[c];
+    b.validity.clear();
+    b.data.clear();
+    b.offsets.assign(1, 0);
+    b.null_count = 0;
+  }
+  rows = 0;
+}
+
+void Arrow_writer::set_valid(size_t col, bool valid) {
+  Builder& b = builders[col];
+  if (rows % 8 == 0) {
+    b.validity.push_back(0);
+  }
+
+  if (valid) {
+    b.validity.back() |= 1 << (rows % 8);
+  }
+  else {
+    ++b.null_count;
+  }
+}
+
+void Arrow_writer::append_null(size_t col) {
+  set_valid(col, false);
+
+  Builder& b = builders[col];
+  switch (cols[col].type) {
+  case INT32:
+    b.data.resize(b.data.size() + 4, 0);
+    break;
+  case INT64:
+  case TIMESTAMP:
+  case DOUBLE:
+    b.data.resize(b.data.size() + 8, 0);
+    break;
+  case BOOL:
+    if (rows % 8 == 0) {
+      b.data.push_back(0);
+    }
+    break;
+  case BINARY:
+  case UTF8:
+    b.offsets.push_back(b.offsets.back());
+    break;
+  }
+}
+
+void Arrow_writer::append(size_t col, int64_t value) {
+  set_valid(col, true);
+
+  Builder& b = builders[col];
+  if (cols[col].type == INT32) {
+    const int32_t v = value;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&v);
+    b.data.insert(b.data.end(), p, p + sizeof(v));
+  }
+  else {
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+    b.data.insert(b.data.end(), p, p + sizeof(value));
+  }
+}
+
+void Arrow_writer::append(size_t col, double value) {
+  set_valid(col, true);
+
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(&value);
+  builders[col].data.insert(builders[col].data.end(), p, p + sizeof(value));
+}
+
+void Arrow_writer::append(size_t col, bool value) {
+  set_valid(col, true);
+
+  Builder& b = builders[col];
+  if (rows % 8 == 0) {
+    b.data.push_back(0);
+  }
+
+  if (value) {
+    b.data.back() |= 1 << (rows % 8);
+  }
+}
+
+void Arrow_writer::append(size_t col, const uint8_t* value, size_t length) {
+  set_valid(col, true);
+
+  Builder& b = builders[col];
+  b.data.insert(b.data.end(), value, value + length);
+  b.offsets.push_back(b.data.size());
+}
+
+void Arrow_writer::end_row() {
+  if (++rows == (int64_t) batch_size) {
+    write_batch();
+  }
+}
+
+void Arrow_writer::write_batch() {
+  Trace_span span("arrow batch", "write", "rows", rows);
+
+  std::vector<uint8_t> body;
+  std::vector<std::pair<int64_t, int64_t> > buffers;
+
+  for (size_t c = 0; c < builders.size(); ++c) {
+    const Builder& b = builders[c];
+
+    // no validity bitmap is needed if nothing is null
+    if (b.null_count) {
+      append_buffer(body, buffers, &b.validity[0], b.validity.size());
+    }
+    else {
+      append_buffer(body, buffers, 0, 0);
+    }
+
+    if (cols[c].type == BINARY || cols[c].type == UTF8) {
+      append_buffer(
+        body, buffers,
+        reinterpret_cast<const uint8_t*>(&b.offsets[0]),
+        b.offsets.size() * sizeof(int32_t)
+      );
+    }
+
+    append_buffer(body, buffers, b.data.empty() ? 0 : &b.data[0], b.data.size());
+  }
+
+  Flatbuffer fb;
+
+  // Buffer structs: offset, length
+  fb.start_vector(16, buffers.size(), 8);
+  for (size_t i = buffers.size(); i > 0; --i) {
+    fb.put<int64_t>(buffers[i-1].second);
+    fb.put<int64_t>(buffers[i-1].first);
+  }
+  const uint32_t bufferv = fb.end_vector(buffers.size());
+
+  // FieldNode structs: length, null count
+  fb.start_vector(16, builders.size(), 8);
+  for (size_t c = builders.size(); c > 0; --c) {
+    fb.put<int64_t>(builders[c-1].null_count);
+    fb.put<int64_t>(rows);
+  }
+  const uint32_t nodev = fb.end_vector(builders.size());
+
+  // RecordBatch
+  fb.start_table(4);
+  fb.add_scalar<int64_t>(0, rows);
+  fb.add_offset(1, nodev);
+  fb.add_offset(2, bufferv);
+  const uint32_t batch = fb.end_table();
+
+  batches.push_back(write_message(
+    build_message(fb, HEADER_RECORD_BATCH, batch, body.size()), body
+  ));
+
+  reset_builders();
+}
+
+Arrow_writer::Block Arrow_writer::write_message(
+  const std::vector<uint8_t>& metadata,
+  const std::vector<uint8_t>& body)
+{
+  // continuation marker, metadata length, metadata padded to 8, body
+  const uint32_t marker = 0xFFFFFFFF;
+  const int32_t padded = (metadata.size() + 7) & ~size_t(7);
+
+  out.write(reinterpret_cast<const char*>(&marker), sizeof(marker));
+  out.write(reinterpret_cast<const char*>(&padded), sizeof(padded));
+  out.write(reinterpret_cast<const char*>(&metadata[0]), metadata.size());
+
+  const char zeros[8] = { 0 };
+  out.write(zeros, padded - metadata.size());
+
+  if (!body.empty()) {
+    out.write(reinterpret_cast<const char*>(&body[0]), body.size());
+  }
+
+  if (!out) {
+    throw std::runtime_error("cannot write Arrow file");
+  }
+
+  const Block block = { position, 8 + padded, (int64_t) body.size() };
+  position += 8 + padded + body.size();
+  return block;
+}
+
+void Arrow_writer::close() {
+  if (closed) {
+    return;
+  }
+
+  closed = true;
+
+  if (rows > 0) {
+    write_batch();
+  }
+
+  // end of stream
+  const uint32_t eos[2] = { 0xFFFFFFFF, 0 };
+  out.write(reinterpret_cast<const char*>(eos), sizeof(eos));
+
+  Flatbuffer fb;
+  const uint32_t schema = build_schema(fb, cols);
+
+  // Block structs: offset, metadata length, padding, body length
+  fb.start_vector(24, batches.size(), 8);
+  for (size_t i = batches.size(); i > 0; --i) {
+    fb.put<int64_t>(batches[i-1].body_length);
+    fb.pad(4);
+    fb.put<int32_t>(batches[i-1].metadata_length);
+    fb.put<int64_t>(batches[i-1].offset);
+  }
+  const uint32_t batchv = fb.end_vector(batches.size());
+
+  fb.start_vector(24, 0, 8);
+  const uint32_t dictv = fb.end_vector(0);
+
+  // Footer
+  fb.start_table(5);
+  fb.add_offset(1, schema);
+  fb.add_offset(2, dictv);
+  fb.add_offset(3, batchv);
+  fb.add_scalar<int16_t>(0, METADATA_V5);
+  const std::vector<uint8_t> footer(fb.finish(fb.end_table()));
+
+  const int32_t footer_length = footer.size();
+  out.write(reinterpret_cast<const char*>(&footer[0]), footer.size());
+  out.write(reinterpret_cast<const char*>(&footer_length), sizeof(footer_length));
+  out.write(MAGIC, 6);
+
+  out.close();
+  if (!out) {
+    throw std::runtime_error("cannot write Arrow file");
+  }
+}
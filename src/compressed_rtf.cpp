@@ -0,0 +1,534 @@
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "compressed_rtf.h"
+
+namespace {
+  const uint32_t COMPRESSED = 0x75465a4c;   // "LZFu"
+  const uint32_t UNCOMPRESSED = 0x414c454d; // "MELA"
+
+  const size_t HEADER_SIZE = 16;
+
+  // the dictionary is initialized with this, per MS-OXRTFCP 2.1.2.1
+  const char PREBUF[] =
+    "{\\rtf1\\ansi\\mac\\deff0\\deftab720{\\fonttbl;}{\\f0\\fnil \\froman "
+    "\\fswiss \\fmodern \\fscript \\fdecor MS Sans SerifSymbolArialTimes "
+    "New RomanCourier{\\colortbl\\red0\\green0\\blue0\r\n\\par "
+    "\\pard\\plain\\f0\\fs20\\b\\i\\u\\tab\\tx";
+
+  const size_t PREBUF_LEN = sizeof(PREBUF) - 1;
+
+  const size_t DICT_SIZE = 4096;
+
+  uint32_t le32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+  }
+
+  struct Crc_table {
+    Crc_table() {
+      for (uint32_t i = 0; i < 256; ++i) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; ++k) {
+          c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        t[i] = c;
+      }
+    }
+
+    uint32_t t[256];
+  };
+
+  // the usual CRC-32, but neither preconditioned nor postconditioned
+  uint32_t crc32(const uint8_t* p, size_t len) {
+    static const Crc_table table;
+
+    uint32_t crc = 0;
+    for (const uint8_t* end = p + len; p != end; ++p) {
+      crc = table.t[(crc ^ *p) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+  }
+}
+
+Decode_error decompress_rtf(const uint8_t* data, size_t len, std::string& rtf) {
+  if (len < HEADER_SIZE) {
+    return Decode_error("compressed RTF header is truncated", __LINE__);
+  }
+
+  // the size counts everything after itself
+  const uint32_t compsize = le32(data);
+  const uint32_t rawsize = le32(data + 4);
+  const uint32_t comptype = le32(data + 8);
+  const uint32_t crc = le32(data + 12);
+
+  if (compsize < HEADER_SIZE - 4 || compsize > len - 4) {
+    return Decode_error("compressed RTF is truncated", __LINE__);
+  }
+
+  const uint8_t* p = data + HEADER_SIZE;
+  const uint8_t* const end = data + 4 + compsize;
+
+  if (comptype == UNCOMPRESSED) {
+    rtf.assign((const char*) p, std::min<size_t>(rawsize, end - p));
+    return Decode_error();
+  }
+
+  if (comptype != COMPRESSED) {
+    return Decode_error("unknown RTF compression type", __LINE__);
+  }
+
+  if (crc32(p, end - p) != crc) {
+    return Decode_error("compressed RTF fails its CRC check", __LINE__);
+  }
+
+  char dict[DICT_SIZE];
+  memcpy(dict, PREBUF, PREBUF_LEN);
+  size_t wpos = PREBUF_LEN;
+
+  rtf.clear();
+
+  // a reference expands 2 bytes to at most 17, so don't trust rawsize
+  // for more than that
+  rtf.reserve(std::min<size_t>(rawsize, (end - p) * 9));
+
+  while (p < end) {
+    const uint8_t control = *p++;
+
+    for (int bit = 0; bit < 8 && p < end; ++bit) {
+      if (control & (1 << bit)) {
+        if (end - p < 2) {
+          return Decode_error("compressed RTF is truncated", __LINE__);
+        }
+
+        const uint16_t ref = (p[0] << 8) | p[1];
+        p += 2;
+
+        size_t rpos = ref >> 4;
+        if (rpos == wpos) {
+          // a reference to the write position marks the end
+          p = end;
+          break;
+        }
+
+        // byte by byte, as a reference may overlap what it writes
+        for (size_t n = (ref & 0xf) + 2; n > 0; --n) {
+          const char c = dict[rpos];
+          rtf.push_back(c);
+          dict[wpos] = c;
+          rpos = (rpos + 1) % DICT_SIZE;
+          wpos = (wpos + 1) % DICT_SIZE;
+        }
+      }
+      else {
+        const char c = *p++;
+        rtf.push_back(c);
+        dict[wpos] = c;
+        wpos = (wpos + 1) % DICT_SIZE;
+      }
+    }
+  }
+
+  if (rtf.size() > rawsize) {
+    // writers may pad the last run
+    rtf.resize(rawsize);
+  }
+
+  return Decode_error();
+}
+
+namespace {
+  // windows-1252 0x80-0x9f; the five holes pass through as C1 controls
+  const uint16_t CP1252[32] = {
+    0x20ac, 0x0081, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021,
+    0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0x008d, 0x017d, 0x008f,
+    0x0090, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014,
+    0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0x009d, 0x017e, 0x0178
+  };
+
+  void put_utf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+      out.push_back(cp);
+    }
+    else if (cp < 0x800) {
+      out.push_back(0xc0 | (cp >> 6));
+      out.push_back(0x80 | (cp & 0x3f));
+    }
+    else if (cp < 0x10000) {
+      out.push_back(0xe0 | (cp >> 12));
+      out.push_back(0x80 | ((cp >> 6) & 0x3f));
+      out.push_back(0x80 | (cp & 0x3f));
+    }
+    else {
+      out.push_back(0xf0 | (cp >> 18));
+      out.push_back(0x80 | ((cp >> 12) & 0x3f));
+      out.push_back(0x80 | ((cp >> 6) & 0x3f));
+      out.push_back(0x80 | (cp & 0x3f));
+    }
+  }
+
+  // destinations whose contents are never part of the body
+  const char* const SKIPPED[] = {
+    "colortbl", "fonttbl", "footer", "header", "info", "listoverridetable",
+    "listtable", "pict", "rsidtbl", "stylesheet"
+  };
+
+  bool skipped(const std::string& word) {
+    for (size_t i = 0; i < sizeof(SKIPPED) / sizeof(SKIPPED[0]); ++i) {
+      if (word == SKIPPED[i]) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  struct Group {
+    Group(): skip(false), htmltag(false), suppress(false), uc(1) {}
+
+    bool skip;      // an ignored destination
+    bool htmltag;   // an \*\htmltag destination, holding HTML verbatim
+    bool suppress;  // inside \htmlrtf, i.e., RTF-only content
+    int uc;         // bytes standing in for each \u
+  };
+
+  class Deencapsulator {
+  public:
+    Deencapsulator(const std::string& r, std::string& o):
+      rtf(r), out(o), pos(0), group_start(false), star(false),
+      skip_chars(0), high(0), codepage(1252), depth(0) {}
+
+    Rtf_encapsulation header();
+    void body();
+
+  private:
+    bool next_word(std::string& word, bool& has_param, long& param);
+
+    void control_word(const std::string& word, bool has_param, long param);
+
+    bool emitting() const {
+      return !cur.skip && (cur.htmltag || !cur.suppress);
+    }
+
+    void emit(uint32_t cp) {
+      if (skip_chars > 0) {
+        --skip_chars;
+        return;
+      }
+
+      end_surrogate();
+      if (emitting()) {
+        put_utf8(out, cp);
+      }
+    }
+
+    // a high surrogate not followed by a low one stands for nothing
+    void end_surrogate() {
+      if (high) {
+        high = 0;
+        if (emitting()) {
+          put_utf8(out, 0xfffd);
+        }
+      }
+    }
+
+    void emit_byte(uint8_t b) {
+      if (b < 0x80) {
+        emit(b);
+      }
+      else if (codepage == 1252) {
+        emit(b < 0xa0 ? CP1252[b - 0x80] : b);
+      }
+      else {
+        emit(0xfffd);
+      }
+    }
+
+    const std::string& rtf;
+    std::string& out;
+    size_t pos;
+
+    std::vector<Group> stack;
+    Group cur;
+
+    bool group_start;
+    bool star;
+    int skip_chars;
+
+    // the high surrogate of a \u, until the low one in the next
+    uint32_t high;
+
+    long codepage;
+
+    size_t depth;
+  };
+
+  // reads a control word and its parameter, after the backslash
+  bool Deencapsulator::next_word(std::string& word, bool& has_param, long& param) {
+    const size_t n = rtf.size();
+
+    const size_t start = pos;
+    while (pos < n && isalpha((unsigned char) rtf[pos])) {
+      ++pos;
+    }
+
+    if (pos == start) {
+      return false;
+    }
+
+    word.assign(rtf, start, pos - start);
+
+    has_param = false;
+    param = 0;
+    if (pos < n && (rtf[pos] == '-' || isdigit((unsigned char) rtf[pos]))) {
+      const size_t pstart = pos++;
+      while (pos < n && isdigit((unsigned char) rtf[pos])) {
+        ++pos;
+      }
+      has_param = true;
+      param = strtol(rtf.c_str() + pstart, 0, 10);
+    }
+
+    // a space delimiting a control word is part of it
+    if (pos < n && rtf[pos] == ' ') {
+      ++pos;
+    }
+
+    return true;
+  }
+
+  // looks for \fromhtml1 or \fromtext before the first nested group
+  Rtf_encapsulation Deencapsulator::header() {
+    const size_t n = rtf.size();
+
+    while (pos < n) {
+      const char c = rtf[pos++];
+      if (c == '{') {
+        if (++depth > 1) {
+          break;
+        }
+      }
+      else if (c == '}') {
+        break;
+      }
+      else if (c == '\\') {
+        std::string word;
+        bool has_param;
+        long param;
+        if (next_word(word, has_param, param)) {
+          if (word == "fromhtml" && has_param && param == 1) {
+            return RTF_HTML;
+          }
+          else if (word == "fromtext") {
+            return RTF_TEXT;
+          }
+        }
+      }
+    }
+
+    return RTF_NATIVE;
+  }
+
+  void Deencapsulator::control_word(const std::string& word, bool has_param, long param) {
+    if (group_start) {
+      group_start = false;
+
+      if (star) {
+        star = false;
+
+        // unknown \* destinations are to be ignored
+        if (word.compare(0, 7, "htmltag") == 0) {
+          cur.htmltag = true;
+        }
+        else {
+          cur.skip = true;
+        }
+        return;
+      }
+
+      if (skipped(word)) {
+        cur.skip = true;
+        return;
+      }
+    }
+
+    if (word == "htmlrtf") {
+      cur.suppress = !(has_param && param == 0);
+    }
+    else if (word == "par" || word == "line") {
+      emit('\r');
+      emit('\n');
+    }
+    else if (word == "tab") {
+      emit('\t');
+    }
+    else if (word == "uc") {
+      cur.uc = param;
+    }
+    else if (word == "u") {
+      // the bytes standing in for the last \u are over, if they weren't
+      skip_chars = 0;
+
+      // negative values are UTF-16 code units past 32767
+      const uint32_t unit = param < 0 ? param + 65536 : param;
+      if (unit >= 0xd800 && unit < 0xdc00) {
+        end_surrogate();
+        high = unit;
+      }
+      else if (unit >= 0xdc00 && unit < 0xe000) {
+        if (high) {
+          const uint32_t cp = 0x10000 + ((high - 0xd800) << 10) + (unit - 0xdc00);
+          high = 0;
+          emit(cp);
+        }
+        else {
+          emit(0xfffd);
+        }
+      }
+      else {
+        emit(unit);
+      }
+
+      skip_chars = cur.uc;
+      return;
+    }
+    else if (word == "ansicpg") {
+      codepage = param;
+    }
+    else if (word == "lquote") {
+      emit(0x2018);
+    }
+    else if (word == "rquote") {
+      emit(0x2019);
+    }
+    else if (word == "ldblquote") {
+      emit(0x201c);
+    }
+    else if (word == "rdblquote") {
+      emit(0x201d);
+    }
+    else if (word == "bullet") {
+      emit(0x2022);
+    }
+    else if (word == "endash") {
+      emit(0x2013);
+    }
+    else if (word == "emdash") {
+      emit(0x2014);
+    }
+
+    // any other control word ends the bytes standing in for a \u, and
+    // any pair of surrogates
+    skip_chars = 0;
+    end_surrogate();
+  }
+
+  void Deencapsulator::body() {
+    const size_t n = rtf.size();
+
+    pos = 0;
+    while (pos < n) {
+      const char c = rtf[pos++];
+
+      switch (c) {
+      case '{':
+        end_surrogate();
+        stack.push_back(cur);
+        group_start = true;
+        star = false;
+        break;
+      case '}':
+        end_surrogate();
+        if (stack.empty()) {
+          return;
+        }
+        cur = stack.back();
+        stack.pop_back();
+        group_start = false;
+        break;
+      case '\\':
+        if (pos >= n) {
+          break;
+        }
+
+        switch (const char d = rtf[pos]) {
+        case '*':
+          ++pos;
+          star = true;
+          break;
+        case '\'':
+          if (pos + 2 < n) {
+            const char hex[3] = { rtf[pos + 1], rtf[pos + 2], 0 };
+            emit_byte(strtoul(hex, 0, 16));
+          }
+          pos += 3;
+          group_start = false;
+          break;
+        case '{':
+        case '}':
+        case '\\':
+          ++pos;
+          emit(d);
+          group_start = false;
+          break;
+        case '\r':
+        case '\n':
+          // a backslash before a newline is a \par
+          ++pos;
+          emit('\r');
+          emit('\n');
+          group_start = false;
+          break;
+        case '~':
+          ++pos;
+          emit(0xa0);
+          group_start = false;
+          break;
+        case '_':
+          ++pos;
+          emit('-');
+          group_start = false;
+          break;
+        default:
+          {
+            std::string word;
+            bool has_param;
+            long param;
+            if (next_word(word, has_param, param)) {
+              control_word(word, has_param, param);
+            }
+            else {
+              // any other control symbol
+              ++pos;
+              group_start = false;
+            }
+          }
+        }
+        break;
+      case '\r':
+      case '\n':
+        // literal newlines mean nothing in RTF
+        break;
+      default:
+        group_start = false;
+        emit_byte(c);
+      }
+    }
+
+    end_surrogate();
+  }
+}
+
+Rtf_encapsulation deencapsulate_rtf(const std::string& rtf, std::string& body) {
+  std::string out;
+  Deencapsulator d(rtf, out);
+
+  const Rtf_encapsulation mode = d.header();
+  if (mode != RTF_NATIVE) {
+    d.body();
+    body.swap(out);
+  }
+
+  return mode;
+}
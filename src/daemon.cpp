@@ -0,0 +1,674 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "daemon.h"
+#include "json_writer.h"
+
+namespace {
+
+std::runtime_error sys_error(const std::string& what) {
+  return std::runtime_error(what + ": " + std::strerror(errno));
+}
+
+//
+// Just enough JSON for requests: one object, whose values are strings,
+// numbers or literals, but not objects or arrays.
+//
+class Request_parser {
+public:
+  Request_parser(const std::string& s): str(s), pos(0) {}
+
+  Job_request parse() {
+    Job_request req;
+
+    expect('{');
+    if (!consume('}')) {
+      do {
+        const std::string key(string_value());
+        expect(':');
+        req[key] = value();
+      } while (consume(','));
+      expect('}');
+    }
+
+    skip_space();
+    if (pos != str.size()) {
+      fail("trailing characters");
+    }
+
+    return req;
+  }
+
+private:
+  void skip_space() {
+    while (pos < str.size() && str[pos] && std::strchr(" \t\r\n", str[pos])) {
+      ++pos;
+    }
+  }
+
+  bool consume(char c) {
+    skip_space();
+    if (pos < str.size() && str[pos] == c) {
+      ++pos;
+      return true;
+    }
+    return false;
+  }
+
+  void expect(char c) {
+    if (!consume(c)) {
+      fail(std::string("expected '") + c + '\'');
+    }
+  }
+
+  std::string value() {
+    skip_space();
+    if (pos < str.size() && str[pos] == '"') {
+      return string_value();
+    }
+
+    // a number or a literal, kept as written
+    const size_t start = pos;
+    while (pos < str.size() && (std::isalnum((unsigned char) str[pos]) || (str[pos] && std::strchr("+-.", str[pos])))) {
+      ++pos;
+    }
+
+    if (pos == start) {
+      fail("expected a string, number or literal");
+    }
+
+    return str.substr(start, pos - start);
+  }
+
+  std::string string_value() {
+    if (!consume('"')) {
+      fail("expected a string");
+    }
+
+    std::string s;
+    for (;;) {
+      if (pos >= str.size()) {
+        fail("unterminated string");
+      }
+
+      const char c = str[pos++];
+      if (c == '"') {
+        return s;
+      }
+      else if (c != '\\') {
+        s += c;
+        continue;
+      }
+
+      if (pos >= str.size()) {
+        fail("unterminated string");
+      }
+
+      switch (str[pos++]) {
+      case '"':  s += '"';  break;
+      case '\\': s += '\\'; break;
+      case '/':  s += '/';  break;
+      case 'b':  s += '\b'; break;
+      case 'f':  s += '\f'; break;
+      case 'n':  s += '\n'; break;
+      case 'r':  s += '\r'; break;
+      case 't':  s += '\t'; break;
+      case 'u':
+        {
+          uint32_t cp = hex4();
+          if (cp >= 0xD800 && cp < 0xDC00 && str.compare(pos, 2, "\\u") == 0) {
+            pos += 2;
+            const uint32_t lo = hex4();
+            if (lo < 0xDC00 || lo >= 0xE000) {
+              fail("unpaired surrogate");
+            }
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+          }
+          else if (cp >= 0xD800 && cp < 0xE000) {
+            fail("unpaired surrogate");
+          }
+          append_utf8(s, cp);
+        }
+        break;
+      default:
+        fail("bad escape");
+      }
+    }
+  }
+
+  uint32_t hex4() {
+    if (pos + 4 > str.size()) {
+      fail("bad escape");
+    }
+
+    uint32_t v = 0;
+    for (size_t end = pos + 4; pos < end; ++pos) {
+      const char c = str[pos];
+      v <<= 4;
+      if (c >= '0' && c <= '9') {
+        v |= c - '0';
+      }
+      else if (c >= 'a' && c <= 'f') {
+        v |= c - 'a' + 10;
+      }
+      else if (c >= 'A' && c <= 'F') {
+        v |= c - 'A' + 10;
+      }
+      else {
+        fail("bad escape");
+      }
+    }
+    return v;
+  }
+
+  static void append_utf8(std::string& s, uint32_t cp) {
+    if (cp < 0x80) {
+      s += (char) cp;
+    }
+    else if (cp < 0x800) {
+      s += (char) (0xC0 | (cp >> 6));
+      s += (char) (0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000) {
+      s += (char) (0xE0 | (cp >> 12));
+      s += (char) (0x80 | ((cp >> 6) & 0x3F));
+      s += (char) (0x80 | (cp & 0x3F));
+    }
+    else {
+      s += (char) (0xF0 | (cp >> 18));
+      s += (char) (0x80 | ((cp >> 12) & 0x3F));
+      s += (char) (0x80 | ((cp >> 6) & 0x3F));
+      s += (char) (0x80 | (cp & 0x3F));
+    }
+  }
+
+  [[noreturn]] void fail(const std::string& what) {
+    throw std::runtime_error("bad request: " + what);
+  }
+
+  const std::string& str;
+  size_t pos;
+};
+
+//
+// Buffered output to a connection. Once the peer has gone, writes fail,
+// and broken is set, which cancels the job writing them.
+//
+class Socket_buf: public std::streambuf {
+public:
+  Socket_buf(int f, std::atomic<bool>& b): fd(f), broken(b) {
+    setp(buf, buf + sizeof(buf));
+  }
+
+protected:
+  int overflow(int c) {
+    if (drain() == -1) {
+      return traits_type::eof();
+    }
+
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+    }
+
+    return traits_type::not_eof(c);
+  }
+
+  int sync() { return drain(); }
+
+private:
+  int drain() {
+    const char* p = pbase();
+    while (p < pptr()) {
+      // MSG_NOSIGNAL, so a departed peer is an error, not a SIGPIPE
+      const ssize_t n = send(fd, p, pptr() - p, MSG_NOSIGNAL);
+      if (n == -1) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        broken = true;
+        setp(buf, buf + sizeof(buf));
+        return -1;
+      }
+      p += n;
+    }
+
+    setp(buf, buf + sizeof(buf));
+    return 0;
+  }
+
+  int fd;
+  std::atomic<bool>& broken;
+  char buf[65536];
+};
+
+void write_status(std::ostream& out, const char* key, const std::string& id, const char* status, const std::string& error) {
+  out << '{' << quote(key) << ':' << quote(id)
+      << ",\"status\":" << quote(status);
+  if (!error.empty()) {
+    out << ",\"error\":" << quote(error);
+  }
+  out << "}\n";
+}
+
+// for answering before there is a job, or when there won't be one
+void write_status(int fd, const char* key, const std::string& id, const char* status, const std::string& error) {
+  std::atomic<bool> broken(false);
+  Socket_buf sbuf(fd, broken);
+  std::ostream out(&sbuf);
+  write_status(out, key, id, status, error);
+  out.flush();
+}
+
+// A connection whose request is on its way, until its deadline.
+struct Incoming {
+  int fd;
+  std::string line;
+  std::chrono::steady_clock::time_point deadline;
+};
+
+// Reads what has come of a request line, without waiting for more, and
+// returns whether it is all there.
+bool read_request(Incoming& in) {
+  static const size_t MAX_REQUEST = 1 << 20;
+
+  char buf[4096];
+  for (;;) {
+    const ssize_t n = recv(in.fd, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n == -1) {
+      if (errno == EINTR) {
+        continue;
+      }
+      else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return false;
+      }
+      throw sys_error("cannot read request");
+    }
+    else if (n == 0) {
+      // end of input will do for the end of the line
+      return true;
+    }
+
+    in.line.append(buf, n);
+
+    const size_t nl = in.line.find('\n');
+    if (nl != std::string::npos) {
+      in.line.resize(nl);
+      return true;
+    }
+
+    if (in.line.size() > MAX_REQUEST) {
+      throw std::runtime_error("request too long");
+    }
+  }
+}
+
+class Server {
+public:
+  Server(const Job_runner& r, const std::string& o): run(r), output_dir(o), stopping(false) {}
+
+  ~Server() { stop(); }
+
+  void start(unsigned int workers) {
+    for (unsigned int i = 0; i < workers; ++i) {
+      threads.push_back(std::thread(&Server::work, this));
+    }
+  }
+
+  // Takes a connection with its request: queues its job, or carries out
+  // its cancel request, and closes it.
+  void accept(int fd, const std::string& line);
+
+  // Cancels all jobs, queued or running, and waits for the workers.
+  void stop();
+
+private:
+  typedef boost::shared_ptr<std::atomic<bool> > CancelPtr;
+
+  struct Job {
+    int fd;
+    std::string id;
+    Job_request req;
+    CancelPtr cancel;
+  };
+
+  void work();
+  void execute(const Job& job);
+
+  const Job_runner& run;
+
+  // where jobs may write output files, if anywhere
+  const std::string output_dir;
+
+  std::mutex mutex;
+  std::condition_variable ready;
+  std::deque<Job> queue;
+  bool stopping;
+
+  // the queued and running jobs with ids, for cancel requests
+  std::map<std::string, CancelPtr> jobs;
+
+  std::vector<std::thread> threads;
+};
+
+void Server::accept(int fd, const std::string& line) {
+  Job job;
+
+  try {
+    job.req = parse_job_request(line);
+  }
+  catch (const std::runtime_error& e) {
+    write_status(fd, "job", "", "failed", e.what());
+    close(fd);
+    return;
+  }
+
+  Job_request::const_iterator i(job.req.find("cancel"));
+  if (i != job.req.end()) {
+    bool found = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      std::map<std::string, CancelPtr>::const_iterator j(jobs.find(i->second));
+      if (j != jobs.end()) {
+        *j->second = true;
+        found = true;
+      }
+    }
+
+    write_status(fd, "cancel", i->second, found ? "done" : "failed", found ? "" : "no such job");
+    close(fd);
+    return;
+  }
+
+  i = job.req.find("id");
+  if (i != job.req.end()) {
+    job.id = i->second;
+  }
+
+  job.fd = fd;
+  job.cancel.reset(new std::atomic<bool>(false));
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (job.id.empty() || jobs.insert(std::make_pair(job.id, job.cancel)).second) {
+      queue.push_back(job);
+      ready.notify_one();
+      return;
+    }
+  }
+
+  write_status(fd, "job", job.id, "failed", "duplicate job id");
+  close(fd);
+}
+
+void Server::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) {
+      return;
+    }
+
+    stopping = true;
+
+    for (std::map<std::string, CancelPtr>::const_iterator i(jobs.begin()); i != jobs.end(); ++i) {
+      *i->second = true;
+    }
+
+    // jobs without ids aren't in jobs
+    for (std::deque<Job>::const_iterator i(queue.begin()); i != queue.end(); ++i) {
+      *i->cancel = true;
+    }
+  }
+
+  ready.notify_all();
+
+  // running jobs don't see stopping, but they have been cancelled
+  for (std::vector<std::thread>::iterator i(threads.begin()); i != threads.end(); ++i) {
+    i->join();
+  }
+}
+
+void Server::work() {
+  for (;;) {
+    Job job;
+
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (queue.empty() && !stopping) {
+        ready.wait(lock);
+      }
+
+      // the queue is drained before stopping, so every client hears back
+      if (queue.empty()) {
+        return;
+      }
+
+      job = queue.front();
+      queue.pop_front();
+
+      if (stopping) {
+        *job.cancel = true;
+      }
+    }
+
+    execute(job);
+
+    if (!job.id.empty()) {
+      std::lock_guard<std::mutex> lock(mutex);
+      jobs.erase(job.id);
+    }
+  }
+}
+
+void Server::execute(const Job& job) {
+  Socket_buf sbuf(job.fd, *job.cancel);
+  std::ostream sock(&sbuf);
+
+  std::string error;
+
+  if (!*job.cancel) {
+    try {
+      Job_request::const_iterator o(job.req.find("output"));
+      if (o != job.req.end()) {
+        // clients name files in the output directory, and nothing else
+        if (output_dir.empty()) {
+          throw std::runtime_error("output files are not allowed");
+        }
+        if (o->second.empty() || o->second == "." || o->second == ".." ||
+            o->second.find('/') != std::string::npos)
+        {
+          throw std::runtime_error("bad output file name: " + o->second);
+        }
+
+        std::ofstream file((output_dir + '/' + o->second).c_str());
+        if (!file) {
+          throw std::runtime_error("cannot open " + o->second);
+        }
+
+        run(job.req, file, *job.cancel);
+
+        file.close();
+        if (!file) {
+          throw std::runtime_error("cannot write " + o->second);
+        }
+      }
+      else {
+        run(job.req, sock, *job.cancel);
+      }
+    }
+    catch (const std::exception& e) {
+      error = e.what();
+    }
+  }
+
+  if (*job.cancel) {
+    write_status(sock, "job", job.id, "cancelled", "");
+  }
+  else {
+    write_status(sock, "job", job.id, error.empty() ? "done" : "failed", error);
+  }
+
+  sock.flush();
+  close(job.fd);
+}
+
+volatile sig_atomic_t stop_requested = 0;
+
+extern "C" void request_stop(int) {
+  stop_requested = 1;
+}
+
+}
+
+Job_request parse_job_request(const std::string& line) {
+  return Request_parser(line).parse();
+}
+
+void serve(const std::string& socket_path, unsigned int workers, const std::string& output_dir, const Job_runner& run) {
+  struct sockaddr_un addr;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+
+  if (socket_path.size() >= sizeof(addr.sun_path)) {
+    throw std::runtime_error("socket path too long: " + socket_path);
+  }
+  std::strcpy(addr.sun_path, socket_path.c_str());
+
+  // a socket left behind by an earlier daemon would make bind fail
+  struct stat st;
+  if (stat(socket_path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+    unlink(socket_path.c_str());
+  }
+
+  const int lfd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (lfd == -1) {
+    throw sys_error("cannot create socket");
+  }
+
+  // jobs read and write files as the daemon's user, so only that user
+  // may connect
+  const mode_t old_mask = umask(0177);
+  const int bound = bind(lfd, (struct sockaddr*) &addr, sizeof(addr));
+  umask(old_mask);
+
+  if (bound == -1 || listen(lfd, SOMAXCONN) == -1) {
+    const int err = errno;
+    close(lfd);
+    errno = err;
+    throw sys_error("cannot listen on " + socket_path);
+  }
+
+  // no SA_RESTART, so a signal interrupts the poll below
+  struct sigaction sa, old_int, old_term;
+  std::memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = &request_stop;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, &old_int);
+  sigaction(SIGTERM, &sa, &old_term);
+
+  Server server(run, output_dir);
+  server.start(workers);
+
+  // Requests are read here as they come, so that a slow client holds up
+  // neither the others nor cancel requests; slow ones get 5 seconds.
+  typedef std::chrono::steady_clock Clock;
+  const Clock::duration REQUEST_TIMEOUT = std::chrono::seconds(5);
+
+  std::vector<Incoming> incoming;
+  std::vector<struct pollfd> fds;
+
+  while (!stop_requested) {
+    // time out now and then, in case a signal fell between the check
+    // and the poll
+    int timeout = 1000;
+    Clock::time_point now = Clock::now();
+
+    fds.resize(1);
+    fds[0].fd = lfd;
+    fds[0].events = POLLIN;
+    for (std::vector<Incoming>::const_iterator i(incoming.begin()); i != incoming.end(); ++i) {
+      const struct pollfd p = { i->fd, POLLIN, 0 };
+      fds.push_back(p);
+
+      const long left = std::chrono::duration_cast<std::chrono::milliseconds>(i->deadline - now).count() + 1;
+      timeout = std::max(0L, std::min<long>(timeout, left));
+    }
+
+    if (poll(fds.data(), fds.size(), timeout) == -1) {
+      continue;
+    }
+
+    now = Clock::now();
+
+    std::vector<Incoming> waiting;
+    for (size_t i = 0; i < incoming.size(); ++i) {
+      Incoming& in = incoming[i];
+      try {
+        if (fds[i + 1].revents && read_request(in)) {
+          server.accept(in.fd, in.line);
+        }
+        else if (now >= in.deadline) {
+          throw std::runtime_error("cannot read request: timed out");
+        }
+        else {
+          waiting.push_back(in);
+        }
+      }
+      catch (const std::runtime_error& e) {
+        write_status(in.fd, "job", "", "failed", e.what());
+        close(in.fd);
+      }
+    }
+    incoming.swap(waiting);
+
+    if (fds[0].revents) {
+      const int fd = accept4(lfd, 0, 0, SOCK_CLOEXEC);
+      if (fd == -1) {
+        if (errno == EMFILE || errno == ENFILE) {
+          // out of descriptors until some job finishes; don't spin
+          usleep(100000);
+        }
+        continue;
+      }
+
+      const Incoming in = { fd, std::string(), now + REQUEST_TIMEOUT };
+      incoming.push_back(in);
+    }
+  }
+
+  // requests still on their way
+  for (std::vector<Incoming>::const_iterator i(incoming.begin()); i != incoming.end(); ++i) {
+    write_status(i->fd, "job", "", "failed", "stopping");
+    close(i->fd);
+  }
+
+  server.stop();
+
+  close(lfd);
+  unlink(socket_path.c_str());
+
+  sigaction(SIGINT, &old_int, 0);
+  sigaction(SIGTERM, &old_term, 0);
+}
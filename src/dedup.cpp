@@ -0,0 +1,303 @@
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <strings.h>
+#include <unistd.h>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "context.h"
+#include "dedup.h"
+
+namespace {
+  const size_t RECORD_LEN = 16;
+
+  // reads a string into s, leaving it empty if there is none
+  template <typename L, typename G> bool read_string(
+    L length_getter,
+    G value_getter,
+    std::string& s,
+    const std::string& path,
+    Context& ctx)
+  {
+    s.clear();
+
+    libpff_error_t* error = 0;
+    size_t len;
+    switch (length_getter(&len, &error)) {
+    case -1:
+      report(ctx, "dedup", path, Decode_error(error, __LINE__));
+      return false;
+    case  0:
+      return true;
+    }
+
+    if (len == 0) {
+      return true;
+    }
+
+    s.resize(len);
+    if (value_getter((uint8_t*) &s[0], len, &error) != 1) {
+      report(ctx, "dedup", path, Decode_error(error, __LINE__));
+      return false;
+    }
+
+    // the length includes the NUL
+    s.resize(std::strlen(s.c_str()));
+    return true;
+  }
+
+  bool read_message_string(libpff_item_t* item, uint32_t etype, std::string& s, const std::string& path, Context& ctx) {
+    return read_string(
+      boost::bind(&libpff_message_get_entry_value_utf8_string_size, item, etype, _1, _2),
+      boost::bind(&libpff_message_get_entry_value_utf8_string, item, etype, _1, _2, _3),
+      s, path, ctx
+    );
+  }
+
+  bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+  }
+
+  // Appends s to key, length first, with each run of whitespace as one
+  // space and none at the ends, and with ASCII lowercased if lower.
+  // Returns false if that leaves nothing of s.
+  bool append_normalized(std::string& key, const std::string& s, bool lower) {
+    std::string n;
+    n.reserve(s.size());
+
+    bool space = false;
+    for (std::string::const_iterator i(s.begin()); i != s.end(); ++i) {
+      if (is_space(*i)) {
+        space = !n.empty();
+        continue;
+      }
+
+      if (space) {
+        n += ' ';
+        space = false;
+      }
+
+      n += lower && *i >= 'A' && *i <= 'Z' ? *i + ('a' - 'A') : *i;
+    }
+
+    key += boost::lexical_cast<std::string>(n.size());
+    key += ':';
+    key += n;
+
+    return !n.empty();
+  }
+
+  // Sets id to the value of the Message-ID header in headers, if any.
+  void find_message_id(const std::string& headers, std::string& id) {
+    static const char NAME[] = "message-id:";
+    static const size_t NAME_LEN = sizeof(NAME) - 1;
+
+    id.clear();
+
+    for (size_t b = 0; b < headers.size(); ) {
+      size_t e = headers.find('\n', b);
+      if (e == std::string::npos) {
+        e = headers.size();
+      }
+
+      if (e - b >= NAME_LEN && strncasecmp(&headers[b], NAME, NAME_LEN) == 0) {
+        // the value may be folded onto the lines after
+        while (e + 1 < headers.size() && (headers[e + 1] == ' ' || headers[e + 1] == '\t')) {
+          e = headers.find('\n', e + 1);
+          if (e == std::string::npos) {
+            e = headers.size();
+          }
+        }
+
+        id.assign(headers, b + NAME_LEN, e - b - NAME_LEN);
+        return;
+      }
+
+      b = e + 1;
+    }
+  }
+
+  uint64_t mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+  }
+
+  // two FNV-1a style lanes with different primes, each mixed at the end
+  void hash(const std::string& key, Fingerprint& fp) {
+    uint64_t a = 0xCBF29CE484222325ULL;
+    uint64_t b = 0x6C62272E07BB0142ULL;
+
+    for (std::string::const_iterator i(key.begin()); i != key.end(); ++i) {
+      const uint8_t c = *i;
+      a = (a ^ c) * 0x00000100000001B3ULL;
+      b = (b ^ c) * 0x9E3779B97F4A7C15ULL;
+    }
+
+    fp.hi = mix(a ^ key.size());
+    fp.lo = mix(b + key.size());
+  }
+
+  void put_le64(char* p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+      p[i] = (char) (v >> (8 * i));
+    }
+  }
+
+  uint64_t get_le64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+      v |= (uint64_t) (uint8_t) p[i] << (8 * i);
+    }
+    return v;
+  }
+}
+
+std::string Fingerprint::hex() const {
+  static const char DIGITS[] = "0123456789abcdef";
+
+  std::string s(32, '0');
+  for (int i = 0; i < 16; ++i) {
+    s[15 - i] = DIGITS[(hi >> (4 * i)) & 0xF];
+    s[31 - i] = DIGITS[(lo >> (4 * i)) & 0xF];
+  }
+  return s;
+}
+
+bool message_fingerprint(const Pst_item& item, Fingerprint& fp, Context& ctx) {
+  if (!item.type_known ||
+      (item.type != LIBPFF_ITEM_TYPE_EMAIL && item.type != LIBPFF_ITEM_TYPE_EMAIL_SMIME)) {
+    return false;
+  }
+
+  libpff_item_t* m = item.handle;
+  std::string key;
+  std::string s;
+
+  // Message-ID
+  if (!read_message_string(m, LIBPFF_ENTRY_TYPE_MESSAGE_TRANSPORT_HEADERS, s, item.path, ctx)) {
+    return false;
+  }
+
+  std::string id;
+  find_message_id(s, id);
+  const bool have_id = append_normalized(key, id, true);
+
+  // client submit time
+  libpff_error_t* error = 0;
+  uint64_t submit = 0;
+  const int have_submit = libpff_message_get_client_submit_time(m, &submit, &error);
+  if (have_submit == -1) {
+    report(ctx, "dedup", item.path, Decode_error(error, __LINE__));
+    return false;
+  }
+
+  if (!have_id && !have_submit) {
+    // too little to tell one message from another
+    return false;
+  }
+
+  key += boost::lexical_cast<std::string>(submit);
+  key += ';';
+
+  // sender, by address if it has one
+  if (!read_message_string(m, LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_EMAIL_ADDRESS, s, item.path, ctx)) {
+    return false;
+  }
+
+  if (s.empty() && !read_message_string(m, LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_NAME, s, item.path, ctx)) {
+    return false;
+  }
+
+  append_normalized(key, s, true);
+
+  // subject
+  if (!read_message_string(m, LIBPFF_ENTRY_TYPE_MESSAGE_SUBJECT, s, item.path, ctx)) {
+    return false;
+  }
+
+  append_normalized(key, s, false);
+
+  // body, whose line endings depend on the store
+  if (!read_string(
+        boost::bind(&libpff_message_get_plain_text_body_size, m, _1, _2),
+        boost::bind(&libpff_message_get_plain_text_body, m, _1, _2, _3),
+        s, item.path, ctx)) {
+    return false;
+  }
+
+  append_normalized(key, s, false);
+
+  hash(key, fp);
+  return true;
+}
+
+Seen_set::Seen_set(const char* journal) {
+  if (!journal) {
+    return;
+  }
+
+  std::ifstream in(journal, std::ios::binary);
+  if (in) {
+    char rec[RECORD_LEN];
+    Fingerprint fp;
+    off_t len = 0;
+
+    while (in.read(rec, RECORD_LEN)) {
+      fp.hi = get_le64(rec);
+      fp.lo = get_le64(rec + 8);
+      shards[fp.hi % SHARDS].seen.insert(fp);
+      len += RECORD_LEN;
+    }
+
+    // drop any partial record an interrupted run left, so what is
+    // appended lines up
+    if (in.gcount() > 0 && truncate(journal, len) == -1) {
+      throw std::runtime_error(std::string("cannot truncate ") + journal + ": " + std::strerror(errno));
+    }
+  }
+
+  out.open(journal, std::ios::binary | std::ios::app);
+  if (!out) {
+    throw std::runtime_error(std::string("cannot open ") + journal);
+  }
+}
+
+bool Seen_set::insert(const Fingerprint& fp) {
+  Shard& shard = shards[fp.hi % SHARDS];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  return shard.seen.insert(fp).second;
+}
+
+void Seen_set::commit(const Fingerprint& fp) {
+  if (out.is_open()) {
+    char rec[RECORD_LEN];
+    put_le64(rec, fp.hi);
+    put_le64(rec + 8, fp.lo);
+
+    std::lock_guard<std::mutex> lock(journal_mutex);
+    out.write(rec, RECORD_LEN);
+  }
+}
+
+void Seen_set::erase(const Fingerprint& fp) {
+  Shard& shard = shards[fp.hi % SHARDS];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+
+  shard.seen.erase(fp);
+}
+
+void Seen_set::flush() {
+  std::lock_guard<std::mutex> lock(journal_mutex);
+
+  if (out.is_open() && !out.flush()) {
+    throw std::runtime_error("cannot write the dedup journal");
+  }
+}
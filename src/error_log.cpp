@@ -0,0 +1,178 @@
+#include <string_view>
+
+#include "error_log.h"
+#include "trace.h"
+#include "json_writer.h"
+
+Error_log::Error_log(std::ostream& o, unsigned long l):
+  out(&o), json(0), limit(l) {}
+
+Error_log::Error_log(JSON_writer& j, unsigned long l):
+  out(0), json(&j), limit(l) {}
+
+bool Error_log::admit(const char* category) {
+  Count_map::iterator i(counts.find(std::string_view(category)));
+
+  if (i == counts.end()) {
+    i = counts.insert(std::make_pair(std::string(category), Counts())).first;
+  }
+
+  if (i->second.reported >= limit) {
+    ++i->second.suppressed;
+    return false;
+  }
+
+  ++i->second.reported;
+  return true;
+}
+
+void Error_log::write(const char* category, const std::string& path,
+                      long set, long entry, long element,
+                      uint32_t line, const std::string& message)
+{
+  Error_record rec = { category, path, set, entry, element, line, message };
+  if (json) {
+    // records can't be written into the middle of an item record
+    pending.push_back(rec);
+  }
+  else {
+    write_ndjson(rec);
+  }
+}
+
+void Error_log::report(const char* category, const std::string& path,
+                       long set, long entry, long element,
+                       uint32_t line, const std::string& message)
+{
+  if (admit(category)) {
+    write(category, path, set, entry, element, line, message);
+  }
+}
+
+void Error_log::flush_pending() {
+  if (pending.empty()) {
+    return;
+  }
+
+  Trace_span span("error flush", "write", "errors", pending.size());
+
+  for (std::vector<Error_record>::const_iterator i(pending.begin());
+       i != pending.end(); ++i) {
+    write_inline(*i);
+  }
+  pending.clear();
+}
+
+void Error_log::flush_pending_except(const std::string& path) {
+  if (pending.empty()) {
+    return;
+  }
+
+  Trace_span span("error flush", "write", "errors", pending.size());
+
+  std::vector<Error_record> kept;
+  for (std::vector<Error_record>::const_iterator i(pending.begin());
+       i != pending.end(); ++i) {
+    if (i->path == path) {
+      kept.push_back(*i);
+    }
+    else {
+      write_inline(*i);
+    }
+  }
+  pending.swap(kept);
+}
+
+void Error_log::write_ndjson(const Error_record& rec) {
+  // no std::endl: flushing per record is what we're trying to avoid
+  *out << "{\"error\":" << quote(rec.message)
+       << ",\"category\":" << quote(rec.category)
+       << ",\"path\":" << quote(rec.path);
+
+  if (rec.set != NONE) {
+    *out << ",\"set\":" << rec.set;
+  }
+
+  if (rec.entry != NONE) {
+    *out << ",\"entry\":" << rec.entry;
+  }
+
+  if (rec.element != NONE) {
+    *out << ",\"element\":" << rec.element;
+  }
+
+  *out << ",\"line\":" << rec.line << "}\n";
+}
+
+void Error_log::write_inline(const Error_record& rec) {
+  json->object_open();
+
+  json->object_member_write("error", rec.message);
+  json->object_member_write("category", rec.category);
+  json->object_member_write("path", rec.path);
+
+  if (rec.set != NONE) {
+    json->object_member_write("set", rec.set);
+  }
+
+  if (rec.entry != NONE) {
+    json->object_member_write("entry", rec.entry);
+  }
+
+  if (rec.element != NONE) {
+    json->object_member_write("element", rec.element);
+  }
+
+  json->object_member_write("line", rec.line);
+
+  json->object_close();
+  json->reset();
+}
+
+void Error_log::write_summary() {
+  flush_pending();
+
+  if (json) {
+    json->object_open();
+    json->object_member_open("error summary");
+  }
+  else {
+    *out << "{\"error summary\":{";
+  }
+
+  for (Count_map::const_iterator i(counts.begin()); i != counts.end(); ++i) {
+    if (json) {
+      json->object_member_open(i->first);
+      json->object_member_write("reported", i->second.reported);
+      json->object_member_write("suppressed", i->second.suppressed);
+      json->object_member_close();
+    }
+    else {
+      if (i != counts.begin()) {
+        *out << ',';
+      }
+
+      *out << quote(i->first)
+           << ":{\"reported\":" << i->second.reported
+           << ",\"suppressed\":" << i->second.suppressed << '}';
+    }
+  }
+
+  if (json) {
+    json->object_member_close();
+    json->object_close();
+    json->reset();
+  }
+  else {
+    *out << "}}\n";
+  }
+}
+
+void Error_log::flush() {
+  flush_pending();
+
+  if (out) {
+    Trace_span span("error log flush", "write");
+    out->flush();
+  }
+}
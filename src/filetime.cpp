@@ -0,0 +1,129 @@
+#include <charconv>
+#include <cstring>
+
+#include "filetime.h"
+
+namespace {
+  const uint64_t TICKS_PER_SECOND = 10000000;
+  const uint64_t TICKS_PER_DAY = 86400 * TICKS_PER_SECOND;
+
+  // 1970-01-01 in ticks and in days since 1601-01-01
+  const uint64_t UNIX_EPOCH_TICKS = 116444736000000000ULL;
+  const int64_t UNIX_EPOCH_DAYS = 134774;
+
+  char* put_digits(char* p, unsigned int v, unsigned int width) {
+    for (char* q = p + width; q != p; v /= 10) {
+      *--q = '0' + v % 10;
+    }
+    return p + width;
+  }
+
+  char* put_decimal(char* p, uint64_t v) {
+    return std::to_chars(p, p + 20, v).ptr;
+  }
+
+  //
+  // Converts days since 1970-01-01 to a proleptic Gregorian date, after
+  // Howard Hinnant's civil_from_days.
+  //
+  void civil_from_days(int64_t z, int64_t& y, unsigned int& m, unsigned int& d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned int doe = z - era * 146097;
+    const unsigned int yoe = (doe - doe/1460 + doe/36524 - doe/146096) / 365;
+    const unsigned int doy = doe - (365*yoe + yoe/4 - yoe/100);
+    const unsigned int mp = (5*doy + 2) / 153;
+
+    d = doy - (153*mp + 2)/5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = yoe + era * 400 + (m <= 2);
+  }
+}
+
+Filetime_format::Filetime_format(Style s):
+  sty(s), day(UINT64_MAX), date_len(0) {}
+
+size_t Filetime_format::format(uint64_t ft, char* buf) {
+  char* p = buf;
+
+  switch (sty) {
+  case TICKS:
+    p = put_decimal(p, ft);
+    break;
+  case RFC3339:
+    return format_rfc3339(ft, buf);
+  case EPOCH_NS:
+    // a tick is 100ns, so scaling is appending zeros; this is exact over
+    // the whole FILETIME range, which int64 nanoseconds are not
+    if (ft < UNIX_EPOCH_TICKS) {
+      *p++ = '-';
+      p = put_decimal(p, UNIX_EPOCH_TICKS - ft);
+    }
+    else {
+      p = put_decimal(p, ft - UNIX_EPOCH_TICKS);
+    }
+
+    if (ft != UNIX_EPOCH_TICKS) {
+      *p++ = '0';
+      *p++ = '0';
+    }
+    break;
+  }
+
+  return p - buf;
+}
+
+size_t Filetime_format::format_rfc3339(uint64_t ft, char* buf) {
+  const uint64_t d = ft / TICKS_PER_DAY;
+
+  if (d != day) {
+    int64_t y;
+    unsigned int m, dd;
+    civil_from_days(int64_t(d) - UNIX_EPOCH_DAYS, y, m, dd);
+
+    char* p = date;
+    if (y > 9999) {
+      // past 9999 (only sentinels get there), expanded ISO 8601 years
+      *p++ = '+';
+      p = put_decimal(p, y);
+    }
+    else {
+      p = put_digits(p, y, 4);
+    }
+
+    *p++ = '-';
+    p = put_digits(p, m, 2);
+    *p++ = '-';
+    p = put_digits(p, dd, 2);
+    *p++ = 'T';
+
+    day = d;
+    date_len = p - date;
+  }
+
+  char* p = buf;
+  *p++ = '"';
+
+  memcpy(p, date, date_len);
+  p += date_len;
+
+  const uint64_t t = ft % TICKS_PER_DAY;
+  const unsigned int secs = t / TICKS_PER_SECOND;
+  const unsigned int frac = t % TICKS_PER_SECOND;
+
+  p = put_digits(p, secs / 3600, 2);
+  *p++ = ':';
+  p = put_digits(p, secs / 60 % 60, 2);
+  *p++ = ':';
+  p = put_digits(p, secs % 60, 2);
+
+  if (frac) {
+    *p++ = '.';
+    p = put_digits(p, frac, 7);
+  }
+
+  *p++ = 'Z';
+  *p++ = '"';
+
+  return p - buf;
+}
@@ -0,0 +1,276 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "image_range.h"
+
+Extent_list read_extents(const char* filename) {
+  std::ifstream in(filename);
+  if (!in) {
+    throw std::runtime_error(std::string("cannot open ") + filename);
+  }
+
+  Extent_list extents;
+
+  std::string line;
+  for (unsigned int lineno = 1; std::getline(in, line); ++lineno) {
+    const std::string::size_type first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+
+    std::istringstream ls(line);
+
+    Extent ext;
+    if (!(ls >> ext.offset >> ext.length)) {
+      std::ostringstream msg;
+      msg << filename << ':' << lineno << ": expected offset and length";
+      throw std::runtime_error(msg.str());
+    }
+
+    extents.push_back(ext);
+  }
+
+  if (extents.empty()) {
+    throw std::runtime_error(std::string(filename) + ": no fragments");
+  }
+
+  return extents;
+}
+
+Image_file::Image_file(const char* filename): fd(-1), len(0) {
+  fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    throw std::runtime_error(
+      std::string("cannot open ") + filename + ": " + std::strerror(errno)
+    );
+  }
+
+  // block devices report no size through fstat
+  const off_t end = lseek(fd, 0, SEEK_END);
+  if (end == -1) {
+    const int err = errno;
+    close(fd);
+    throw std::runtime_error(
+      std::string("cannot size ") + filename + ": " + std::strerror(err)
+    );
+  }
+
+  len = end;
+}
+
+Image_file::~Image_file() {
+  close(fd);
+}
+
+//
+// libbfio io handle callbacks
+//
+
+namespace {
+
+struct Range_io {
+  Range_io(const ImageFilePtr& i, const MappedFilePtr& m,
+           const Extent_list& e):
+    image(i), mapped(m), extents(e), size(0), offset(0), is_open(false)
+  {
+    for (Extent_list::const_iterator x(extents.begin());
+         x != extents.end(); ++x) {
+      size += x->length;
+    }
+  }
+
+  ImageFilePtr image;
+  MappedFilePtr mapped;
+  Extent_list extents;
+  uint64_t size;
+  off64_t offset;
+  bool is_open;
+};
+
+Range_io* io(intptr_t* io_handle) {
+  return reinterpret_cast<Range_io*>(io_handle);
+}
+
+int range_free(intptr_t** io_handle, libbfio_error_t**) {
+  delete io(*io_handle);
+  *io_handle = 0;
+  return 1;
+}
+
+int range_clone(intptr_t** dst, intptr_t* src, libbfio_error_t**) {
+  const Range_io* r = io(src);
+  *dst = reinterpret_cast<intptr_t*>(
+    new Range_io(r->image, r->mapped, r->extents)
+  );
+  return 1;
+}
+
+int range_open(intptr_t* io_handle, int access_flags, libbfio_error_t**) {
+  if (access_flags & LIBBFIO_ACCESS_FLAG_WRITE) {
+    return -1;
+  }
+
+  io(io_handle)->offset = 0;
+  io(io_handle)->is_open = true;
+  return 1;
+}
+
+int range_close(intptr_t* io_handle, libbfio_error_t**) {
+  io(io_handle)->is_open = false;
+  return 0;
+}
+
+ssize_t range_read(intptr_t* io_handle, uint8_t* buf, size_t size,
+                   libbfio_error_t**)
+{
+  Range_io* r = io(io_handle);
+
+  if (!r->is_open || r->offset < 0) {
+    return -1;
+  }
+
+  size_t done = 0;
+
+  // find the extent containing the current offset
+  uint64_t start = 0;
+  Extent_list::const_iterator x(r->extents.begin());
+  for ( ; x != r->extents.end() && start + x->length <= (uint64_t) r->offset;
+        ++x) {
+    start += x->length;
+  }
+
+  // a read may span several extents
+  for ( ; x != r->extents.end() && done < size; ++x) {
+    const uint64_t skip = r->offset - start;
+    const size_t n = std::min<uint64_t>(size - done, x->length - skip);
+    const uint64_t pos = x->offset + skip;
+
+    if (r->mapped) {
+      std::memcpy(buf + done, r->mapped->data() + pos, n);
+    }
+    else {
+      size_t got = 0;
+      while (got < n) {
+        const ssize_t ret = pread(
+          r->image->descriptor(), buf + done + got, n - got, pos + got
+        );
+
+        if (ret == -1) {
+          if (errno == EINTR) {
+            continue;
+          }
+          return -1;
+        }
+
+        if (ret == 0) {
+          return -1;
+        }
+
+        got += ret;
+      }
+    }
+
+    done += n;
+    r->offset += n;
+    start += x->length;
+  }
+
+  return done;
+}
+
+ssize_t range_write(intptr_t*, const uint8_t*, size_t, libbfio_error_t**) {
+  return -1;
+}
+
+off64_t range_seek(intptr_t* io_handle, off64_t offset, int whence,
+                   libbfio_error_t**)
+{
+  Range_io* r = io(io_handle);
+
+  switch (whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    offset += r->offset;
+    break;
+  case SEEK_END:
+    offset += r->size;
+    break;
+  default:
+    return -1;
+  }
+
+  if (offset < 0) {
+    return -1;
+  }
+
+  r->offset = offset;
+  return offset;
+}
+
+int range_exists(intptr_t*, libbfio_error_t**) {
+  return 1;
+}
+
+int range_is_open(intptr_t* io_handle, libbfio_error_t**) {
+  return io(io_handle)->is_open ? 1 : 0;
+}
+
+int range_get_size(intptr_t* io_handle, size64_t* size, libbfio_error_t**) {
+  *size = io(io_handle)->size;
+  return 1;
+}
+
+}
+
+libbfio_handle_t* create_range_handle(const ImageFilePtr& image,
+                                      const MappedFilePtr& mapped,
+                                      const Extent_list& extents)
+{
+  for (Extent_list::const_iterator x(extents.begin());
+       x != extents.end(); ++x) {
+    if (x->offset > image->size() || x->length > image->size() - x->offset) {
+      std::ostringstream msg;
+      msg << "extent " << x->offset << '+' << x->length
+          << " lies outside the image";
+      throw std::runtime_error(msg.str());
+    }
+  }
+
+  Range_io* r = new Range_io(image, mapped, extents);
+
+  libbfio_handle_t* handle = 0;
+  libbfio_error_t* error = 0;
+
+  if (libbfio_handle_initialize(
+    &handle,
+    reinterpret_cast<intptr_t*>(r),
+    &range_free,
+    &range_clone,
+    &range_open,
+    &range_close,
+    &range_read,
+    &range_write,
+    &range_seek,
+    &range_exists,
+    &range_is_open,
+    &range_get_size,
+    LIBBFIO_FLAG_IO_HANDLE_MANAGED | LIBBFIO_FLAG_IO_HANDLE_CLONE_BY_FUNCTION,
+    &error) != 1)
+  {
+    libbfio_error_free(&error);
+    delete r;
+    throw std::runtime_error("cannot create libbfio handle");
+  }
+
+  return handle;
+}
@@ -0,0 +1,151 @@
+#include <libpff.h>
+
+#include "index_visitor.h"
+#include "text_index.h"
+
+Index_visitor::Index_visitor(Pst_visitor& i, Index_writer& x, const std::vector<uint32_t>& entry_types):
+  inner(i), index(x), etypes(entry_types.begin(), entry_types.end()),
+  inner_values(false), inner_entry(true), index_entry(false) {}
+
+int Index_visitor::item_begin(const Pst_item& item) {
+  // the other visitor sees the item unless it didn't want its parent's
+  // sub-items
+  const bool seen = frames.empty() || frames.back().inner_sub_items;
+  const int wanted = seen ? inner.item_begin(item) : 0;
+  inner_values = wanted & VALUES;
+
+  Frame f;
+  f.folder = item.type == LIBPFF_ITEM_TYPE_FOLDER;
+  f.inner_sub_items = wanted & SUB_ITEMS;
+
+  // items in folders, or at the root of a walk, are those which can be
+  // looked up; the rest are theirs
+  if (frames.empty() || frames.back().folder) {
+    f.owner = item.identifier;
+    f.owner_known = item.identifier_known;
+  }
+  else {
+    f.owner = frames.back().owner;
+    f.owner_known = frames.back().owner_known;
+  }
+
+  frames.push_back(f);
+
+  // without an identifier, there is nothing to index values under
+  if (!f.owner_known) {
+    inner_entry = inner_values || f.inner_sub_items;
+    return wanted;
+  }
+
+  // until values_end, errors are the other visitor's only if it wants
+  // the values
+  inner_entry = inner_values;
+  return wanted | VALUES | SUB_ITEMS;
+}
+
+void Index_visitor::values_begin(const Pst_item& item, uint32_t sets, uint32_t entries) {
+  if (inner_values) {
+    inner.values_begin(item, sets, entries);
+  }
+}
+
+void Index_visitor::set_begin(const Pst_item& item, uint32_t set) {
+  if (inner_values) {
+    inner.set_begin(item, set);
+  }
+}
+
+void Index_visitor::entry_begin(const Pst_item& item, uint32_t set, uint32_t entry) {
+  inner_entry = inner_values;
+  index_entry = false;
+
+  if (inner_values) {
+    inner.entry_begin(item, set, entry);
+  }
+}
+
+bool Index_visitor::entry_type(const Pst_item& item, const Pst_entry& entry) {
+  inner_entry = inner_values && inner.entry_type(item, entry);
+
+  index_entry = frames.back().owner_known &&
+    (entry.value_type == LIBPFF_VALUE_TYPE_STRING_UNICODE ||
+     entry.value_type == LIBPFF_VALUE_TYPE_STRING_ASCII ||
+     entry.value_type == LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_UNICODE ||
+     entry.value_type == LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_ASCII) &&
+    etypes.count(entry.entry_type);
+
+  return inner_entry || index_entry;
+}
+
+void Index_visitor::value(const Pst_item& item, const Pst_entry& entry, const Pst_value& v) {
+  if (inner_entry) {
+    inner.value(item, entry, v);
+  }
+
+  if (index_entry && v.kind == Pst_value::STRING) {
+    index.add(frames.back().owner, (const char*) v.data, v.size);
+  }
+}
+
+void Index_visitor::multi_value_begin(const Pst_item& item, const Pst_entry& entry, size_t count) {
+  if (inner_entry) {
+    inner.multi_value_begin(item, entry, count);
+  }
+}
+
+void Index_visitor::element(const Pst_item& item, const Pst_entry& entry, size_t i, const Pst_value& v) {
+  if (inner_entry) {
+    inner.element(item, entry, i, v);
+  }
+
+  if (index_entry && v.kind == Pst_value::STRING) {
+    index.add(frames.back().owner, (const char*) v.data, v.size);
+  }
+}
+
+void Index_visitor::multi_value_end(const Pst_item& item, const Pst_entry& entry) {
+  if (inner_entry) {
+    inner.multi_value_end(item, entry);
+  }
+}
+
+void Index_visitor::entry_end(const Pst_item& item, uint32_t set, uint32_t entry) {
+  if (inner_values) {
+    inner.entry_end(item, set, entry);
+  }
+
+  inner_entry = inner_values;
+}
+
+void Index_visitor::set_end(const Pst_item& item, uint32_t set) {
+  if (inner_values) {
+    inner.set_end(item, set);
+  }
+}
+
+void Index_visitor::values_end(const Pst_item& item) {
+  if (inner_values) {
+    inner.values_end(item);
+  }
+
+  // from here on, errors are those of the sub-items
+  inner_entry = frames.back().inner_sub_items;
+}
+
+void Index_visitor::item_end(const Pst_item& item) {
+  frames.pop_back();
+
+  const bool seen = frames.empty() || frames.back().inner_sub_items;
+  if (seen) {
+    inner.item_end(item);
+  }
+
+  inner_entry = seen;
+}
+
+void Index_visitor::error(const Pst_error& e) {
+  // errors in values walked only for the index are the index's business
+  if (inner_entry) {
+    inner.error(e);
+  }
+}
@@ -0,0 +1,58 @@
+#include "inventory.h"
+#include "json_writer.h"
+
+void Inventory_counts::add(const Inventory_counts& other) {
+  for (std::map<std::string, unsigned long>::const_iterator i(other.items.begin()); i != other.items.end(); ++i) {
+    items[i->first] += i->second;
+  }
+
+  entries += other.entries;
+  message_bytes += other.message_bytes;
+  attachment_bytes += other.attachment_bytes;
+}
+
+void Inventory_counts::write(JSON_writer& json) const {
+  json.object_member_open("items");
+  for (std::map<std::string, unsigned long>::const_iterator i(items.begin()); i != items.end(); ++i) {
+    json.object_member_write(i->first, i->second);
+  }
+  json.object_member_close();
+
+  json.object_member_write("entries", entries);
+  json.object_member_write("message bytes", message_bytes);
+  json.object_member_write("attachment bytes", attachment_bytes);
+}
+
+Inventory_counts Inventory_folder::write(JSON_writer& json) const {
+  json.object_open();
+  const Inventory_counts total(write_members(json));
+  json.object_close();
+
+  return total;
+}
+
+Inventory_counts Inventory_folder::write_members(JSON_writer& json) const {
+  json.object_member_write("path", path);
+  json.object_member_write("display path", dpath);
+  if (identifier) {
+    json.object_member_write("identifier", identifier);
+  }
+
+  counts.write(json);
+
+  Inventory_counts total(counts);
+
+  if (!folders.empty()) {
+    json.array_member_open("folders");
+    for (std::vector<Inventory_folder>::const_iterator i(folders.begin()); i != folders.end(); ++i) {
+      total.add(i->write(json));
+    }
+    json.array_member_close();
+  }
+
+  json.object_member_open("total");
+  total.write(json);
+  json.object_member_close();
+
+  return total;
+}
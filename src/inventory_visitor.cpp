@@ -0,0 +1,122 @@
+#include <boost/bind.hpp>
+
+#include <libpff.h>
+#include <libpff/mapi.h>
+
+#include "context.h"
+#include "decode_error.h"
+#include "inventory_visitor.h"
+#include "pff.h"
+
+namespace {
+  // Adds a size the item records, if it records it, to total.
+  void add_size(libpff_item_t* item, uint32_t etype, uint64_t& total, const std::string& path, Context& ctx) {
+    libpff_error_t* error = 0;
+    uint32_t size;
+
+    switch (libpff_item_get_entry_value_32bit(item, 0, etype, &size, 0, &error)) {
+    case -1:
+      report(ctx, "inventory", path, Decode_error(error, __LINE__), 0, etype);
+      break;
+    case  0:
+      break;
+    case  1:
+      total += size;
+      break;
+    }
+  }
+
+  // whether items of the type are messages of some sort, with attachments
+  bool is_message_type(uint8_t itype) {
+    switch (itype) {
+    case LIBPFF_ITEM_TYPE_UNDEFINED:
+    case LIBPFF_ITEM_TYPE_ATTACHMENT:
+    case LIBPFF_ITEM_TYPE_ATTACHMENTS:
+    case LIBPFF_ITEM_TYPE_FOLDER:
+    case LIBPFF_ITEM_TYPE_RECIPIENTS:
+    case LIBPFF_ITEM_TYPE_SUB_ASSOCIATED_CONTENTS:
+    case LIBPFF_ITEM_TYPE_SUB_FOLDERS:
+    case LIBPFF_ITEM_TYPE_SUB_MESSAGES:
+    case LIBPFF_ITEM_TYPE_UNKNOWN:
+      return false;
+    default:
+      return true;
+    }
+  }
+}
+
+int Inventory_visitor::item_begin(const Pst_item& item) {
+  Inventory_folder* into = open.empty() ? base : open.back();
+
+  if (item.type == LIBPFF_ITEM_TYPE_FOLDER) {
+    into->folders.push_back(Inventory_folder());
+    into = &into->folders.back();
+
+    into->path = item.path;
+    into->dpath = item.dpath;
+    into->identifier = item.identifier;
+  }
+
+  open.push_back(into);
+
+  Inventory_counts& counts = into->counts;
+  ++counts.items[item_type_string(item.type)];
+
+  try {
+    const uint32_t sets = get_attrib<uint32_t>(
+      boost::bind(&libpff_item_get_number_of_sets, item.handle, _1, _2)
+    );
+    const uint32_t entries = get_attrib<uint32_t>(
+      boost::bind(&libpff_item_get_number_of_entries, item.handle, _1, _2)
+    );
+    counts.entries += (uint64_t) sets * entries;
+  }
+  catch (const libpff_error& e) {
+    report(ctx, "item values", item.path, e);
+  }
+
+  if (is_message_type(item.type)) {
+    add_size(item.handle, LIBPFF_ENTRY_TYPE_MESSAGE_SIZE, counts.message_bytes, item.path, ctx);
+    count_attachments(item, counts);
+  }
+
+  return SUB_ITEMS;
+}
+
+// Counts a message's attachments, which are not among its sub-items.
+void Inventory_visitor::count_attachments(const Pst_item& item, Inventory_counts& counts) {
+  try {
+    const int num = get_attrib<int>(
+      boost::bind(&libpff_message_get_number_of_attachments, item.handle, _1, _2)
+    );
+
+    for (int a = 0; a < num; ++a) {
+      try {
+        libpff_item_t* att = 0;
+        libpff_error_t* error = 0;
+        if (libpff_message_get_attachment(item.handle, a, &att, &error) != 1) {
+          throw libpff_error(error, __LINE__);
+        }
+
+        ItemPtr attp(att, &destroy_item);
+
+        ++counts.items[item_type_string(LIBPFF_ITEM_TYPE_ATTACHMENT)];
+        add_size(att, LIBPFF_ENTRY_TYPE_ATTACHMENT_SIZE, counts.attachment_bytes, item.path, ctx);
+      }
+      catch (const libpff_error& e) {
+        report(ctx, "attachment", item.path, e, Error_log::NONE, Error_log::NONE, a);
+      }
+    }
+  }
+  catch (const libpff_error& e) {
+    report(ctx, "attachment count", item.path, e);
+  }
+}
+
+void Inventory_visitor::item_end(const Pst_item&) {
+  open.pop_back();
+}
+
+void Inventory_visitor::error(const Pst_error& e) {
+  report(ctx, e);
+}
@@ -0,0 +1,329 @@
+#include <libpff/mapi.h>
+
+#include "context.h"
+#include "dedup.h"
+#include "filetime.h"
+#include "json_visitor.h"
+#include "json_writer.h"
+#include "named_properties.h"
+#include "semantic.h"
+
+namespace {
+  constexpr JSON_key PATH(JSON_key::plain("path"));
+  constexpr JSON_key DISPLAY_PATH(JSON_key::plain("display path"));
+  constexpr JSON_key ITEM_TYPE(JSON_key::plain("item type"));
+  constexpr JSON_key ITEM_TYPE_NAME(JSON_key::plain("item type name"));
+  constexpr JSON_key IDENTIFIER(JSON_key::plain("identifier"));
+  constexpr JSON_key FINGERPRINT(JSON_key::plain("fingerprint"));
+  constexpr JSON_key NUMBER_OF_SETS(JSON_key::plain("number of sets"));
+  constexpr JSON_key ENTRIES_PER_SET(JSON_key::plain("entries per set"));
+  constexpr JSON_key SETS(JSON_key::plain("sets"));
+  constexpr JSON_key ENTRY_TYPE(JSON_key::plain("entry type"));
+  constexpr JSON_key VALUE_TYPE(JSON_key::plain("value type"));
+  constexpr JSON_key NAMED_PROPERTY(JSON_key::plain("named property"));
+  constexpr JSON_key MATCHED_VALUE_TYPE(JSON_key::plain("matched value type"));
+}
+
+Json_visitor::~Json_visitor() {
+  // items abandoned part way, by an exception, may not have records, so
+  // their fingerprints are taken back
+  for (std::vector<Open_item>::const_iterator i(open.begin()); i != open.end(); ++i) {
+    if (i->fingerprinted) {
+      ctx.seen->erase(i->fp);
+    }
+  }
+}
+
+int Json_visitor::item_begin(const Pst_item& item) {
+  // errors of items without records of their own, such as those which
+  // couldn't be opened, go before this record
+  ctx.errors.flush_pending_except(item.path);
+
+  open.push_back(Open_item());
+
+  // decided from the few entries fingerprints are made of, before any
+  // values are walked
+  Fingerprint fp;
+  const bool fingerprinted = ctx.seen && message_fingerprint(item, fp, ctx);
+
+  if (fingerprinted && !ctx.seen->insert(fp)) {
+    write_duplicate(item, fp);
+    return 0;
+  }
+
+  if (fingerprinted) {
+    open.back().fingerprinted = true;
+    open.back().fp = fp;
+  }
+
+  if (ctx.semantic && write_semantic_record(item, ctx, fingerprinted ? &fp : 0)) {
+    // recipients and attachments are in the record already
+    ctx.errors.flush_pending();
+    return 0;
+  }
+
+  JSON_writer& json = ctx.json;
+
+  json.object_open();
+
+  // path
+  json.object_member_write(PATH, item.path);
+
+  // display path
+  json.object_member_write(DISPLAY_PATH, item.dpath);
+
+  // item type
+  if (item.type_known) {
+    json.object_member_write(ITEM_TYPE, (uint32_t) item.type);
+    json.object_member_write(ITEM_TYPE_NAME, item_type_string(item.type));
+  }
+
+  // identifier
+  if (item.identifier_known) {
+    json.object_member_write(IDENTIFIER, item.identifier);
+  }
+
+  // fingerprint, for duplicates to refer to
+  if (fingerprinted) {
+    json.object_member_write(FINGERPRINT, fp.hex());
+  }
+
+  return VALUES | SUB_ITEMS;
+}
+
+void Json_visitor::write_duplicate(const Pst_item& item, const Fingerprint& fp) {
+  JSON_writer& json = ctx.json;
+
+  json.object_open();
+  json.object_member_write(PATH, item.path);
+  json.object_member_write(DISPLAY_PATH, item.dpath);
+  json.object_member_write(ITEM_TYPE, (uint32_t) item.type);
+
+  if (item.identifier_known) {
+    json.object_member_write(IDENTIFIER, item.identifier);
+  }
+
+  json.object_member_write("duplicate of", fp.hex());
+  json.object_close();
+  json.reset();
+
+  ctx.errors.flush_pending();
+}
+
+void Json_visitor::values_begin(const Pst_item&, uint32_t sets, uint32_t entries) {
+  JSON_writer& json = ctx.json;
+
+  json.object_member_write(NUMBER_OF_SETS, sets);
+  json.object_member_write(ENTRIES_PER_SET, entries);
+
+  if (sets > 0) {
+    json.array_member_open(SETS);
+    sets_open = true;
+  }
+}
+
+void Json_visitor::set_begin(const Pst_item&, uint32_t) {
+  ctx.json.array_open();
+}
+
+void Json_visitor::entry_begin(const Pst_item&, uint32_t, uint32_t) {
+  ctx.json.object_open();
+}
+
+bool Json_visitor::entry_type(const Pst_item& item, const Pst_entry& entry) {
+  JSON_writer& json = ctx.json;
+
+  json.object_member_write(ENTRY_TYPE, entry.entry_type);
+  json.object_member_write(VALUE_TYPE, entry.value_type);
+
+  if (entry.name) {
+    Decoded<uint32_t> id(ctx.names.resolve(entry.name));
+    if (!id.ok()) {
+      report(ctx, "name-to-id map", item.path, id.error(), entry.set, entry.entry);
+    }
+    else if (ctx.name_dictionary) {
+      json.object_member_write(NAMED_PROPERTY, id.value());
+    }
+    else {
+      ctx.names.write(id.value(), json);
+    }
+  }
+
+  if (entry.value_type != entry.matched_value_type) {
+    // the matched type is only interesting in case of a mismatch
+    // FIMXE: maybe this should print an error?
+    json.object_member_write(MATCHED_VALUE_TYPE, entry.matched_value_type);
+  }
+
+  return true;
+}
+
+void Json_visitor::value(const Pst_item& item, const Pst_entry& entry, const Pst_value& v) {
+  JSON_writer& json = ctx.json;
+  const JSON_key key(entry_type_string(entry.entry_type));
+
+  switch (v.kind) {
+  case Pst_value::NIL:
+    json.object_member_write_null(key);
+    break;
+  case Pst_value::INT16:
+  case Pst_value::INT32:
+  case Pst_value::INT64:
+    json.object_member_write(key, v.integer);
+    break;
+  case Pst_value::FLOAT:
+    // written as a float, so its shortest representation is a float's
+    json.object_member_write(key, (float) v.real);
+    break;
+  case Pst_value::DOUBLE:
+    json.object_member_write(key, v.real);
+    break;
+  case Pst_value::BOOLEAN:
+    json.object_member_write(key, (bool) v.integer);
+    break;
+  case Pst_value::FILETIME:
+    {
+      char buf[Filetime_format::MAXLEN];
+      json.object_member_write_raw(key, buf, ctx.times.format(v.filetime, buf));
+    }
+    break;
+  case Pst_value::STRING:
+    if (v.utf16) {
+      json.object_member_write_utf16le(key, v.data, v.size);
+    }
+    else {
+      json.object_member_write(key, (const char*) v.data);
+    }
+    break;
+  case Pst_value::GUID:
+    // as the elements of multi-values are
+    json.object_member_write(key, v.data, v.size);
+    break;
+  case Pst_value::BINARY:
+    if (entry.entry_type == LIBPFF_ENTRY_TYPE_MESSAGE_BODY_COMPRESSED_RTF && ctx.rtf != RTF_COMPRESSED) {
+      write_rtf(item, entry, key, v);
+    }
+    else {
+      json.object_member_write(key, v.data, v.size);
+    }
+    break;
+  }
+}
+
+void Json_visitor::write_rtf(const Pst_item& item, const Pst_entry& entry, JSON_key key, const Pst_value& v) {
+  JSON_writer& json = ctx.json;
+
+  std::string rtf;
+  Decode_error derr(decompress_rtf(v.data, v.size, rtf));
+  if (derr.failed()) {
+    // keep the blob, so nothing is lost
+    json.object_member_write(key, v.data, v.size);
+    report(ctx, "value", item.path, derr, entry.set, entry.entry);
+    return;
+  }
+
+  if (ctx.rtf == RTF_BODY) {
+    std::string body;
+    switch (deencapsulate_rtf(rtf, body)) {
+    case RTF_HTML:
+      json.object_member_write("encapsulated HTML", body);
+      return;
+    case RTF_TEXT:
+      json.object_member_write("encapsulated text", body);
+      return;
+    case RTF_NATIVE:
+      break;
+    }
+  }
+
+  json.object_member_write("decompressed RTF", rtf);
+}
+
+void Json_visitor::multi_value_begin(const Pst_item&, const Pst_entry& entry, size_t) {
+  ctx.json.array_member_open(entry_type_string(entry.entry_type));
+}
+
+void Json_visitor::element(const Pst_item&, const Pst_entry&, size_t, const Pst_value& v) {
+  JSON_writer& json = ctx.json;
+
+  switch (v.kind) {
+  case Pst_value::NIL:
+    json.array_member_write_null();
+    break;
+  case Pst_value::INT16:
+  case Pst_value::INT32:
+  case Pst_value::INT64:
+    json.array_member_write(v.integer);
+    break;
+  case Pst_value::FLOAT:
+    json.array_member_write((float) v.real);
+    break;
+  case Pst_value::DOUBLE:
+    json.array_member_write(v.real);
+    break;
+  case Pst_value::BOOLEAN:
+    json.array_member_write((bool) v.integer);
+    break;
+  case Pst_value::FILETIME:
+    {
+      char buf[Filetime_format::MAXLEN];
+      json.array_member_write_raw(buf, ctx.times.format(v.filetime, buf));
+    }
+    break;
+  case Pst_value::STRING:
+    if (v.utf16) {
+      json.array_member_write_utf16le(v.data, v.size);
+    }
+    else {
+      json.array_member_write((const char*) v.data);
+    }
+    break;
+  case Pst_value::GUID:
+  case Pst_value::BINARY:
+    json.array_member_write(v.data, v.size);
+    break;
+  }
+}
+
+void Json_visitor::multi_value_end(const Pst_item&, const Pst_entry&) {
+  ctx.json.array_member_close();
+}
+
+void Json_visitor::entry_end(const Pst_item&, uint32_t, uint32_t) {
+  ctx.json.object_close();
+}
+
+void Json_visitor::set_end(const Pst_item&, uint32_t) {
+  ctx.json.array_close();
+}
+
+void Json_visitor::values_end(const Pst_item&) {
+  JSON_writer& json = ctx.json;
+
+  if (sets_open) {
+    json.array_member_close();
+    sets_open = false;
+  }
+
+  json.object_close();
+  json.reset();
+
+  // errors held back for inline output follow the record they belong to
+  ctx.errors.flush_pending();
+}
+
+void Json_visitor::item_end(const Pst_item&) {
+  // those raised while walking the sub-items and unknowns
+  ctx.errors.flush_pending();
+
+  // the record is out, so the fingerprint is for keeps
+  if (open.back().fingerprinted) {
+    ctx.seen->commit(open.back().fp);
+  }
+
+  open.pop_back();
+}
+
+void Json_visitor::error(const Pst_error& e) {
+  report(ctx, e);
+}
@@ -1,9 +1,16 @@
 #include <algorithm>
+#include <cmath>
 #include <iterator>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include <boost/archive/iterators/base64_from_binary.hpp>
 #include <boost/archive/iterators/transform_width.hpp>
 
 #include "json_writer.h"
+#include "utf16.h"
 
 const char* JSON_writer::KVSEP = " : ";
 
@@ -15,11 +22,115 @@ std::ostream& operator<<(std::ostream& out, quote func) {
   return func(out);
 }
 
-JSON_writer::JSON_writer(std::ostream& o): out(o), depth(0) {
-  first_child.push(true);
+size_t json_escape(char c, char* out) {
+  static const char HEX[] = "0123456789abcdef";
+
+  switch (c) {
+  case '"':
+  case '\\':
+    out[0] = '\\';
+    out[1] = c;
+    return 2;
+  case '\b':
+    out[0] = '\\';
+    out[1] = 'b';
+    return 2;
+  case '\f':
+    out[0] = '\\';
+    out[1] = 'f';
+    return 2;
+  case '\n':
+    out[0] = '\\';
+    out[1] = 'n';
+    return 2;
+  case '\r':
+    out[0] = '\\';
+    out[1] = 'r';
+    return 2;
+  case '\t':
+    out[0] = '\\';
+    out[1] = 't';
+    return 2;
+  default:
+    if ((unsigned char) c >= 0x20) {
+      return 0;
+    }
+
+    // the rest of U+0000 - U+001F
+    out[0] = '\\';
+    out[1] = 'u';
+    out[2] = '0';
+    out[3] = '0';
+    out[4] = HEX[c >> 4];
+    out[5] = HEX[c & 0xF];
+    return 6;
+  }
+}
+
+void write_json_string(std::ostream& out, const char* s, size_t len) {
+  const char* end = s + len;
+  const char* clean = s;
+  char esc[6];
+
+  out << '"';
+
+  for (const char* p = s; p < end; ) {
+#ifdef __SSE2__
+    // skip 16 bytes at a time while none need escaping
+    if (end - p >= 16) {
+      const __m128i v = _mm_loadu_si128((const __m128i*) p);
+      const __m128i bad = _mm_or_si128(
+        _mm_cmpeq_epi8(_mm_subs_epu8(v, _mm_set1_epi8(0x1F)), _mm_setzero_si128()),
+        _mm_or_si128(
+          _mm_cmpeq_epi8(v, _mm_set1_epi8('"')),
+          _mm_cmpeq_epi8(v, _mm_set1_epi8('\\'))
+        )
+      );
+
+      const unsigned int mask = _mm_movemask_epi8(bad);
+      if (!mask) {
+        p += 16;
+        continue;
+      }
+
+      p += __builtin_ctz(mask);
+    }
+#endif
+
+    const size_t n = json_escape(*p, esc);
+    if (n) {
+      out.write(clean, p - clean);
+      out.write(esc, n);
+      clean = p + 1;
+    }
+
+    ++p;
+  }
+
+  out.write(clean, end - clean);
+  out << '"';
+}
+
+namespace {
+  template <typename F> void float_write(std::ostream& out, F value) {
+    // JSON has no NaN or infinities, so these are written as the strings
+    // most JSON readers which accept them at all expect
+    if (std::isnan(value)) {
+      out << "\"NaN\"";
+    }
+    else if (std::isinf(value)) {
+      out << (value < 0 ? "\"-Infinity\"" : "\"Infinity\"");
+    }
+    else {
+      char buf[32];
+      out.write(buf, std::to_chars(buf, buf + sizeof(buf), value).ptr - buf);
+    }
+  }
 }
 
-void JSON_writer::key_write(const std::string& key) {
+JSON_writer::JSON_writer(std::ostream& o): out(o), depth(0), first_child(1) {}
+
+void JSON_writer::key_write(JSON_key key) {
   next_element();
   write_key(key);
 }
@@ -34,35 +145,59 @@ void JSON_writer::array_close() { scope_close(']'); }
 
 void JSON_writer::scope_open(char delim) {
   next_element();
-  out << indent(depth++) << delim << '\n';
-  first_child.push(true);
+  out << indent(depth) << delim << '\n';
+  push();
 }
 
 void JSON_writer::scope_close(char delim) {
-  if (!first_child.top()) {
+  if (!is_first_child(depth)) {
     out << '\n';
   }
 
   out << indent(--depth) << delim;
-  first_child.pop();
 }
 
 void JSON_writer::member_scope_open(char delim) {
   out << delim << '\n';
-  ++depth;
-  first_child.push(true);
+  push();
+}
+
+void JSON_writer::push() {
+  set_first_child(++depth, true);
+}
+
+bool JSON_writer::is_first_child(unsigned int d) const {
+  if (d < 64) {
+    return (first_child >> d) & 1;
+  }
+
+  return deep[d - 64];
+}
+
+void JSON_writer::set_first_child(unsigned int d, bool first) {
+  if (d < 64) {
+    const uint64_t bit = (uint64_t) 1 << d;
+    first_child = first ? first_child | bit : first_child & ~bit;
+    return;
+  }
+
+  if (d - 64 >= deep.size()) {
+    deep.resize(d - 63);
+  }
+
+  deep[d - 64] = first;
 }
 
 void JSON_writer::member_scope_close(char delim) { scope_close(delim); }
 
-void JSON_writer::object_member_open(const std::string& key) {
+void JSON_writer::object_member_open(JSON_key key) {
   key_write(key);
   member_scope_open('{');
 }
 
 void JSON_writer::object_member_close() { member_scope_close('}'); }
 
-void JSON_writer::array_member_open(const std::string& key) {
+void JSON_writer::array_member_open(JSON_key key) {
   key_write(key);
   member_scope_open('[');
 }
@@ -73,6 +208,22 @@ void JSON_writer::value_write(const std::string& value) {
   out << quote(value);
 }
 
+void JSON_writer::value_write(std::string_view value) {
+  out << quote(value);
+}
+
+void JSON_writer::number_write(bool value) {
+  out << (value ? '1' : '0');
+}
+
+void JSON_writer::number_write(float value) {
+  float_write(out, value);
+}
+
+void JSON_writer::number_write(double value) {
+  float_write(out, value);
+}
+
 void JSON_writer::value_write_null() {
   out << "null";
 }
@@ -115,34 +266,63 @@ void JSON_writer::value_write(const unsigned char* value, size_t length) {
   out << '"';
 }
 
-void JSON_writer::object_member_write_null(const std::string& key) {
+void JSON_writer::value_write_raw(const std::string& json) {
+  out << json;
+}
+
+void JSON_writer::value_write_raw(const char* json, size_t length) {
+  out.write(json, length);
+}
+
+void JSON_writer::object_member_write_utf16le(JSON_key key,
+                                              const uint8_t* value, size_t size)
+{
+  key_write(key);
+  write_json_utf16le(out, value, size);
+}
+
+void JSON_writer::object_member_write_raw(JSON_key key,
+                                          const std::string& json)
+{
+  key_write(key);
+  value_write_raw(json);
+}
+
+void JSON_writer::object_member_write_raw(JSON_key key,
+                                          const char* json, size_t length)
+{
+  key_write(key);
+  value_write_raw(json, length);
+}
+
+void JSON_writer::object_member_write_null(JSON_key key) {
   key_write(key);
   out << "null";
 }
 
-void JSON_writer::object_member_write_true(const std::string& key) {
+void JSON_writer::object_member_write_true(JSON_key key) {
   key_write(key);
   out << "true";
 }
 
-void JSON_writer::object_member_write_false(const std::string& key) {
+void JSON_writer::object_member_write_false(JSON_key key) {
   key_write(key);
   out << "false";
 }
 
-void JSON_writer::object_member_write(const std::string& key, char* value) {
+void JSON_writer::object_member_write(JSON_key key, char* value) {
   key_write(key);
   value_write(value);
 }
 
-void JSON_writer::object_member_write(const std::string& key,
+void JSON_writer::object_member_write(JSON_key key,
                                       const char* value)
 {
   key_write(key);
   value_write(value);
 }
 
-void JSON_writer::object_member_write(const std::string& key,
+void JSON_writer::object_member_write(JSON_key key,
                                       const unsigned char* value,
                                       size_t length)
 {
@@ -165,6 +345,16 @@ void JSON_writer::array_member_write_false() {
   out << "false";
 }
 
+void JSON_writer::array_member_write(const std::string& value) {
+  next_element();
+  value_write(value);
+}
+
+void JSON_writer::array_member_write(std::string_view value) {
+  next_element();
+  value_write(value);
+}
+
 void JSON_writer::array_member_write(char* value) {
   next_element();
   value_write(value);
@@ -182,24 +372,43 @@ void JSON_writer::array_member_write(const unsigned char* value,
   value_write(value, length);  
 }
 
+void JSON_writer::array_member_write_utf16le(const uint8_t* value, size_t size) {
+  next_element();
+  write_json_utf16le(out, value, size);
+}
+
+void JSON_writer::array_member_write_raw(const char* json, size_t length) {
+  next_element();
+  value_write_raw(json, length);
+}
+
 void JSON_writer::reset() {
   out << '\n';
 
-  while (!first_child.empty()) { first_child.pop(); }
-  
-  first_child.push(true);
+  first_child = 1;
   depth = 0;
 }
 
 void JSON_writer::next_element() {
-  if (first_child.top()) {
-    first_child.top() = false;
+  if (is_first_child(depth)) {
+    set_first_child(depth, false);
   }
   else {
     out << ",\n";
   }
 }
 
-void JSON_writer::write_key(const std::string& key) {
-  out << indent(depth) << quote(key) << KVSEP;
+void JSON_writer::write_key(JSON_key key) {
+  out << indent(depth);
+
+  if (key.needs_escaping()) {
+    out << quote(key.text());
+  }
+  else {
+    out << '"';
+    out.write(key.text().data(), key.text().size());
+    out << '"';
+  }
+
+  out << KVSEP;
 }
@@ -1,21 +1,57 @@
 
+#include <algorithm>
+#include <cerrno>
 #include <cstring>
 #include <cstdlib>
 #include <exception>
+#include <fstream>
+#include <future>
 #include <iostream>
+#include <map>
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
+
+#include <getopt.h>
+#include <sys/stat.h>
 
 #include <boost/bind.hpp>
+#include <boost/function.hpp>
 #include <boost/lexical_cast.hpp>
-#include <boost/scoped_array.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 
+// libbfio must come first, for libpff to declare its libbfio functions
+#include <libbfio.h>
 #include <libpff.h>
 #include <libpff/mapi.h>
 
+#include "arrow_export.h"
+#include "arrow_visitor.h"
+#include "compressed_rtf.h"
+#include "context.h"
+#include "daemon.h"
+#include "dedup.h"
+#include "decode_error.h"
+#include "error_log.h"
+#include "filetime.h"
+#include "handle_cache.h"
+#include "image_range.h"
+#include "index_visitor.h"
+#include "inventory.h"
+#include "inventory_visitor.h"
+#include "json_visitor.h"
 #include "json_writer.h"
+#include "mapped_file.h"
+#include "named_properties.h"
+#include "pff.h"
+#include "pstrip.h"
+#include "shard.h"
+#include "text_index.h"
+#include "trace.h"
+#include "uring_file.h"
 
 template <typename L, typename R> std::string operator+(L left, R right) {
   std::ostringstream os;
@@ -23,1143 +59,1471 @@ template <typename L, typename R> std::string operator+(L left, R right) {
   return os.str();
 }
 
-void handle_item(libpff_item_t* item, const std::string& path, const std::string& dpath, JSON_writer& json);
-
-typedef boost::shared_ptr<libpff_file_t> FilePtr;
-typedef boost::shared_ptr<libpff_item_t> ItemPtr;
-typedef boost::shared_ptr<libpff_multi_value_t> MultiValuePtr;
+// kept out of the global namespace, where operator+ above would hijack
+// iterator arithmetic on vectors of these
+namespace {
+  struct Item_ref {
+    uint32_t id;
+    std::string path;
+    std::string parent_dpath;
+    int index;
+    bool folder;
+
+    bool operator<(const Item_ref& other) const { return id < other.id; }
+  };
+}
 
-class libpff_error: public std::exception {
+//
+// Extracts folders and the items in them in ascending identifier order
+// rather than in tree order, each with its sub-items, such as a message's
+// recipients and attachments, as the walker would walk them. libpff
+// doesn't reveal where an item's data lies in the file, but items are
+// numbered as they are created, and their data blocks are allocated at
+// the same time, so identifier order approximates file order. Items are
+// taken window items at a time, or all at once if window is 0. The
+// records are written in extraction order; their paths give their places
+// in the tree.
+//
+class Locality_order {
 public:
-  libpff_error(libpff_error_t*& error, uint32_t line) {
-    std::stringstream ss;
-    ss << line << ": ";
+  Locality_order(libpff_file_t* f, size_t w, Pst_walker& wk, Context& c):
+    file(f), window(w), walker(wk), ctx(c) {}
 
-    char buf[MAXLEN];
-    libpff_error_sprint(error, buf, MAXLEN);
-    libpff_error_free(&error);
-    ss << buf;
+  void add(uint32_t id, const std::string& path, const std::string& parent_dpath, int index, bool folder) {
+    const Item_ref ref = { id, path, parent_dpath, index, folder };
+    refs.push_back(ref);
 
-    msg = ss.str();
+    if (window && refs.size() >= window) {
+      flush();
+    }
   }
 
-  libpff_error(const std::string& s, uint32_t line) {
-    std::stringstream ss;
-    ss << line << ": " << s;
-    msg = ss.str();
-  }
+  void flush() {
+    std::sort(refs.begin(), refs.end());
 
-  virtual ~libpff_error() throw() {}
+    for (std::vector<Item_ref>::const_iterator i(refs.begin()); i != refs.end(); ++i) {
+      check_cancel(ctx);
+      extract(*i);
+    }
 
-  virtual const char* what() const throw() { return msg.c_str(); }
+    refs.clear();
+  }
 
 private:
-  static const size_t MAXLEN = 1024;
+  void extract(const Item_ref& ref) {
+    try {
+      ItemPtr itemp(get_item(file, ref.id), &destroy_item);
+
+      const std::string dpath(walker.display_path(itemp.get(), ref.path, ref.parent_dpath, ref.index));
+
+      // the items in folders were collected along with the folders
+      walker.walk_item(
+        itemp.get(), ref.path, dpath,
+        ref.folder ? Pst_walker::UNKNOWNS : Pst_walker::SUB_ITEMS
+      );
+    }
+    catch (const libpff_error& e) {
+      report(ctx, "item", ref.path, e);
+    }
+  }
+
+  libpff_file_t* file;
+  size_t window;
+  Pst_walker& walker;
+  Context& ctx;
 
-  std::string msg;
+  std::vector<Item_ref> refs;
 };
 
-libpff_file_t* create_file(const char* filename) {
-  libpff_file_t* file = 0;
-  libpff_error_t* error = 0;
+// Walks the folders only, collecting them and the items in them for
+// extraction, as far as the walker's sample goes. Only folders are read,
+// for their display names.
+void collect_subitems(libpff_item_t* item, const std::string& path, const std::string& dpath, const Pst_walker& walker, Locality_order& order, Context& ctx) {
+  try {
+    const int num = get_attrib<int>(
+      boost::bind(&libpff_item_get_number_of_sub_items, item, _1, _2)
+    );
 
-  if (libpff_file_initialize(&file, &error) != 1) {
-    throw libpff_error(error, __LINE__);
-  }
+    for (int i = 0; i < num; ++i) {
+      check_cancel(ctx);
+      std::string cpath(path + '/' + i);
+      try {
+        ItemPtr itemp(get_child(item, i), &destroy_item);
+        if (!walker.sampled(itemp.get())) {
+          continue;
+        }
 
-  if (libpff_file_open(file, filename, LIBPFF_OPEN_READ, &error) != 1) {
-    throw libpff_error(error, __LINE__);
-  }
+        const uint32_t id = get_attrib<uint32_t>(
+          boost::bind(&libpff_item_get_identifier, itemp.get(), _1, _2)
+        );
 
-  return file;
-}
+        // if the type can't be read, walking the item reports why
+        uint8_t type = LIBPFF_ITEM_TYPE_UNDEFINED;
+        try {
+          type = get_attrib<uint8_t>(
+            boost::bind(&libpff_item_get_type, itemp.get(), _1, _2)
+          );
+        }
+        catch (const libpff_error&) {
+        }
 
-void destroy_file(libpff_file_t* file) {
-  libpff_error_t* error = 0;
+        const bool folder = type == LIBPFF_ITEM_TYPE_FOLDER;
+        order.add(id, cpath, dpath, i, folder);
 
-  if (libpff_file_close(file, &error) != 0) {
-    throw libpff_error(error, __LINE__);
+        if (folder) {
+          const std::string cdpath(walker.display_path(itemp.get(), cpath, dpath, i));
+          collect_subitems(itemp.get(), cpath, cdpath, walker, order, ctx);
+        }
+      }
+      catch (const libpff_error& e) {
+        report(ctx, "item", cpath, e);
+      }
+    }
   }
-
-  if (libpff_file_free(&file, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+  catch (const libpff_error& e) {
+    report(ctx, "item count", path, e);
   }
 }
 
-libpff_item_t* get_root(libpff_file_t* file) {
-  libpff_item_t* root = 0;
-  libpff_error_t* error = 0;
-
-  if (libpff_file_get_root_item(file, &root, &error) != 1) {
-    throw libpff_error(error, __LINE__);
-  }
+void handle_tree_by_locality(libpff_file_t* file, const std::string& filename, size_t window, Pst_walker& walker, Context& ctx) {
+  ItemPtr rootp(get_root(file), &destroy_item);
 
-  return root;
+  Locality_order order(file, window, walker, ctx);
+  collect_subitems(rootp.get(), '/' + filename, '/' + filename, walker, order, ctx);
+  order.flush();
 }
 
-libpff_item_t* get_child(libpff_item_t* parent, int pos) {
-  libpff_item_t* child = 0;
+void recover_items(libpff_file_t* file, uint8_t flags) {
   libpff_error_t* error = 0;
 
-  if (libpff_item_get_sub_item(parent, pos, &child, &error) != 1) {
+  Trace_span span("libpff_file_recover_items", "libpff");
+  const int ret = libpff_file_recover_items(file, flags, &error);
+  span.end();
+
+  if (ret == -1) {
     throw libpff_error(error, __LINE__);
   }
-
-  return child;
 }
 
-libpff_item_t* get_unknowns(libpff_item_t* folder) {
-  libpff_item_t* unknowns = 0;
-  libpff_error_t* error = 0;
+// Walks the recovered items, or with a shard, its share of them.
+void handle_recovered(libpff_file_t* file, std::future<void>& scan, const std::string& filename, Pst_walker& walker, Context& ctx, const Pst_shard* shard = 0) {
+  std::string path( '/' + filename + "/recovered");
 
-  if (libpff_folder_get_unknowns(folder, &unknowns, &error) == -1) {
-    throw libpff_error(error, __LINE__);
-  }
+  try {
+// TODO: Not sure we're using this correctly.
 
-  return unknowns;
+    // wait for the scan to finish; this rethrows if it failed
+    scan.get();
+
+    if (shard) {
+      shard->walk_recovered(file, walker);
+    }
+    else {
+      walker.walk_recovered(file, filename);
+    }
+  }
+  catch (const libpff_error& e) {
+    report(ctx, "recovery", path, e);
+  }
 }
 
-libpff_item_t* get_orphan(libpff_file_t* file, int pos) {
-  libpff_item_t* orphan = 0;
-  libpff_error_t* error = 0;
+//
+// Writes one record summarizing the tree, the orphans and the recovered
+// items: counts and sizes by folder, with totals, but no values. scan is
+// the recovery scan of recfile, or null if there is none.
+//
+void handle_inventory(libpff_file_t* file, libpff_file_t* recfile, std::future<void>* scan, const std::string& filename, Context& ctx) {
+  const std::string path('/' + filename);
 
-  if (libpff_file_get_orphan_item(file, pos, &orphan, &error) != 1) {
-    throw libpff_error(error, __LINE__);
-  }
+  Inventory_folder tree;
+  tree.path = tree.dpath = path;
 
-  return orphan;
-}
+  Inventory_folder orphans;
+  orphans.path = orphans.dpath = path + "/orphans";
 
-libpff_item_t* get_recovered(libpff_file_t* file, int pos) {
-  libpff_item_t* rec = 0;
-  libpff_error_t* error = 0;
+  Inventory_folder recovered;
+  recovered.path = recovered.dpath = path + "/recovered";
 
-  if (libpff_file_get_recovered_item(file, pos, &rec, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+  Inventory_visitor visitor(ctx);
+  Pst_walker walker(visitor);
+
+  try {
+    visitor.count_into(tree);
+    walker.walk_tree(file, filename);
+  }
+  catch (const libpff_error& e) {
+    report(ctx, "item", path, e);
   }
 
-  return rec;
-}
+  visitor.count_into(orphans);
+  walker.walk_orphans(file, filename);
 
-void destroy_item(libpff_item_t* item) {
-  libpff_error_t* error = 0;
+  if (scan) {
+    try {
+      // wait for the scan to finish; this rethrows if it failed
+      scan->get();
 
-  if (libpff_item_free(&item, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+      visitor.count_into(recovered);
+      walker.walk_recovered(recfile, filename);
+    }
+    catch (const libpff_error& e) {
+      report(ctx, "recovery", recovered.path, e);
+    }
   }
-}
 
-libpff_multi_value_t* get_multivalue(libpff_item_t* item, uint32_t s, uint32_t etype, uint8_t flags) {
-  libpff_multi_value_t* mv = 0;
-  libpff_error_t* error = 0;
+  JSON_writer& json = ctx.json;
 
-  if (libpff_item_get_entry_multi_value(item, s, etype, &mv, flags, &error) == -1) {
-    throw libpff_error(error, __LINE__);
-  }
+  json.object_open();
+  json.object_member_open("inventory");
 
-  return mv;
-}
+  Inventory_counts total;
 
-void destroy_multivalue(libpff_multi_value_t* mv) {
-  libpff_error_t* error = 0;
+  json.object_member_open("tree");
+  total.add(tree.write_members(json));
+  json.object_member_close();
 
-  if (libpff_multi_value_free(&mv, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+  json.object_member_open("orphans");
+  total.add(orphans.write_members(json));
+  json.object_member_close();
+
+  if (scan) {
+    json.object_member_open("recovered");
+    total.add(recovered.write_members(json));
+    json.object_member_close();
   }
+
+  json.object_member_open("total");
+  total.write(json);
+  json.object_member_close();
+
+  json.object_member_close();
+  json.object_close();
+  json.reset();
+
+  ctx.errors.flush_pending();
 }
 
-std::string item_type_string(uint32_t itype) {
-  switch (itype) {
-  case LIBPFF_ITEM_TYPE_UNDEFINED:
-    return "UNDEFINED";
-  case LIBPFF_ITEM_TYPE_ACTIVITY:
-    return "ACTIVITY";
-  case LIBPFF_ITEM_TYPE_APPOINTMENT:
-    return "APPOINTMENT";
-  case LIBPFF_ITEM_TYPE_ATTACHMENT:
-    return "ATTACHMENT";
-  case LIBPFF_ITEM_TYPE_ATTACHMENTS:
-    return "ATTACHMENTS";
-  case LIBPFF_ITEM_TYPE_COMMON:
-    return "COMMON";
-  case LIBPFF_ITEM_TYPE_CONFIGURATION:
-    return "CONFIGURATION";
-  case LIBPFF_ITEM_TYPE_CONFLICT_MESSAGE:
-    return "CONFLICT_MESSAGE";
-  case LIBPFF_ITEM_TYPE_CONTACT:
-    return "CONTACT";
-  case LIBPFF_ITEM_TYPE_DISTRIBUTION_LIST:
-    return "DISTRIBUTION_LIST";
-  case LIBPFF_ITEM_TYPE_DOCUMENT:
-    return "DOCUMENT";
-  case LIBPFF_ITEM_TYPE_EMAIL:
-    return "EMAIL";
-  case LIBPFF_ITEM_TYPE_EMAIL_SMIME:
-    return "EMAIL_SMIME";
-  case LIBPFF_ITEM_TYPE_FAX:
-    return "FAX";
-  case LIBPFF_ITEM_TYPE_FOLDER:
-    return "FOLDER";
-  case LIBPFF_ITEM_TYPE_MEETING:
-    return "MEETING";
-  case LIBPFF_ITEM_TYPE_MMS:
-    return "MMS";
-  case LIBPFF_ITEM_TYPE_NOTE:
-    return "NOTE";
-  case LIBPFF_ITEM_TYPE_POSTING_NOTE:
-    return "POSTING_NOTE";
-  case LIBPFF_ITEM_TYPE_RECIPIENTS:
-    return "RECIPIENTS";
-  case LIBPFF_ITEM_TYPE_RSS_FEED:
-    return "RSS_FEED";
-  case LIBPFF_ITEM_TYPE_SHARING:
-    return "SHARING";
-  case LIBPFF_ITEM_TYPE_SMS:
-    return "SMS";
-  case LIBPFF_ITEM_TYPE_SUB_ASSOCIATED_CONTENTS:
-    return "SUB_ASSOCIATED_CONTENTS";
-  case LIBPFF_ITEM_TYPE_SUB_FOLDERS:
-    return "SUB_FOLDERS";
-  case LIBPFF_ITEM_TYPE_SUB_MESSAGES:
-    return "SUB_MESSAGES";
-  case LIBPFF_ITEM_TYPE_TASK:
-    return "TASK";
-  case LIBPFF_ITEM_TYPE_TASK_REQUEST:
-    return "TASK_REQUEST";
-  case LIBPFF_ITEM_TYPE_VOICEMAIL:
-    return "VOICEMAIL";
-  case LIBPFF_ITEM_TYPE_UNKNOWN:
-    return "UNKNOWN";
-  default:
-    return "UNRECOGNIZED";
+//
+// Finds the item at path, as written in its record, by descending to it
+// directly, and sets dpath to its display path. Paths may also start from
+// an item looked up by identifier, as /name/identifier/N/... Recovered
+// items can't be found this way, since they only exist after a recovery
+// scan.
+//
+ItemPtr find_item(libpff_file_t* file, const std::string& filename, const std::string& path, std::string& dpath, const Pst_walker& walker) {
+  const std::string root('/' + filename);
+  if (path.compare(0, root.size(), root) != 0 || path.size() <= root.size() || path[root.size()] != '/') {
+    throw std::runtime_error("not an item path in " + filename + ": " + path);
   }
-}
 
-std::string entry_type_string(uint32_t etype) {
-  switch (etype) {
-  case LIBPFF_ENTRY_TYPE_MESSAGE_IMPORTANCE:
-    return "MESSAGE_IMPORTANCE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_CLASS:
-    return "MESSAGE_CLASS";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_PRIORITY:
-    return "MESSAGE_PRIORITY";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENSITIVITY:
-    return "MESSAGE_SENSITIVITY";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SUBJECT:
-    return "MESSAGE_SUBJECT";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_CLIENT_SUBMIT_TIME:
-    return "MESSAGE_CLIENT_SUBMIT_TIME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_SEARCH_KEY:
-    return "MESSAGE_SENT_REPRESENTING_SEARCH_KEY";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_ENTRY_IDENTIFIER:
-    return "MESSAGE_RECEIVED_BY_ENTRY_IDENTIFIER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_NAME:
-    return "MESSAGE_RECEIVED_BY_NAME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_ENTRY_IDENTIFIER:
-    return "MESSAGE_SENT_REPRESENTING_ENTRY_IDENTIFIER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_NAME:
-    return "MESSAGE_SENT_REPRESENTING_NAME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_ENTRY_IDENTIFIER:
-    return "MESSAGE_RECEIVED_REPRESENTING_ENTRY_IDENTIFIER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_NAME:
-    return "MESSAGE_RECEIVED_REPRESENTING_NAME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_REPLY_RECIPIENT_ENTRIES:
-    return "MESSAGE_REPLY_RECIPIENT_ENTRIES";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_REPLY_RECIPIENT_NAMES:
-    return "MESSAGE_REPLY_RECIPIENT_NAMES";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_SEARCH_KEY:
-    return "MESSAGE_RECEIVED_BY_SEARCH_KEY";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_SEARCH_KEY:
-    return "MESSAGE_RECEIVED_REPRESENTING_SEARCH_KEY";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_ADDRESS_TYPE:
-    return "MESSAGE_SENT_REPRESENTING_ADDRESS_TYPE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_EMAIL_ADDRESS:
-    return "MESSAGE_SENT_REPRESENTING_EMAIL_ADDRESS";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_CONVERSATION_TOPIC:
-    return "MESSAGE_CONVERSATION_TOPIC";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_CONVERSATION_INDEX:
-    return "MESSAGE_CONVERSATION_INDEX";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_ADDRESS_TYPE:
-    return "MESSAGE_RECEIVED_BY_ADDRESS_TYPE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_EMAIL_ADDRESS:
-    return "MESSAGE_RECEIVED_BY_EMAIL_ADDRESS";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_ADDRESS_TYPE:
-    return "MESSAGE_RECEIVED_REPRESENTING_ADDRESS_TYPE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_EMAIL_ADDRESS:
-    return "MESSAGE_RECEIVED_REPRESENTING_EMAIL_ADDRESS";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_TRANSPORT_HEADERS:
-    return "MESSAGE_TRANSPORT_HEADERS";
-  case LIBPFF_ENTRY_TYPE_RECIPIENT_TYPE:
-    return "RECIPIENT_TYPE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_ENTRY_IDENTIFIER:
-    return "MESSAGE_SENDER_ENTRY_IDENTIFIER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_NAME:
-    return "MESSAGE_SENDER_NAME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_SEARCH_KEY:
-    return "MESSAGE_SENDER_SEARCH_KEY";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_ADDRESS_TYPE:
-    return "MESSAGE_SENDER_ADDRESS_TYPE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_EMAIL_ADDRESS:
-    return "MESSAGE_SENDER_EMAIL_ADDRESS";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_DISPLAY_TO:
-    return "MESSAGE_DISPLAY_TO";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_DELIVERY_TIME:
-    return "MESSAGE_DELIVERY_TIME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_FLAGS:
-    return "MESSAGE_FLAGS";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_SIZE:
-    return "MESSAGE_SIZE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_STATUS:
-    return "MESSAGE_STATUS";
-  case LIBPFF_ENTRY_TYPE_ATTACHMENT_SIZE:
-    return "ATTACHMENT_SIZE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_INTERNET_ARTICLE_NUMBER:
-    return "MESSAGE_INTERNET_ARTICLE_NUMBER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_PERMISSION:
-    return "MESSAGE_PERMISSION";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_URL_COMPUTER_NAME_SET:
-    return "MESSAGE_URL_COMPUTER_NAME_SET";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_TRUST_SENDER:
-    return "MESSAGE_TRUST_SENDER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_PLAIN_TEXT:
-    return "MESSAGE_BODY_PLAIN_TEXT";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_COMPRESSED_RTF:
-    return "MESSAGE_BODY_COMPRESSED_RTF";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_HTML:
-    return "MESSAGE_BODY_HTML";
-  case LIBPFF_ENTRY_TYPE_EMAIL_EML_FILENAME:
-    return "EMAIL_EML_FILENAME";
-  case LIBPFF_ENTRY_TYPE_DISPLAY_NAME:
-    return "DISPLAY_NAME";
-  case LIBPFF_ENTRY_TYPE_ADDRESS_TYPE:
-    return "ADDRESS_TYPE";
-  case LIBPFF_ENTRY_TYPE_EMAIL_ADDRESS:
-    return "EMAIL_ADDRESS";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_CREATION_TIME:
-    return "MESSAGE_CREATION_TIME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_MODIFICATION_TIME:
-    return "MESSAGE_MODIFICATION_TIME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_STORE_VALID_FOLDER_MASK:
-    return "MESSAGE_STORE_VALID_FOLDER_MASK";
-  case LIBPFF_ENTRY_TYPE_FOLDER_TYPE:
-    return "FOLDER_TYPE";
-  case LIBPFF_ENTRY_TYPE_NUMBER_OF_CONTENT_ITEMS:
-    return "NUMBER_OF_CONTENT_ITEMS";
-  case LIBPFF_ENTRY_TYPE_NUMBER_OF_UNREAD_CONTENT_ITEMS:
-    return "NUMBER_OF_UNREAD_CONTENT_ITEMS";
-  case LIBPFF_ENTRY_TYPE_HAS_SUB_FOLDERS:
-    return "HAS_SUB_FOLDERS";
-  case LIBPFF_ENTRY_TYPE_CONTAINER_CLASS:
-    return "CONTAINER_CLASS";
-  case LIBPFF_ENTRY_TYPE_NUMBER_OF_ASSOCIATED_CONTENT:
-    return "NUMBER_OF_ASSOCIATED_CONTENT";
-  case LIBPFF_ENTRY_TYPE_ATTACHMENT_DATA_OBJECT:
-    return "ATTACHMENT_DATA_OBJECT";
-  case LIBPFF_ENTRY_TYPE_ATTACHMENT_FILENAME_SHORT:
-    return "ATTACHMENT_FILENAME_SHORT";
-  case LIBPFF_ENTRY_TYPE_ATTACHMENT_METHOD:
-    return "ATTACHMENT_METHOD";
-  case LIBPFF_ENTRY_TYPE_ATTACHMENT_FILENAME_LONG:
-    return "ATTACHMENT_FILENAME_LONG";
-  case LIBPFF_ENTRY_TYPE_ATTACHMENT_RENDERING_POSITION:
-    return "ATTACHMENT_RENDERING_POSITION";
-  case LIBPFF_ENTRY_TYPE_CONTACT_CALLBACK_PHONE_NUMBER:
-    return "CONTACT_CALLBACK_PHONE_NUMBER";
-  case LIBPFF_ENTRY_TYPE_CONTACT_GENERATIONAL_ABBREVIATION:
-    return "CONTACT_GENERATIONAL_ABBREVIATION";
-  case LIBPFF_ENTRY_TYPE_CONTACT_GIVEN_NAME:
-    return "CONTACT_GIVEN_NAME";
-  case LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_PHONE_NUMBER_1:
-    return "CONTACT_BUSINESS_PHONE_NUMBER_1";
-  case LIBPFF_ENTRY_TYPE_CONTACT_HOME_PHONE_NUMBER:
-    return "CONTACT_HOME_PHONE_NUMBER";
-  case LIBPFF_ENTRY_TYPE_CONTACT_INITIALS:
-    return "CONTACT_INITIALS";
-  case LIBPFF_ENTRY_TYPE_CONTACT_SURNAME:
-    return "CONTACT_SURNAME";
-  case LIBPFF_ENTRY_TYPE_CONTACT_POSTAL_ADDRESS:
-    return "CONTACT_POSTAL_ADDRESS";
-  case LIBPFF_ENTRY_TYPE_CONTACT_COMPANY_NAME:
-    return "CONTACT_COMPANY_NAME";
-  case LIBPFF_ENTRY_TYPE_CONTACT_JOB_TITLE:
-    return "CONTACT_JOB_TITLE";
-  case LIBPFF_ENTRY_TYPE_CONTACT_DEPARTMENT_NAME:
-    return "CONTACT_DEPARTMENT_NAME";
-  case LIBPFF_ENTRY_TYPE_CONTACT_OFFICE_LOCATION:
-    return "CONTACT_OFFICE_LOCATION";
-  case LIBPFF_ENTRY_TYPE_CONTACT_PRIMARY_PHONE_NUMBER:
-    return "CONTACT_PRIMARY_PHONE_NUMBER";
-  case LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_PHONE_NUMBER_2:
-    return "CONTACT_BUSINESS_PHONE_NUMBER_2";
-  case LIBPFF_ENTRY_TYPE_CONTACT_MOBILE_PHONE_NUMBER:
-    return "CONTACT_MOBILE_PHONE_NUMBER";
-  case LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_FAX_NUMBER:
-    return "CONTACT_BUSINESS_FAX_NUMBER";
-  case LIBPFF_ENTRY_TYPE_CONTACT_COUNTRY:
-    return "CONTACT_COUNTRY";
-  case LIBPFF_ENTRY_TYPE_CONTACT_LOCALITY:
-    return "CONTACT_LOCALITY";
-  case LIBPFF_ENTRY_TYPE_CONTACT_TITLE:
-    return "CONTACT_TITLE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_CODEPAGE:
-    return "MESSAGE_BODY_CODEPAGE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_CODEPAGE:
-    return "MESSAGE_CODEPAGE";
-  case LIBPFF_ENTRY_TYPE_RECIPIENT_DISPLAY_NAME:
-    return "RECIPIENT_DISPLAY_NAME";
-  case LIBPFF_ENTRY_TYPE_FOLDER_CHILD_COUNT:
-    return "FOLDER_CHILD_COUNT";
-  case LIBPFF_ENTRY_TYPE_SUB_ITEM_IDENTIFIER:
-    return "SUB_ITEM_IDENTIFIER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_STORE_PASSWORD_CHECKSUM:
-    return "MESSAGE_STORE_PASSWORD_CHECKSUM";
-  case LIBPFF_ENTRY_TYPE_ADDRESS_FILE_UNDER:
-    return "ADDRESS_FILE_UNDER";
-  case LIBPFF_ENTRY_TYPE_TASK_STATUS:
-    return "TASK_STATUS";
-  case LIBPFF_ENTRY_TYPE_TASK_PERCENTAGE_COMPLETE:
-    return "TASK_PERCENTAGE_COMPLETE";
-  case LIBPFF_ENTRY_TYPE_TASK_START_DATE:
-    return "TASK_START_DATE";
-  case LIBPFF_ENTRY_TYPE_TASK_DUE_DATE:
-    return "TASK_DUE_DATE";
-  case LIBPFF_ENTRY_TYPE_TASK_ACTUAL_EFFORT:
-    return "TASK_ACTUAL_EFFORT";
-  case LIBPFF_ENTRY_TYPE_TASK_TOTAL_EFFORT:
-    return "TASK_TOTAL_EFFORT";
-  case LIBPFF_ENTRY_TYPE_TASK_VERSION:
-    return "TASK_VERSION";
-  case LIBPFF_ENTRY_TYPE_TASK_IS_COMPLETE:
-    return "TASK_IS_COMPLETE";
-  case LIBPFF_ENTRY_TYPE_TASK_IS_RECURRING:
-    return "TASK_IS_RECURRING";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_BUSY_STATUS:
-    return "APPOINTMENT_BUSY_STATUS";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_LOCATION:
-    return "APPOINTMENT_LOCATION";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_START_TIME:
-    return "APPOINTMENT_START_TIME";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_END_TIME:
-    return "APPOINTMENT_END_TIME";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_DURATION:
-    return "APPOINTMENT_DURATION";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_IS_RECURRING:
-    return "APPOINTMENT_IS_RECURRING";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_RECURRENCE_PATTERN:
-    return "APPOINTMENT_RECURRENCE_PATTERN";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_TIMEZONE_DESCRIPTION:
-    return "APPOINTMENT_TIMEZONE_DESCRIPTION";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_FIRST_EFFECTIVE_TIME:
-    return "APPOINTMENT_FIRST_EFFECTIVE_TIME";
-  case LIBPFF_ENTRY_TYPE_APPOINTMENT_LAST_EFFECTIVE_TIME:
-    return "APPOINTMENT_LAST_EFFECTIVE_TIME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_REMINDER_TIME:
-    return "MESSAGE_REMINDER_TIME";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_IS_REMINDER:
-    return "MESSAGE_IS_REMINDER";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_IS_PRIVATE:
-    return "MESSAGE_IS_PRIVATE";
-  case LIBPFF_ENTRY_TYPE_MESSAGE_REMINDER_SIGNAL_TIME:
-    return "MESSAGE_REMINDER_SIGNAL_TIME";
-  default:
-    return "UNRECOGNIZED";
+  std::vector<std::string> parts;
+  for (size_t b = root.size() + 1, e; b <= path.size(); b = e + 1) {
+    e = std::min(path.find('/', b), path.size());
+    parts.push_back(path.substr(b, e - b));
   }
-}
 
-template <typename L, typename G> void write_binary_value(
-  L length_getter,
-  G value_getter,
-  libpff_item_t* item,
-  uint32_t si,
-  uint32_t etype,
-  uint8_t flags,
-  const std::string& key,
-  JSON_writer& json)
-{
-  libpff_error_t* error = 0;
-  size_t len;
-  switch (length_getter(item, si, etype, &len, flags, &error)) {
-  case -1:
-    throw libpff_error(error, __LINE__);
-  case  0:
-    break;
-  case  1:
-    boost::scoped_array<uint8_t> buf(new uint8_t[len]);
-    if (value_getter(item, si, etype, buf.get(), len, flags, &error) != 1) {
-      throw libpff_error(error, __LINE__);
+  ItemPtr itemp;
+  std::string ipath(root);
+  dpath = root;
+
+  std::vector<std::string>::const_iterator i(parts.begin());
+  if (*i == "orphans" || *i == "recovered") {
+    if (*i == "recovered") {
+      throw std::runtime_error("recovered items can't be found by path: " + path);
     }
 
-    json.object_member_write(key, buf.get(), len);
+    ipath += "/orphans";
+    dpath += "/orphans";
+    ++i;
   }
-}
+  else if (*i == "identifier") {
+    if (++i == parts.end()) {
+      throw std::runtime_error("not an item path: " + path);
+    }
 
-void write_binary_multi_value(
-  libpff_multi_value_t* mv,
-  uint32_t si,
-  uint32_t ei,
-  size_t count,
-  const std::string& path,
-  JSON_writer& json)
-{
-  libpff_error_t* error = 0;
-  size_t len;
-  for (size_t i = 0; i < count; ++i) {
+    uint32_t id;
     try {
-      switch (libpff_multi_value_get_value_binary_data_size(mv, i, &len, &error)) {
-      case -1:
-        throw libpff_error(error, __LINE__);
-      case  0:
-// FIXME: is this possible?
-        break;
-      case  1:
-        {
-          boost::scoped_array<uint8_t> buf(new uint8_t[len]);
-          if (libpff_multi_value_get_value_binary_data(mv, i, buf.get(), len, &error) != 1) {
-            throw libpff_error(error, __LINE__);
-          }
-          json.array_member_write(buf.get(), len);
-        }
-      }
+      id = boost::lexical_cast<uint32_t>(*i);
     }
-    catch (const libpff_error& e) {
-      std::cerr << "Error: " << path
-                << '[' << si << "][" << ei << "][" << i << "]: "
-                << e.what() << std::endl;
+    catch (const boost::bad_lexical_cast&) {
+      throw std::runtime_error("not an item path: " + path);
     }
+
+    itemp.reset(get_item(file, id), &destroy_item);
+    ipath += "/identifier/" + *i;
+    dpath = walker.display_path(itemp.get(), ipath, dpath + "/identifier", id);
+    ++i;
+  }
+  else {
+    itemp.reset(get_root(file), &destroy_item);
   }
-}
 
-template <typename L, typename G> void write_string_value(
-  L length_getter,
-  G value_getter,
-  libpff_item_t* item,
-  uint32_t si,
-  uint32_t etype,
-  uint8_t flags,
-  const std::string& key,
-  JSON_writer& json)
-{
-  libpff_error_t* error = 0;
-  size_t len;
-  switch (length_getter(item, si, etype, &len, flags, &error)) {
-  case -1:
-    throw libpff_error(error, __LINE__);
-  case  0:
-    break;
-  case  1:
-    {
-      boost::scoped_array<uint8_t> buf(new uint8_t[len]);
-      if (value_getter(item, si, etype, buf.get(), len, flags, &error) != 1) {
-        throw libpff_error(error, __LINE__);
+  for ( ; i != parts.end(); ++i) {
+    if (*i == "unknowns" && itemp) {
+      itemp.reset(get_unknowns(itemp.get()), &destroy_item);
+      if (!itemp) {
+        throw std::runtime_error("no such item: " + path);
       }
 
-      json.object_member_write(key, (const char*) buf.get());
+      ipath += "/unknowns";
+      dpath += "/unknowns";
+      continue;
     }
-    break;
+
+    int n;
+    try {
+      n = boost::lexical_cast<int>(*i);
+    }
+    catch (const boost::bad_lexical_cast&) {
+      throw std::runtime_error("not an item path: " + path);
+    }
+
+    itemp.reset(itemp ? get_child(itemp.get(), n) : get_orphan(file, n), &destroy_item);
+    ipath += '/' + *i;
+    dpath = walker.display_path(itemp.get(), ipath, dpath, n);
+  }
+
+  if (!itemp) {
+    throw std::runtime_error("not an item path: " + path);
   }
+
+  return itemp;
 }
 
-void write_string_multi_value(
-  libpff_multi_value_t* mv,
-  uint32_t si,
-  uint32_t ei,
-  size_t count,
-  const std::string& path,
-  JSON_writer& json)
-{
-  libpff_error_t* error = 0;
-  size_t len;
-  for (size_t i = 0; i < count; ++i) {
+// Extracts the item at path, and what is under it if scope says so.
+void handle_path(libpff_file_t* file, const std::string& filename, const std::string& path, Pst_walker::Scope scope, Pst_walker& walker) {
+  std::string dpath;
+  ItemPtr itemp(find_item(file, filename, path, dpath, walker));
+  walker.walk_item(itemp.get(), path, dpath, scope);
+}
+
+//
+// Extracts the items with the given identifiers, and what is under them
+// if scope says so, looking each one up directly. They are taken in
+// identifier order, which approximates file order. Their paths are
+// /name/identifier/N, since their places in the tree aren't known.
+//
+void handle_identifiers(libpff_file_t* file, const std::string& filename, std::vector<uint32_t> ids, Pst_walker::Scope scope, Pst_walker& walker, Context& ctx) {
+  std::sort(ids.begin(), ids.end());
+  ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+
+  const std::string root('/' + filename + "/identifier");
+
+  for (std::vector<uint32_t>::const_iterator i(ids.begin()); i != ids.end(); ++i) {
+    check_cancel(ctx);
+    const std::string path(root + '/' + *i);
     try {
-      switch (libpff_multi_value_get_value_utf8_string_size(mv, i, &len, &error)) {
-      case -1:
-        throw libpff_error(error, __LINE__);
-      case  0:
-// FIXME: is this possible?
-        break;
-      case  1:
-        {
-          boost::scoped_array<uint8_t> buf(new uint8_t[len]);
-          if (libpff_multi_value_get_value_utf8_string(mv, i, buf.get(), len, &error) != 1) {
-            throw libpff_error(error, __LINE__);
-          }
-          json.array_member_write((const char*) buf.get());
-        }
-      }
+      ItemPtr itemp(get_item(file, *i), &destroy_item);
+      walker.walk_item(itemp.get(), path, walker.display_path(itemp.get(), path, root, *i), scope);
     }
     catch (const libpff_error& e) {
-      std::cerr << "Error: " << path
-                << '[' << si << "][" << ei << "][" << i << "]: "
-                << e.what() << std::endl;
+      report(ctx, "item", path, e);
     }
   }
 }
 
-template <typename U, typename S, typename G> void write_numeric_value(
-  G getter,
-  libpff_item_t* item,
-  uint32_t si,
-  uint32_t etype,
-  uint8_t flags,
-  const std::string& key,
-  JSON_writer& json)
-{
-  libpff_error_t* error = 0;
-  U val;
-  switch (getter(item, si, etype, &val, flags, &error)) {
-  case -1:
-    throw libpff_error(error, __LINE__);
-  case  0:
-    break;
-  case  1:
-    json.object_member_write(key, (S) val);
-    break;
-  }
+namespace {
+  struct Found_item {
+    uint32_t id;
+    std::string path;
+    std::string dpath;
+    ItemPtr item;
+
+    bool operator<(const Found_item& other) const { return id < other.id; }
+  };
 }
 
-template <typename U, typename S, typename G> void write_numeric_multi_value(
-  G getter,
-  libpff_multi_value_t* mv,
-  uint32_t si,
-  uint32_t ei,
-  size_t count,
-  const std::string& path,
-  JSON_writer& json)
-{
-  libpff_error_t* error = 0;
-  U val;
-  for (size_t i = 0; i < count; ++i) {
+//
+// Extracts the items at the given paths, and what is under them if scope
+// says so. All are found first, and then taken in identifier order, as
+// with identifiers; paths which can't be followed are reported.
+//
+void handle_paths(libpff_file_t* file, const std::string& filename, std::vector<std::string> paths, Pst_walker::Scope scope, Pst_walker& walker, Context& ctx) {
+  std::sort(paths.begin(), paths.end());
+  paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+  std::vector<Found_item> found;
+  for (std::vector<std::string>::const_iterator i(paths.begin()); i != paths.end(); ++i) {
+    check_cancel(ctx);
     try {
-      switch (getter(mv, i, &val, &error)) {
-      case -1:
-        throw libpff_error(error, __LINE__);
-      case  0:
-        break;
-      case  1:
-        json.array_member_write((S) val);
-      break;
+      Found_item f;
+      f.path = *i;
+      f.item = find_item(file, filename, *i, f.dpath, walker);
+
+      // if it can't be read, walking the item reports why
+      f.id = 0;
+      try {
+        f.id = get_attrib<uint32_t>(
+          boost::bind(&libpff_item_get_identifier, f.item.get(), _1, _2)
+        );
+      }
+      catch (const libpff_error&) {
       }
+
+      found.push_back(f);
     }
     catch (const libpff_error& e) {
-      std::cerr << "Error: " << path
-                << '[' << si << "][" << ei << "][" << i << "]: "
-                << e.what() << std::endl;
+      report(ctx, "item", *i, e);
+    }
+    catch (const std::runtime_error& e) {
+      ctx.errors.report("item", *i, __LINE__, e.what());
     }
   }
-}
 
-void write_single_value(
-  libpff_item_t* item,
-  uint32_t si,
-  uint32_t etype,
-  uint32_t vtype,
-  uint8_t flags,
-  JSON_writer& json)
-{
-  const std::string key(entry_type_string(etype));
-
-  switch (vtype) {
-  case LIBPFF_VALUE_TYPE_UNSPECIFIED:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_NULL:
-    json.object_member_write_null(key);
-    break;
-  case LIBPFF_VALUE_TYPE_INTEGER_16BIT_SIGNED:
-    write_numeric_value<uint16_t, int16_t>(
-      &libpff_item_get_entry_value_16bit,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_INTEGER_32BIT_SIGNED:
-    write_numeric_value<uint32_t, int32_t>(
-      &libpff_item_get_entry_value_32bit,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_FLOAT_32BIT:
-  case LIBPFF_VALUE_TYPE_DOUBLE_64BIT:
-    write_numeric_value<double, double>(
-      &libpff_item_get_entry_value_floating_point,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_CURRENCY:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_APPLICATION_TIME:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_ERROR:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_BOOLEAN:
-    write_numeric_value<uint8_t, bool>(
-      &libpff_item_get_entry_value_boolean,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_OBJECT:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_INTEGER_64BIT_SIGNED:
-    write_numeric_value<uint64_t, int64_t>(
-      &libpff_item_get_entry_value_64bit,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_STRING_ASCII:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_STRING_UNICODE:
-    write_string_value(
-      &libpff_item_get_entry_value_utf8_string_size,
-      &libpff_item_get_entry_value_utf8_string,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_FILETIME:
-    write_numeric_value<uint64_t, uint64_t>(
-      &libpff_item_get_entry_value_filetime,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_GUID:
-    // FIXME: will this be a printable string?
-    write_string_value(
-      &libpff_item_get_entry_value_size,
-      &libpff_item_get_entry_value_guid,
-      item, si, etype, flags, key, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_SERVER_IDENTIFIER:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_RESTRICTION:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_RULE_ACTION:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_BINARY_DATA:
-    write_binary_value(
-      &libpff_item_get_entry_value_binary_data_size,
-      &libpff_item_get_entry_value_binary_data,
-      item, si, etype, flags, key, json
-    );
-    break;
+  std::stable_sort(found.begin(), found.end());
+
+  for (std::vector<Found_item>::iterator i(found.begin()); i != found.end(); ++i) {
+    check_cancel(ctx);
+    walker.walk_item(i->item.get(), i->path, i->dpath, scope);
+
+    // done with it
+    i->item.reset();
   }
 }
 
-void write_multi_value(
-  libpff_item_t* item,
-  uint32_t si,
-  uint32_t ei,
-  uint32_t etype,
-  uint32_t vtype,
-  uint8_t flags,
-  const std::string& path,
-  JSON_writer& json)
-{
-  libpff_error_t* error = 0;
+// The name paths in a PST start with.
+std::string pst_name(const char* path) {
+  return std::max(strchr(path, '/') + 1, path);
+}
+
+// A libpff file and the libbfio handle it reads through, if any. The
+// handle is declared first, so that it outlives the file.
+struct Input {
+  boost::shared_ptr<libbfio_handle_t> handle;
+  FilePtr file;
+};
+
+// Makes the libbfio handle an Input reads through; empty when libpff
+// should open the file by name itself.
+typedef boost::function<libbfio_handle_t* ()> HandleFactory;
 
-  const std::string key(entry_type_string(etype));
+Input open_input(const char* path, const HandleFactory& make_handle) {
+  Input in;
 
-  MultiValuePtr mvp(get_multivalue(item, si, etype, flags), &destroy_multivalue);
-  if (!mvp) {
-    throw libpff_error("unable to retrieve multi-value entry", __LINE__);
+  if (make_handle) {
+    in.handle.reset(make_handle(), &destroy_bfio_handle);
+    in.file.reset(create_file(in.handle.get()), &destroy_file);
+  }
+  else {
+    in.file.reset(create_file(path), &destroy_file);
   }
 
-  libpff_multi_value_t* mv = mvp.get();
+  return in;
+}
 
-  int count;
-  if (libpff_multi_value_get_number_of_values(mv, &count, &error) == -1) {
-    throw libpff_error(error, __LINE__);
+// Maps path for reads of the given kind. The walk and the recovery scan
+// each get a mapping of their own, since the walk jumps about, while the
+// scan reads the file in order.
+MappedFilePtr map_file(const char* path, Mapped_file::Access access) {
+  MappedFilePtr mapped(new Mapped_file(path));
+  mapped->advise(access);
+  return mapped;
+}
+
+struct Options {
+  Options():
+    error_file(0), inline_errors(false), error_limit(1000),
+    recover(true), recovery_flags(0), mmap(false), io_uring(false), io_uring_depth(32),
+    image(0), offset(0), length(0), fragments(0),
+    arrow(0), arrow_columns(0), arrow_batch_size(65536),
+    name_dictionary(false), timestamps(Filetime_format::TICKS),
+    semantic(false), rtf(RTF_COMPRESSED), locality(false), order_window(0),
+    inventory(false), subtree(false), daemon(0), workers(0), cache_size(16), output_dir(0),
+    index(0), index_fields(0), dedup(false), dedup_file(0),
+    trace(0), trace_sample(1), sample(1), sample_seed(0), shard(0), shards(0) {}
+
+  const char* error_file;
+  bool inline_errors;
+  unsigned long error_limit;
+  bool recover;
+  uint8_t recovery_flags;
+  bool mmap;
+  bool io_uring;
+  unsigned int io_uring_depth;
+  const char* image;
+  uint64_t offset;
+  uint64_t length;
+  const char* fragments;
+  const char* arrow;
+  const char* arrow_columns;
+  size_t arrow_batch_size;
+  bool name_dictionary;
+  Filetime_format::Style timestamps;
+  bool semantic;
+  Rtf_mode rtf;
+  bool locality;
+  size_t order_window;
+  bool inventory;
+  std::vector<uint32_t> item_ids;
+  std::vector<std::string> paths;
+  bool subtree;
+  const char* daemon;
+  unsigned int workers;
+  size_t cache_size;
+  const char* output_dir;
+  const char* index;
+  const char* index_fields;
+  bool dedup;
+  const char* dedup_file;
+  const char* trace;
+  unsigned int trace_sample;
+  double sample;
+  uint64_t sample_seed;
+  unsigned int shard;
+  unsigned int shards;
+};
+
+// what --index indexes unless told otherwise
+const char* const DEFAULT_INDEX_FIELDS =
+  "MESSAGE_SUBJECT,MESSAGE_BODY_PLAIN_TEXT,MESSAGE_SENDER_NAME,"
+  "MESSAGE_SENDER_EMAIL_ADDRESS,MESSAGE_SENT_REPRESENTING_NAME,"
+  "MESSAGE_DISPLAY_TO,DISPLAY_NAME,EMAIL_ADDRESS,ATTACHMENT_FILENAME_LONG,"
+  "RECIPIENT_DISPLAY_NAME";
+
+// long options without a short equivalent
+enum {
+  OPT_RECOVERY_FLAGS = 256,
+  OPT_NO_RECOVERY,
+  OPT_MMAP,
+  OPT_IO_URING,
+  OPT_IO_URING_DEPTH,
+  OPT_IMAGE,
+  OPT_OFFSET,
+  OPT_LENGTH,
+  OPT_FRAGMENTS,
+  OPT_ARROW,
+  OPT_ARROW_COLUMNS,
+  OPT_ARROW_BATCH_SIZE,
+  OPT_NAME_DICTIONARY,
+  OPT_TIMESTAMPS,
+  OPT_SEMANTIC,
+  OPT_RTF,
+  OPT_ORDER,
+  OPT_ORDER_WINDOW,
+  OPT_INVENTORY,
+  OPT_ITEM_ID,
+  OPT_ITEM_IDS,
+  OPT_PATH,
+  OPT_SUBTREE,
+  OPT_DAEMON,
+  OPT_WORKERS,
+  OPT_CACHE_SIZE,
+  OPT_OUTPUT_DIR,
+  OPT_INDEX,
+  OPT_INDEX_FIELDS,
+  OPT_DEDUP,
+  OPT_DEDUP_FILE,
+  OPT_TRACE,
+  OPT_TRACE_SAMPLE,
+  OPT_SAMPLE,
+  OPT_SAMPLE_SEED,
+  OPT_SHARD
+};
+
+uint8_t parse_recovery_flags(const std::string& arg) {
+  uint8_t flags = 0;
+
+  std::istringstream in(arg);
+  std::string flag;
+  while (std::getline(in, flag, ',')) {
+    if (flag == "ignore-allocation-data") {
+      flags |= LIBPFF_RECOVERY_FLAG_IGNORE_ALLOCATION_DATA;
+    }
+    else if (flag == "scan-for-fragments") {
+      flags |= LIBPFF_RECOVERY_FLAG_SCAN_FOR_FRAGMENTS;
+    }
+    else if (flag != "none") {
+      throw std::runtime_error("unknown recovery flag: " + flag);
+    }
   }
 
-  json.array_member_open(key);
+  return flags;
+}
 
-  switch (vtype) {
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_16BIT_SIGNED:
-    // TODO: libpff_multi_value_get_value_16bit does not exist
-    throw libpff_error(error, __LINE__);
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_32BIT_SIGNED:
-    write_numeric_multi_value<uint32_t, int32_t>(
-      &libpff_multi_value_get_value_32bit,
-      mv, si, ei, count, path, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_FLOAT_32BIT:
-    // TODO: libpff_multi_value_get_value_floating_point does not exist
-    throw libpff_error(error, __LINE__);
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_DOUBLE_64BIT:
-    // TODO: libpff_multi_value_get_value_floating_point does not exist
-    throw libpff_error(error, __LINE__);
-    break;
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_CURRENCY:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_APPLICATION_TIME:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_64BIT_SIGNED:
-    write_numeric_multi_value<uint64_t, int64_t>(
-      &libpff_multi_value_get_value_64bit,
-      mv, si, ei, count, path, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_ASCII:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_UNICODE:
-    write_string_multi_value(mv, si, ei, count, path, json);
-    break;
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_FILETIME:
-    write_numeric_multi_value<uint64_t, uint64_t>(
-      &libpff_multi_value_get_value_filetime,
-      mv, si, ei, count, path, json
-    );
-    break;
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_GUID:
-    throw libpff_error(key, __LINE__);
-  case LIBPFF_VALUE_TYPE_MULTI_VALUE_BINARY_DATA:
-    write_binary_multi_value(mv, si, ei, count, path, json);
-    break;
+void parse_identifiers(const std::string& arg, std::vector<uint32_t>& ids) {
+  std::istringstream in(arg);
+  std::string id;
+  while (std::getline(in, id, ',')) {
+    try {
+      ids.push_back(boost::lexical_cast<uint32_t>(id));
+    }
+    catch (const boost::bad_lexical_cast&) {
+      throw std::runtime_error("not an identifier: " + id);
+    }
+  }
+}
+
+// Reads identifiers from a file, one per line, skipping blank lines and
+// comments.
+void read_identifiers(const char* filename, std::vector<uint32_t>& ids) {
+  std::ifstream in(filename);
+  if (!in) {
+    throw std::runtime_error(std::string("cannot open ") + filename);
   }
 
-  json.array_member_close();
+  std::string line;
+  for (unsigned int lineno = 1; std::getline(in, line); ++lineno) {
+    const std::string::size_type first = line.find_first_not_of(" \t\r");
+    if (first == std::string::npos || line[first] == '#') {
+      continue;
+    }
+
+    std::istringstream ls(line);
+
+    uint32_t id;
+    if (!(ls >> id)) {
+      std::ostringstream msg;
+      msg << filename << ':' << lineno << ": expected an identifier";
+      throw std::runtime_error(msg.str());
+    }
+
+    ids.push_back(id);
+  }
 }
 
-void handle_item_value(libpff_item_t* item, uint32_t s, uint32_t e, const std::string& path, JSON_writer& json) {
-  libpff_error_t* error = 0;
+// Selects the entry types named in arg, or every recognized entry type
+// if arg is null, along with their names.
+void parse_entry_types(const char* arg, std::vector<uint32_t>& etypes, std::vector<std::string>& names) {
+  std::map<std::string, uint32_t> known;
+  for (uint32_t etype = 0; etype <= 0xFFFF; ++etype) {
+    const std::string name(entry_type_string(etype));
+    if (name != "UNRECOGNIZED") {
+      known.insert(std::make_pair(name, etype));
+    }
+  }
 
-  uint32_t etype;
-  uint32_t vtype;
-  libpff_name_to_id_map_entry_t* nkey = 0;
+  if (!arg) {
+    for (std::map<std::string, uint32_t>::const_iterator i(known.begin()); i != known.end(); ++i) {
+      etypes.push_back(i->second);
+      names.push_back(i->first);
+    }
+    return;
+  }
 
-  if (libpff_item_get_entry_type(item, s, e, &etype, &vtype, &nkey, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+  std::istringstream in(arg);
+  std::string name;
+  while (std::getline(in, name, ',')) {
+    std::map<std::string, uint32_t>::const_iterator i(known.find(name));
+    if (i == known.end()) {
+      throw std::runtime_error("unknown entry type: " + name);
+    }
+
+    etypes.push_back(i->second);
+    names.push_back(i->first);
   }
+}
 
-  json.object_member_write("entry type", etype);
-  json.object_member_write("value type", vtype);
+Filetime_format::Style parse_timestamps(const std::string& arg) {
+  if (arg == "ticks") {
+    return Filetime_format::TICKS;
+  }
+  else if (arg == "rfc3339") {
+    return Filetime_format::RFC3339;
+  }
+  else if (arg == "epoch-ns") {
+    return Filetime_format::EPOCH_NS;
+  }
 
-  try {
-    if (nkey) {
-      uint8_t ntype;
-      if (libpff_name_to_id_map_entry_get_type(nkey, &ntype, &error) != 1) {
-        throw libpff_error(error, __LINE__);
-      }
+  throw std::runtime_error("unknown timestamp format: " + arg);
+}
 
-      if (ntype == LIBPFF_NAME_TO_ID_MAP_ENTRY_TYPE_NUMERIC) {
-        uint32_t nnum;
-        if (libpff_name_to_id_map_entry_get_number(nkey, &nnum, &error) != 1) {
-          throw libpff_error(error, __LINE__);
-        }
+Rtf_mode parse_rtf(const std::string& arg) {
+  if (arg == "compressed") {
+    return RTF_COMPRESSED;
+  }
+  else if (arg == "rtf") {
+    return RTF_DECOMPRESSED;
+  }
+  else if (arg == "body") {
+    return RTF_BODY;
+  }
 
-// TODO: what is this?
-        json.object_member_write("maps to entry type", nnum);
-      }
-      else if (ntype == LIBPFF_NAME_TO_ID_MAP_ENTRY_TYPE_STRING) {
-        size_t len;
-        if (libpff_name_to_id_map_entry_get_utf8_string_size(nkey, &len, &error) != 1) {
-          throw libpff_error(error, __LINE__);
-        }
+  throw std::runtime_error("unknown RTF output: " + arg);
+}
 
-        boost::scoped_array<uint8_t> buf(new uint8_t[len]);
-        if (libpff_name_to_id_map_entry_get_utf8_string(nkey, buf.get(), len, &error) != 1) {
-          throw libpff_error(error, __LINE__);
-        }
+void usage(std::ostream& out, const char* argv0) {
+  out << "Usage: " << argv0 << " [OPTION]... FILE\n"
+         "  or:  " << argv0 << " [OPTION]... --image=IMAGE [--offset=N] [--length=M]\n"
+         "  or:  " << argv0 << " [OPTION]... --image=IMAGE --fragments=LIST\n"
+         "\n"
+         "  -e, --errors=FILE        write errors to FILE as NDJSON\n"
+         "                           (default: standard error)\n"
+         "  -i, --inline-errors      write errors as records in the output\n"
+         "  -l, --error-limit=N      write at most N errors per category\n"
+         "                           (default: 1000); the rest are counted\n"
+         "      --recovery-flags=LIST  recover deleted items using the\n"
+         "                           comma-separated flags in LIST:\n"
+         "                           ignore-allocation-data,\n"
+         "                           scan-for-fragments (default: none)\n"
+         "      --no-recovery        do not recover deleted items\n"
+         "      --mmap               read FILE through a memory mapping\n"
+         "      --io-uring           read FILE through io_uring, reading\n"
+         "                           ahead of scans in batches\n"
+         "      --io-uring-depth=N   keep up to N reads in flight (default:\n"
+         "                           32)\n"
+         "      --image=IMAGE        read the PST from inside the raw disk\n"
+         "                           image IMAGE instead of from FILE\n"
+         "      --offset=N           the PST starts at byte N of IMAGE\n"
+         "      --length=M           the PST is M bytes long (default: to\n"
+         "                           the end of IMAGE)\n"
+         "      --fragments=LIST     the PST is the concatenation of the\n"
+         "                           IMAGE extents listed in LIST, one\n"
+         "                           \"offset length\" pair per line\n"
+         "      --arrow=DIR          write items to DIR as Arrow IPC files,\n"
+         "                           one per item type, instead of JSON\n"
+         "      --arrow-columns=LIST  export only the comma-separated entry\n"
+         "                           types in LIST (default: all)\n"
+         "      --arrow-batch-size=N  write record batches of N rows\n"
+         "                           (default: 65536)\n"
+         "      --name-dictionary    write named properties by ID, with the\n"
+         "                           names in a dictionary at the end\n"
+         "      --timestamps=FORMAT  write FILETIMEs as ticks (the default),\n"
+         "                           rfc3339 strings, or epoch-ns integers\n"
+         "      --semantic           write emails, contacts, appointments and\n"
+         "                           tasks as one compact record each, with\n"
+         "                           recipients and attachments inline\n"
+         "      --rtf=OUTPUT         write compressed RTF bodies as the\n"
+         "                           compressed blob (the default), as\n"
+         "                           decompressed rtf, or as the HTML or text\n"
+         "                           body the RTF encapsulates, if any\n"
+         "      --order=ORDER        extract items in tree order (the\n"
+         "                           default), or in identifier order,\n"
+         "                           which approximates file order\n"
+         "      --order-window=N     order items N at a time (default: all)\n"
+         "      --inventory          write only item counts and sizes, by\n"
+         "                           folder, without extracting any values\n"
+         "      --item-id=LIST       extract only the items with the comma-\n"
+         "                           separated identifiers in LIST\n"
+         "      --item-ids=FILE      extract only the items with the\n"
+         "                           identifiers in FILE, one per line\n"
+         "      --path=PATH          extract only the item at PATH, as\n"
+         "                           written in its record; may be repeated\n"
+         "      --subtree            with --item-id, --item-ids or --path,\n"
+         "                           extract what is under the items too\n"
+         "      --daemon=SOCKET      serve extraction jobs on the UNIX domain\n"
+         "                           socket SOCKET instead of reading FILE;\n"
+         "                           the other options are the jobs' defaults\n"
+         "      --workers=N          run up to N jobs at once (default: one\n"
+         "                           per CPU)\n"
+         "      --cache-size=N       keep up to N idle PST handles open\n"
+         "                           between jobs (default: 16)\n"
+         "      --output-dir=DIR     let jobs write their output to files\n"
+         "                           in DIR, as their requests name them\n"
+         "      --index=FILE         build a full-text index of the items in\n"
+         "                           FILE, for pstrip-search, as they are\n"
+         "                           extracted\n"
+         "      --index-fields=LIST  index the comma-separated string entry\n"
+         "                           types in LIST (default: subjects, plain\n"
+         "                           text bodies, names, addresses and\n"
+         "                           attachment file names)\n"
+         "      --dedup              write emails already extracted only as\n"
+         "                           a reference to their fingerprint\n"
+         "      --dedup-file=FILE    keep the fingerprints seen in FILE, so\n"
+         "                           runs one after another share them\n"
+         "      --trace=FILE         write a trace of the work on each item\n"
+         "                           to FILE, in Chrome trace event format\n"
+         "      --trace-sample=N     trace only every N-th item (default: 1)\n"
+         "      --sample=RATE        extract only about RATE, between 0 and 1,\n"
+         "                           of the items which aren't folders, each\n"
+         "                           with everything under it\n"
+         "      --sample-seed=N      pick the items to sample by N (default:\n"
+         "                           0); the same seed picks the same items\n"
+         "      --shard=I/N          extract only the I-th of N shares of the\n"
+         "                           items, which N runs, one for each I, can\n"
+         "                           extract at once; pstrip-merge puts their\n"
+         "                           outputs together\n"
+         "  -h, --help               display this help and exit\n";
+}
 
-// TODO: what is this?
-        json.object_member_write("maps to entry", (const char*) buf.get());
+Options parse_options(int argc, char** argv) {
+  static const struct option longopts[] = {
+    { "errors",        required_argument, 0, 'e' },
+    { "inline-errors", no_argument,       0, 'i' },
+    { "error-limit",   required_argument, 0, 'l' },
+    { "recovery-flags", required_argument, 0, OPT_RECOVERY_FLAGS },
+    { "no-recovery",   no_argument,       0, OPT_NO_RECOVERY },
+    { "mmap",          no_argument,       0, OPT_MMAP },
+    { "io-uring",      no_argument,       0, OPT_IO_URING },
+    { "io-uring-depth", required_argument, 0, OPT_IO_URING_DEPTH },
+    { "image",         required_argument, 0, OPT_IMAGE },
+    { "offset",        required_argument, 0, OPT_OFFSET },
+    { "length",        required_argument, 0, OPT_LENGTH },
+    { "fragments",     required_argument, 0, OPT_FRAGMENTS },
+    { "arrow",         required_argument, 0, OPT_ARROW },
+    { "arrow-columns", required_argument, 0, OPT_ARROW_COLUMNS },
+    { "arrow-batch-size", required_argument, 0, OPT_ARROW_BATCH_SIZE },
+    { "name-dictionary", no_argument,     0, OPT_NAME_DICTIONARY },
+    { "timestamps",    required_argument, 0, OPT_TIMESTAMPS },
+    { "semantic",      no_argument,       0, OPT_SEMANTIC },
+    { "rtf",           required_argument, 0, OPT_RTF },
+    { "order",         required_argument, 0, OPT_ORDER },
+    { "order-window",  required_argument, 0, OPT_ORDER_WINDOW },
+    { "inventory",     no_argument,       0, OPT_INVENTORY },
+    { "item-id",       required_argument, 0, OPT_ITEM_ID },
+    { "item-ids",      required_argument, 0, OPT_ITEM_IDS },
+    { "path",          required_argument, 0, OPT_PATH },
+    { "subtree",       no_argument,       0, OPT_SUBTREE },
+    { "daemon",        required_argument, 0, OPT_DAEMON },
+    { "workers",       required_argument, 0, OPT_WORKERS },
+    { "cache-size",    required_argument, 0, OPT_CACHE_SIZE },
+    { "output-dir",    required_argument, 0, OPT_OUTPUT_DIR },
+    { "index",         required_argument, 0, OPT_INDEX },
+    { "index-fields",  required_argument, 0, OPT_INDEX_FIELDS },
+    { "dedup",         no_argument,       0, OPT_DEDUP },
+    { "dedup-file",    required_argument, 0, OPT_DEDUP_FILE },
+    { "trace",         required_argument, 0, OPT_TRACE },
+    { "trace-sample",  required_argument, 0, OPT_TRACE_SAMPLE },
+    { "sample",        required_argument, 0, OPT_SAMPLE },
+    { "sample-seed",   required_argument, 0, OPT_SAMPLE_SEED },
+    { "shard",         required_argument, 0, OPT_SHARD },
+    { "help",          no_argument,       0, 'h' },
+    { 0, 0, 0, 0 }
+  };
+
+  Options opts;
+
+  int c;
+  while ((c = getopt_long(argc, argv, "e:il:h", longopts, 0)) != -1) {
+    switch (c) {
+    case 'e':
+      opts.error_file = optarg;
+      break;
+    case 'i':
+      opts.inline_errors = true;
+      break;
+    case 'l':
+      opts.error_limit = boost::lexical_cast<unsigned long>(optarg);
+      break;
+    case OPT_RECOVERY_FLAGS:
+      opts.recovery_flags = parse_recovery_flags(optarg);
+      break;
+    case OPT_NO_RECOVERY:
+      opts.recover = false;
+      break;
+    case OPT_MMAP:
+      opts.mmap = true;
+      break;
+    case OPT_IO_URING:
+      opts.io_uring = true;
+      break;
+    case OPT_IO_URING_DEPTH:
+      opts.io_uring_depth = boost::lexical_cast<unsigned int>(optarg);
+      break;
+    case OPT_IMAGE:
+      opts.image = optarg;
+      break;
+    case OPT_OFFSET:
+      opts.offset = boost::lexical_cast<uint64_t>(optarg);
+      break;
+    case OPT_LENGTH:
+      opts.length = boost::lexical_cast<uint64_t>(optarg);
+      break;
+    case OPT_FRAGMENTS:
+      opts.fragments = optarg;
+      break;
+    case OPT_ARROW:
+      opts.arrow = optarg;
+      break;
+    case OPT_ARROW_COLUMNS:
+      opts.arrow_columns = optarg;
+      break;
+    case OPT_ARROW_BATCH_SIZE:
+      opts.arrow_batch_size = boost::lexical_cast<size_t>(optarg);
+      break;
+    case OPT_NAME_DICTIONARY:
+      opts.name_dictionary = true;
+      break;
+    case OPT_TIMESTAMPS:
+      opts.timestamps = parse_timestamps(optarg);
+      break;
+    case OPT_SEMANTIC:
+      opts.semantic = true;
+      break;
+    case OPT_RTF:
+      opts.rtf = parse_rtf(optarg);
+      break;
+    case OPT_ORDER:
+      if (std::string(optarg) == "identifier") {
+        opts.locality = true;
+      }
+      else if (std::string(optarg) != "tree") {
+        throw std::runtime_error(std::string("unknown order: ") + optarg);
       }
+      break;
+    case OPT_ORDER_WINDOW:
+      opts.order_window = boost::lexical_cast<size_t>(optarg);
+      break;
+    case OPT_INVENTORY:
+      opts.inventory = true;
+      break;
+    case OPT_ITEM_ID:
+      parse_identifiers(optarg, opts.item_ids);
+      break;
+    case OPT_ITEM_IDS:
+      read_identifiers(optarg, opts.item_ids);
+      break;
+    case OPT_PATH:
+      opts.paths.push_back(optarg);
+      break;
+    case OPT_SUBTREE:
+      opts.subtree = true;
+      break;
+    case OPT_DAEMON:
+      opts.daemon = optarg;
+      break;
+    case OPT_WORKERS:
+      opts.workers = boost::lexical_cast<unsigned int>(optarg);
+      break;
+    case OPT_CACHE_SIZE:
+      opts.cache_size = boost::lexical_cast<size_t>(optarg);
+      break;
+    case OPT_OUTPUT_DIR:
+      opts.output_dir = optarg;
+      break;
+    case OPT_INDEX:
+      opts.index = optarg;
+      break;
+    case OPT_INDEX_FIELDS:
+      opts.index_fields = optarg;
+      break;
+    case OPT_DEDUP:
+      opts.dedup = true;
+      break;
+    case OPT_DEDUP_FILE:
+      opts.dedup_file = optarg;
+      break;
+    case OPT_TRACE:
+      opts.trace = optarg;
+      break;
+    case OPT_TRACE_SAMPLE:
+      opts.trace_sample = boost::lexical_cast<unsigned int>(optarg);
+      break;
+    case OPT_SAMPLE:
+      opts.sample = boost::lexical_cast<double>(optarg);
+      break;
+    case OPT_SAMPLE_SEED:
+      opts.sample_seed = boost::lexical_cast<uint64_t>(optarg);
+      break;
+    case OPT_SHARD:
+      Pst_shard::parse(optarg, opts.shard, opts.shards);
+      break;
+    case 'h':
+      usage(std::cout, argv[0]);
+      exit(EXIT_SUCCESS);
+    default:
+      usage(std::cerr, argv[0]);
+      exit(EXIT_FAILURE);
     }
   }
-  catch (const libpff_error& ex) {
-    std::cerr << "Error: " << path << '[' << s << "][" << e << "]: "
-              << ex.what() << std::endl;
+
+  if (argc - optind != (opts.image || opts.daemon ? 0 : 1)) {
+    throw std::runtime_error("wrong number of arguments");
   }
 
-  uint32_t matched_vtype = LIBPFF_VALUE_TYPE_UNSPECIFIED;
-  uint8_t* vdata = 0;
-  size_t len;
+  if (opts.daemon && (opts.image || opts.arrow || opts.error_file || opts.inventory || opts.locality || opts.name_dictionary)) {
+    throw std::runtime_error("--daemon excludes --image, --arrow, --errors, --inventory, --order and --name-dictionary");
+  }
 
-  if (libpff_item_get_entry_value(
-    item, s, etype, &matched_vtype, &vdata, &len,
-    LIBPFF_ENTRY_VALUE_FLAG_MATCH_ANY_VALUE_TYPE |
-    LIBPFF_ENTRY_VALUE_FLAG_IGNORE_NAME_TO_ID_MAP, &error) != 1)
-  {
-    throw libpff_error(error, __LINE__);
+  if (!opts.daemon && (opts.workers || opts.cache_size != 16 || opts.output_dir)) {
+    throw std::runtime_error("--workers, --cache-size and --output-dir require --daemon");
   }
 
-  if (vtype != matched_vtype) {
-    // the matched type is only interesting in case of a mismatch
-    // FIMXE: maybe this should print an error?
-    json.object_member_write("matched value type", matched_vtype);
+  if (!opts.image && (opts.offset || opts.length || opts.fragments)) {
+    throw std::runtime_error("--offset, --length and --fragments require --image");
   }
 
-  try {
-    if (vtype & LIBPFF_VALUE_TYPE_MULTI_VALUE_FLAG) {
-      write_multi_value(item, s, e, etype, vtype, LIBPFF_ENTRY_VALUE_FLAG_IGNORE_NAME_TO_ID_MAP, path, json);
-    }
-    else {
-      write_single_value(item, s, etype, vtype, 0, json);
-    }
+  if (opts.fragments && (opts.offset || opts.length)) {
+    throw std::runtime_error("--fragments excludes --offset and --length");
   }
-  catch (const libpff_error& ex) {
-    std::cerr << "Error: " << path << '[' << s << "][" << e << "]: "
-              << ex.what() << std::endl;
+
+  if (opts.io_uring && (opts.mmap || opts.image)) {
+    throw std::runtime_error("--io-uring excludes --mmap and --image");
   }
-}
 
-void handle_item_values(libpff_item_t* item, const std::string& path, JSON_writer& json) {
-  libpff_error_t* error = 0;
+  if (!opts.io_uring && opts.io_uring_depth != 32) {
+    throw std::runtime_error("--io-uring-depth requires --io-uring");
+  }
 
-  // number of sets
-  uint32_t sets;
-  if (libpff_item_get_number_of_sets(item, &sets, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+  if (opts.io_uring_depth == 0 || opts.io_uring_depth > 4096) {
+    throw std::runtime_error("--io-uring-depth must be from 1 to 4096");
   }
 
-  json.object_member_write("number of sets", sets);
+  if (!opts.arrow && (opts.arrow_columns || opts.arrow_batch_size != 65536)) {
+    throw std::runtime_error("--arrow-columns and --arrow-batch-size require --arrow");
+  }
 
-  // number of entries per set
-  uint32_t entries;
-  if (libpff_item_get_number_of_entries(item, &entries, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+  if (opts.order_window && !opts.locality) {
+    throw std::runtime_error("--order-window requires --order=identifier");
   }
 
-  json.object_member_write("entries per set", entries);
+  if (opts.inventory && (opts.arrow || opts.semantic || opts.locality || opts.name_dictionary)) {
+    throw std::runtime_error("--inventory excludes --arrow, --semantic, --order and --name-dictionary");
+  }
 
-  if (sets > 0) {
-    json.array_member_open("sets");
+  const bool lookup = !opts.item_ids.empty() || !opts.paths.empty();
 
-    // iterate over sets
-    for (uint32_t s = 0; s < sets; ++s) {
-      json.array_open();
+  if (lookup && (opts.inventory || opts.locality || opts.daemon)) {
+    throw std::runtime_error("--item-id, --item-ids and --path exclude --inventory, --order and --daemon");
+  }
 
-      // iterate over entries
-      for (uint32_t e = 0; e < entries; ++e) {
-        json.object_open();
+  if (opts.index && (opts.inventory || opts.daemon)) {
+    throw std::runtime_error("--index excludes --inventory and --daemon");
+  }
 
-        try {
-          handle_item_value(item, s, e, path, json);
-        }
-        catch (const libpff_error& ex) {
-          std::cerr << "Error: " << path << '[' << s << "][" << e << "]: "
-                    << ex.what() << std::endl;
-        }
+  if (opts.index_fields && !opts.index) {
+    throw std::runtime_error("--index-fields requires --index");
+  }
 
-        json.object_close();
-      }
+  if (opts.dedup && (opts.arrow || opts.inventory)) {
+    throw std::runtime_error("--dedup excludes --arrow and --inventory");
+  }
 
-      json.array_close();
-    }
+  if (opts.dedup_file && !opts.dedup && !opts.daemon) {
+    throw std::runtime_error("--dedup-file requires --dedup or --daemon");
+  }
 
-    json.array_member_close();
+  if (!opts.trace && opts.trace_sample != 1) {
+    throw std::runtime_error("--trace-sample requires --trace");
   }
-}
 
-template <typename C, typename G> void handle_items_loop(C item_count_getter, G item_getter, const std::string& path, const std::string& dpath, JSON_writer& json) {
-  try {
-    libpff_error_t* error = 0;
+  if (opts.trace_sample == 0) {
+    throw std::runtime_error("--trace-sample must be at least 1");
+  }
 
-    int num;
-    if (item_count_getter(&num, &error) != 1) {
-      throw libpff_error(error, __LINE__);
-    }
+  if (!(opts.sample > 0 && opts.sample <= 1)) {
+    throw std::runtime_error("--sample must be more than 0 and at most 1");
+  }
 
-    if (num > 0) {
-      for (int i = 0; i < num; ++i) {
-        std::string cpath(path + '/' + i);
-        try {
-          ItemPtr itemp(item_getter(i), &destroy_item);
-
-          // display name
-          std::string cdpath;
-          try {
-            libpff_error_t* error = 0;
-            size_t len;
-            switch (libpff_item_get_utf8_display_name_size(itemp.get(), &len, &error)) {
-            case -1:
-              throw libpff_error(error, __LINE__);
-            case  0:
-              cdpath = dpath + '/' + i;
-              break;
-            case  1:
-              {
-                boost::scoped_array<uint8_t> buf(new uint8_t[len]);
-                if (libpff_item_get_utf8_display_name(itemp.get(), buf.get(), len, &error) != 1) {
-                  throw libpff_error(error, __LINE__);
-                }
-
-                cdpath = dpath + '/' + (const char*) buf.get();
-              }
-              break;
-            }
-          }
-          catch (const libpff_error& e) {
-            std::cerr << "Error: " << path << ": " << e.what() << std::endl;
-            cdpath = dpath + '/' + i;
-          }
-
-          handle_item(itemp.get(), cpath, cdpath, json);
-        }
-        catch (const libpff_error& e) {
-          std::cerr << "Error: " << cpath << ": " << e.what() << std::endl;
-        }
-      }
-    }
+  if (opts.sample != 1 && opts.inventory) {
+    throw std::runtime_error("--sample excludes --inventory");
   }
-  catch (const libpff_error& e) {
-    std::cerr << "Error: " << path << ": " << e.what() << std::endl;
+
+  if (opts.sample == 1 && opts.sample_seed != 0) {
+    throw std::runtime_error("--sample-seed requires --sample");
   }
-}
 
-void handle_subitems(libpff_item_t* item, const std::string& path, const std::string& dpath, JSON_writer& json) {
-  handle_items_loop(
-    boost::bind(&libpff_item_get_number_of_sub_items, item, _1, _2),
-    boost::bind(&get_child, item, _1),
-    path,
-    dpath,
-    json
-  );
-}
+  if (opts.shards && (lookup || opts.inventory || opts.locality || opts.daemon || opts.arrow || opts.index || opts.dedup || opts.name_dictionary)) {
+    // the others' outputs either can't be merged, or differ by shard
+    throw std::runtime_error("--shard excludes --item-id, --item-ids, --path, --inventory, --order, --daemon, --arrow, --index, --dedup and --name-dictionary");
+  }
 
-void handle_unknowns(libpff_item_t* folder, const std::string& path, const std::string& dpath, JSON_writer& json) {
-  // TODO: These are known unknowns, in the Rumsfeldian sense.
-  // I.e., we know that we have no idea wtf these are.
-  try {
-    ItemPtr unknownsp(get_unknowns(folder), &destroy_item);
-    if (unknownsp) {
-      handle_item(unknownsp.get(), path + "/unknowns", dpath + "/unknowns", json);
-    }
+  if (opts.subtree && !lookup) {
+    throw std::runtime_error("--subtree requires --item-id, --item-ids or --path");
   }
-  catch (const libpff_error& e) {
-    std::cerr << "Error: " << path << ": " << e.what() << std::endl;
+
+  if (lookup) {
+    // lookups find nothing among recovered items, so don't look for any
+    opts.recover = false;
   }
-}
 
-template <typename T, typename G> T get_attrib(G getter) {
-  libpff_error_t* error = 0;
+  if (opts.arrow && opts.semantic) {
+    throw std::runtime_error("--arrow excludes --semantic");
+  }
 
-  T value;
-  if (getter(&value, &error) != 1) {
-    throw libpff_error(error, __LINE__);
+  if (opts.arrow_batch_size == 0) {
+    throw std::runtime_error("--arrow-batch-size must be positive");
   }
-  return value;
+
+  return opts;
 }
 
-template <typename T, typename G> void write_attrib(G getter, const std::string& key, const std::string& path, JSON_writer& json) {
-  try {
-    T value = get_attrib<T>(getter);
-    json.object_member_write(key, value);
+// An open PST, and what is worth keeping along with it between jobs.
+struct Open_pst {
+  Input input;
+
+  // so named properties keep their IDs from job to job
+  Named_properties names;
+};
+
+typedef Handle_cache<Open_pst> Pst_cache;
+
+const std::string* job_param(const Job_request& req, const char* key) {
+  Job_request::const_iterator i(req.find(key));
+  return i == req.end() ? 0 : &i->second;
+}
+
+bool job_flag(const Job_request& req, const char* key, bool def) {
+  const std::string* v = job_param(req, key);
+  if (!v) {
+    return def;
   }
-  catch (const libpff_error& e) {
-    std::cerr << "Error: " << path << ':' << key << ": "
-                           << e.what() << std::endl;
+  else if (*v == "true") {
+    return true;
+  }
+  else if (*v == "false") {
+    return false;
   }
+
+  throw std::runtime_error(std::string("expected true or false for ") + key);
 }
 
-void handle_item(libpff_item_t* item, const std::string& path, const std::string& dpath, JSON_writer& json) {
-  json.object_open();
+//
+// Runs a daemon job on a PST handle from the cache, or a new one. Jobs
+// take "file", and optionally "identifier", a comma-separated list, or
+// "path", to extract only the items so identified and, unless "subtree"
+// is false, what is under them; or "inventory"; and "semantic",
+// "timestamps", "rtf", "dedup" and "recover", which override the daemon's
+// options, except that jobs recover deleted items only if they ask to.
+// Jobs which dedup share seen. Errors are written inline.
+//
+void run_job(const Options& opts, Pst_cache& cache, Seen_set& seen, const Job_request& req, std::ostream& out, const std::atomic<bool>& cancel) {
+  const std::string* path = job_param(req, "file");
+  if (!path) {
+    throw std::runtime_error("no file given");
+  }
+
+  // the key changes with the file, so stale handles are never taken
+  struct stat st;
+  if (stat(path->c_str(), &st) == -1) {
+    throw std::runtime_error("cannot stat " + *path + ": " + std::strerror(errno));
+  }
 
-  // path
-  json.object_member_write("path", path);
+  const std::string key(
+    *path + '\n' + st.st_size + '\n' + st.st_mtim.tv_sec + '.' + st.st_mtim.tv_nsec
+  );
 
-  // display path
-  json.object_member_write("display path", dpath);
+  // recovery scans the whole file, so it is never done on a cached handle
+  const bool recover = job_flag(req, "recover", false);
 
-  // item type
-  uint8_t itype = LIBPFF_ITEM_TYPE_UNDEFINED;
-  try {
-    itype = get_attrib<uint8_t>(
-      boost::bind(&libpff_item_get_type, item, _1, _2)
-    );
-    json.object_member_write("item type", (uint32_t) itype);
-    json.object_member_write("item type name", item_type_string(itype));
+  Pst_cache::Ptr pst(cache.take(key));
+
+  // a mapping or a ring only for handles still to be opened
+  HandleFactory make_handle;
+  HandleFactory make_recovery_handle;
+  if (opts.mmap) {
+    if (!pst) {
+      make_handle = boost::bind(
+        &create_mapped_handle, map_file(path->c_str(), Mapped_file::RANDOM)
+      );
+    }
+    if (recover) {
+      make_recovery_handle = boost::bind(
+        &create_mapped_handle, map_file(path->c_str(), Mapped_file::SEQUENTIAL)
+      );
+    }
   }
-  catch (const libpff_error& e) {
-    std::cerr << "Error: " << path << ": " << e.what() << std::endl;
+  else if (opts.io_uring && (!pst || recover)) {
+    make_handle = boost::bind(
+      &create_uring_handle, UringFilePtr(new Uring_file(path->c_str(), opts.io_uring_depth))
+    );
+    make_recovery_handle = make_handle;
   }
 
-  // identifier
-  write_attrib<uint32_t>(
-    boost::bind(&libpff_item_get_identifier, item, _1, _2),
-    "identifier", path, json
-  );
+  if (!pst) {
+    pst.reset(new Open_pst);
+    pst->input = open_input(path->c_str(), make_handle);
+  }
 
-  // item values
   try {
-    handle_item_values(item, path, json);
-  }
-  catch (const libpff_error& e) {
-    std::cerr << "Error: " << path << ": " << e.what() << std::endl;
-  }
+    libpff_file_t* file = pst->input.file.get();
+    const std::string filename(pst_name(path->c_str()));
+
+    Input recinput;
+    std::future<void> scan;
+    if (recover) {
+      recinput = open_input(path->c_str(), make_recovery_handle);
+      scan = std::async(
+        std::launch::async, &recover_items,
+        recinput.file.get(), opts.recovery_flags
+      );
+    }
 
-  json.object_close();
-  json.reset();
+    JSON_writer json(out);
+    Error_log errors(json, opts.error_limit);
 
-  // process children
-  handle_subitems(item, path, dpath, json);
+    const std::string* v = job_param(req, "timestamps");
+    Filetime_format times(v ? parse_timestamps(*v) : opts.timestamps);
 
-  // process unknowns, for folders only
-  if (itype == LIBPFF_ITEM_TYPE_FOLDER) {
-    handle_unknowns(item, path, dpath, json);
-  }
-}
+    Context ctx(json, errors, pst->names, times);
+    ctx.semantic = job_flag(req, "semantic", opts.semantic);
+    v = job_param(req, "rtf");
+    ctx.rtf = v ? parse_rtf(*v) : opts.rtf;
+    ctx.cancel = &cancel;
+    if (job_flag(req, "dedup", opts.dedup)) {
+      ctx.seen = &seen;
+    }
 
-void handle_tree(libpff_file_t* file, const std::string& filename, JSON_writer& json) {
-  ItemPtr rootp(get_root(file), &destroy_item);
-  handle_subitems(rootp.get(), '/' + filename, '/' + filename, json);
-}
+    Json_visitor visitor(ctx);
+    Pst_walker walker(visitor);
+    walker.set_cancel(&cancel);
 
-void handle_orphans(libpff_file_t* file, const std::string& filename, JSON_writer& json) {
-  handle_items_loop(
-    boost::bind(&libpff_file_get_number_of_orphan_items, file, _1, _2),
-    boost::bind(&get_orphan, file, _1),
-    '/' + filename + "/orphans",
-    '/' + filename + "/orphans",
-    json
-  );
-}
+    const Pst_sample sample(opts.sample, opts.sample_seed);
+    if (opts.sample != 1) {
+      walker.set_sample(&sample);
+    }
 
-void handle_recovered(libpff_file_t* file, const std::string& filename, JSON_writer& json) {
-  std::string path( '/' + filename + "/recovered");
+    const Pst_walker::Scope scope =
+      job_flag(req, "subtree", true) ? Pst_walker::SUB_ITEMS : Pst_walker::ITEM;
 
-  try {
-/*
-  TODO: Not sure we're using this correctly.
-
-  TODO: which flags to use?
-    LIBPFF_RECOVERY_FLAG_IGNORE_ALLOCATION_DATA
-    LIBPFF_RECOVERY_FLAG_SCAN_FOR_FRAGMENTS
-*/
-    libpff_error_t* error = 0;
-    if (libpff_file_recover_items(file, 0, &error) == -1) {
-      throw libpff_error(error, __LINE__);
-    }
-
-    handle_items_loop(
-      boost::bind(&libpff_file_get_number_of_recovered_items, file, _1, _2),
-      boost::bind(&get_recovered, file, _1),
-      path,
-      path,
-      json
-    );
+    if (job_flag(req, "inventory", false)) {
+      handle_inventory(file, recinput.file.get(), recover ? &scan : 0, filename, ctx);
+    }
+    else if ((v = job_param(req, "identifier"))) {
+      std::vector<uint32_t> ids;
+      parse_identifiers(*v, ids);
+      handle_identifiers(file, filename, ids, scope, walker, ctx);
+    }
+    else if ((v = job_param(req, "path"))) {
+      handle_path(file, filename, *v, scope, walker);
+    }
+    else {
+      walker.walk_tree(file, filename);
+      walker.walk_orphans(file, filename);
+      if (recover) {
+        handle_recovered(recinput.file.get(), scan, filename, walker, ctx);
+      }
+    }
+
+    errors.write_summary();
+    out.flush();
+    seen.flush();
   }
-  catch (const libpff_error& e) {
-    std::cerr << "Error: " << path << ": " << e.what() << std::endl;
+  catch (...) {
+    // the handle is none the worse for a failed or cancelled job
+    cache.give(key, pst);
+    throw;
   }
+
+  cache.give(key, pst);
 }
 
 int main(int argc, char** argv) {
+  // we do no C stdio, so let the standard streams buffer independently
+  std::ios_base::sync_with_stdio(false);
+
   try {
-    if (argc != 2) {
-      throw std::runtime_error("wrong number of arguments");
+    const Options opts(parse_options(argc, argv));
+
+    std::ofstream trace;
+    if (opts.trace) {
+      trace.open(opts.trace);
+      if (!trace) {
+        throw std::runtime_error(std::string("cannot open ") + opts.trace);
+      }
+
+      Trace::start(opts.trace_sample);
     }
 
+    if (opts.daemon) {
+      const unsigned int workers = opts.workers ? opts.workers :
+        std::max(std::thread::hardware_concurrency(), 1u);
+
+      Pst_cache cache(opts.cache_size);
+      Seen_set seen(opts.dedup_file);
+      serve(
+        opts.daemon, workers, opts.output_dir ? opts.output_dir : "",
+        boost::bind(&run_job, boost::cref(opts), boost::ref(cache), boost::ref(seen), _1, _2, _3)
+      );
+
+      if (opts.trace) {
+        Trace::write(trace);
+      }
+
+      return EXIT_SUCCESS;
+    }
+
+    const char* path = opts.image ? opts.image : argv[optind];
+
     // setup
-    FilePtr filep(create_file(argv[1]), &destroy_file);
-    libpff_file_t* file = filep.get();
+    MappedFilePtr mapped;
+    MappedFilePtr recmapped;
+    if (opts.mmap) {
+      mapped = map_file(path, Mapped_file::RANDOM);
+      if (opts.recover) {
+        recmapped = map_file(path, Mapped_file::SEQUENTIAL);
+      }
+    }
+
+    HandleFactory make_handle;
+    HandleFactory make_recovery_handle;
+    Extent_list extents;
+    if (opts.image) {
+      // read the PST in place, from its extents in the image
+      ImageFilePtr image(new Image_file(path));
+
+      if (opts.fragments) {
+        extents = read_extents(opts.fragments);
+      }
+      else {
+        if (opts.offset > image->size()) {
+          throw std::runtime_error("offset lies beyond the end of the image");
+        }
+
+        const Extent ext = {
+          opts.offset, opts.length ? opts.length : image->size() - opts.offset
+        };
+        extents.push_back(ext);
+      }
+
+      make_handle = boost::bind(&create_range_handle, image, mapped, extents);
+      make_recovery_handle = boost::bind(&create_range_handle, image, recmapped, extents);
+    }
+    else if (mapped) {
+      make_handle = boost::bind(&create_mapped_handle, mapped);
+      if (recmapped) {
+        make_recovery_handle = boost::bind(&create_mapped_handle, recmapped);
+      }
+    }
+    else if (opts.io_uring) {
+      // one ring and cache, shared by every handle on the file
+      make_handle = boost::bind(
+        &create_uring_handle, UringFilePtr(new Uring_file(path, opts.io_uring_depth))
+      );
+      make_recovery_handle = make_handle;
+    }
 
-    std::string filename(std::max(strchr(argv[1], '/') + 1, argv[1]));
+    Input input(open_input(path, make_handle));
+    libpff_file_t* file = input.file.get();
+
+    std::string filename(pst_name(path));
+    if (opts.image) {
+      // name the PST by where it starts in the image
+      filename += '@' + boost::lexical_cast<std::string>(extents.front().offset);
+    }
+
+    // Recovery scans the whole file, so start it now, on its own handle,
+    // and let it run while we walk the tree and the orphans.
+    Input recinput;
+    std::future<void> scan;
+    if (opts.recover) {
+      recinput = open_input(path, make_recovery_handle);
+      scan = std::async(
+        std::launch::async, &recover_items,
+        recinput.file.get(), opts.recovery_flags
+      );
+    }
 
     // process the file
     JSON_writer json(std::cout);
 
-    handle_tree(file, filename, json);
-    handle_orphans(file, filename, json);
-    handle_recovered(file, filename, json);
+    std::ofstream errfile;
+    if (opts.error_file) {
+      errfile.open(opts.error_file);
+      if (!errfile) {
+        throw std::runtime_error(std::string("cannot open ") + opts.error_file);
+      }
+    }
+    else {
+      // errors are written in bulk, not a line at a time
+      std::cerr.unsetf(std::ios_base::unitbuf);
+    }
+
+    boost::scoped_ptr<Error_log> errors(
+      opts.inline_errors ?
+        new Error_log(json, opts.error_limit) :
+        new Error_log(opts.error_file ? static_cast<std::ostream&>(errfile) : std::cerr, opts.error_limit)
+    );
+
+    Named_properties names;
+    Filetime_format times(opts.timestamps);
+    Context ctx(json, *errors, names, times);
+    ctx.name_dictionary = opts.name_dictionary;
+    ctx.semantic = opts.semantic;
+    ctx.rtf = opts.rtf;
+
+    boost::scoped_ptr<Seen_set> seen;
+    if (opts.dedup) {
+      seen.reset(new Seen_set(opts.dedup_file));
+      ctx.seen = seen.get();
+    }
+
+    boost::scoped_ptr<Arrow_export> arrow;
+    boost::scoped_ptr<Pst_visitor> visitor;
+    if (opts.arrow) {
+      std::vector<uint32_t> etypes;
+      std::vector<std::string> column_names;
+      parse_entry_types(opts.arrow_columns, etypes, column_names);
+
+      arrow.reset(new Arrow_export(opts.arrow, etypes, column_names, opts.arrow_batch_size));
+      visitor.reset(new Arrow_visitor(*arrow, ctx));
+    }
+    else {
+      visitor.reset(new Json_visitor(ctx));
+    }
+
+    boost::scoped_ptr<Index_writer> index;
+    boost::scoped_ptr<Pst_visitor> indexer;
+    if (opts.index) {
+      std::vector<uint32_t> etypes;
+      std::vector<std::string> field_names;
+      parse_entry_types(opts.index_fields ? opts.index_fields : DEFAULT_INDEX_FIELDS, etypes, field_names);
+
+      index.reset(new Index_writer(opts.index));
+      indexer.reset(new Index_visitor(*visitor, *index, etypes));
+    }
+
+    Pst_walker walker(indexer ? *indexer : *visitor);
+
+    boost::scoped_ptr<Pst_sample> sample;
+    if (opts.sample != 1) {
+      sample.reset(new Pst_sample(opts.sample, opts.sample_seed));
+      walker.set_sample(sample.get());
+    }
+
+    const Pst_walker::Scope scope = opts.subtree ? Pst_walker::SUB_ITEMS : Pst_walker::ITEM;
+
+    if (opts.inventory) {
+      handle_inventory(
+        file, recinput.file.get(), opts.recover ? &scan : 0, filename, ctx
+      );
+    }
+    else if (!opts.item_ids.empty() || !opts.paths.empty()) {
+      handle_identifiers(file, filename, opts.item_ids, scope, walker, ctx);
+      handle_paths(file, filename, opts.paths, scope, walker, ctx);
+    }
+    else if (opts.shards) {
+      const Pst_shard shard(file, filename, opts.shard, opts.shards);
+
+      shard.walk(file, walker, ctx);
+      if (opts.recover) {
+        handle_recovered(recinput.file.get(), scan, filename, walker, ctx, &shard);
+      }
+    }
+    else {
+      if (opts.locality) {
+        handle_tree_by_locality(file, filename, opts.order_window, walker, ctx);
+      }
+      else {
+        walker.walk_tree(file, filename);
+      }
+      walker.walk_orphans(file, filename);
+      if (opts.recover) {
+        handle_recovered(recinput.file.get(), scan, filename, walker, ctx);
+      }
+    }
+
+    if (opts.name_dictionary && !arrow) {
+      names.write_dictionary(json);
+    }
+
+    if (index) {
+      index->close();
+    }
+
+    if (seen) {
+      seen->flush();
+    }
+
+    if (arrow) {
+      arrow->close();
+
+      typedef std::map<std::string, unsigned long> Mismatches;
+      const Mismatches& mm(arrow->mismatches());
+      for (Mismatches::const_iterator i(mm.begin()); i != mm.end(); ++i) {
+        errors->report(
+          "arrow column type", i->first, 0,
+          boost::lexical_cast<std::string>(i->second) +
+            " values did not match the column type and were written as null"
+        );
+      }
+    }
+
+    errors->write_summary();
+    errors->flush();
+
+    if (opts.trace) {
+      Trace::write(trace);
+    }
   }
   catch (const std::exception& e) {
     std::cerr << "Error: " << e.what() << std::endl;
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "mapped_file.h"
+
+namespace {
+
+std::runtime_error sys_error(const std::string& what, const char* filename) {
+  return std::runtime_error(
+    what + ' ' + filename + ": " + std::strerror(errno)
+  );
+}
+
+}
+
+Mapped_file::Mapped_file(const char* filename): addr(0), len(0) {
+  const int fd = open(filename, O_RDONLY);
+  if (fd == -1) {
+    throw sys_error("cannot open", filename);
+  }
+
+  // fstat reports no size for block devices, so seek to the end instead
+  const off_t end = lseek(fd, 0, SEEK_END);
+  if (end == -1) {
+    const int err = errno;
+    close(fd);
+    errno = err;
+    throw sys_error("cannot size", filename);
+  }
+
+  len = end;
+
+  if (len > 0) {
+    void* a = mmap(0, len, PROT_READ, MAP_SHARED, fd, 0);
+    if (a == MAP_FAILED) {
+      const int err = errno;
+      close(fd);
+      errno = err;
+      throw sys_error("cannot map", filename);
+    }
+
+    addr = static_cast<uint8_t*>(a);
+  }
+
+  // the mapping stays valid without the descriptor
+  close(fd);
+}
+
+Mapped_file::~Mapped_file() {
+  if (addr) {
+    munmap(addr, len);
+  }
+}
+
+void Mapped_file::advise(Access access) {
+  if (addr) {
+    // only a hint, so failure doesn't matter
+    madvise(addr, len, access == SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM);
+  }
+}
+
+//
+// libbfio io handle callbacks
+//
+
+namespace {
+
+struct Mapped_io {
+  Mapped_io(const MappedFilePtr& m): mapped(m), offset(0), is_open(false) {}
+
+  MappedFilePtr mapped;
+  off64_t offset;
+  bool is_open;
+};
+
+Mapped_io* io(intptr_t* io_handle) {
+  return reinterpret_cast<Mapped_io*>(io_handle);
+}
+
+int mapped_free(intptr_t** io_handle, libbfio_error_t**) {
+  delete io(*io_handle);
+  *io_handle = 0;
+  return 1;
+}
+
+int mapped_clone(intptr_t** dst, intptr_t* src, libbfio_error_t**) {
+  *dst = reinterpret_cast<intptr_t*>(new Mapped_io(io(src)->mapped));
+  return 1;
+}
+
+int mapped_open(intptr_t* io_handle, int access_flags, libbfio_error_t**) {
+  if (access_flags & LIBBFIO_ACCESS_FLAG_WRITE) {
+    return -1;
+  }
+
+  io(io_handle)->offset = 0;
+  io(io_handle)->is_open = true;
+  return 1;
+}
+
+int mapped_close(intptr_t* io_handle, libbfio_error_t**) {
+  io(io_handle)->is_open = false;
+  return 0;
+}
+
+ssize_t mapped_read(intptr_t* io_handle, uint8_t* buf, size_t size,
+                    libbfio_error_t**)
+{
+  Mapped_io* m = io(io_handle);
+  const uint64_t end = m->mapped->size();
+
+  if (!m->is_open || m->offset < 0) {
+    return -1;
+  }
+
+  if (static_cast<uint64_t>(m->offset) >= end) {
+    return 0;
+  }
+
+  const size_t n = std::min<uint64_t>(size, end - m->offset);
+  std::memcpy(buf, m->mapped->data() + m->offset, n);
+  m->offset += n;
+  return n;
+}
+
+ssize_t mapped_write(intptr_t*, const uint8_t*, size_t, libbfio_error_t**) {
+  return -1;
+}
+
+off64_t mapped_seek(intptr_t* io_handle, off64_t offset, int whence,
+                    libbfio_error_t**)
+{
+  Mapped_io* m = io(io_handle);
+
+  switch (whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    offset += m->offset;
+    break;
+  case SEEK_END:
+    offset += m->mapped->size();
+    break;
+  default:
+    return -1;
+  }
+
+  if (offset < 0) {
+    return -1;
+  }
+
+  m->offset = offset;
+  return offset;
+}
+
+int mapped_exists(intptr_t*, libbfio_error_t**) {
+  return 1;
+}
+
+int mapped_is_open(intptr_t* io_handle, libbfio_error_t**) {
+  return io(io_handle)->is_open ? 1 : 0;
+}
+
+int mapped_get_size(intptr_t* io_handle, size64_t* size, libbfio_error_t**) {
+  *size = io(io_handle)->mapped->size();
+  return 1;
+}
+
+}
+
+libbfio_handle_t* create_mapped_handle(const MappedFilePtr& mapped) {
+  Mapped_io* m = new Mapped_io(mapped);
+
+  libbfio_handle_t* handle = 0;
+  libbfio_error_t* error = 0;
+
+  if (libbfio_handle_initialize(
+    &handle,
+    reinterpret_cast<intptr_t*>(m),
+    &mapped_free,
+    &mapped_clone,
+    &mapped_open,
+    &mapped_close,
+    &mapped_read,
+    &mapped_write,
+    &mapped_seek,
+    &mapped_exists,
+    &mapped_is_open,
+    &mapped_get_size,
+    LIBBFIO_FLAG_IO_HANDLE_MANAGED | LIBBFIO_FLAG_IO_HANDLE_CLONE_BY_FUNCTION,
+    &error) != 1)
+  {
+    libbfio_error_free(&error);
+    delete m;
+    throw std::runtime_error("cannot create libbfio handle");
+  }
+
+  return handle;
+}
+
+void destroy_bfio_handle(libbfio_handle_t* handle) {
+  libbfio_error_t* error = 0;
+
+  // this is a deleter, so it must not throw
+  if (libbfio_handle_free(&handle, &error) != 1) {
+    libbfio_error_free(&error);
+  }
+}
@@ -0,0 +1,94 @@
+#include <sstream>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_array.hpp>
+
+#include "json_writer.h"
+#include "named_properties.h"
+
+Decoded<uint32_t> Named_properties::resolve(libpff_name_to_id_map_entry_t* nkey) {
+  std::unordered_map<libpff_name_to_id_map_entry_t*, uint32_t>::const_iterator i(by_entry.find(nkey));
+  if (i != by_entry.end()) {
+    return i->second;
+  }
+
+  libpff_error_t* error = 0;
+
+  uint8_t ntype;
+  if (libpff_name_to_id_map_entry_get_type(nkey, &ntype, &error) != 1) {
+    return Decode_error(error, __LINE__);
+  }
+
+  Property prop;
+
+  if (ntype == LIBPFF_NAME_TO_ID_MAP_ENTRY_TYPE_NUMERIC) {
+    uint32_t nnum;
+    if (libpff_name_to_id_map_entry_get_number(nkey, &nnum, &error) != 1) {
+      return Decode_error(error, __LINE__);
+    }
+
+// TODO: what is this?
+    prop.key = "maps to entry type";
+    prop.value = boost::lexical_cast<std::string>(nnum);
+  }
+  else if (ntype == LIBPFF_NAME_TO_ID_MAP_ENTRY_TYPE_STRING) {
+    size_t len;
+    if (libpff_name_to_id_map_entry_get_utf8_string_size(nkey, &len, &error) != 1) {
+      return Decode_error(error, __LINE__);
+    }
+
+    boost::scoped_array<uint8_t> buf(new uint8_t[len]);
+    if (libpff_name_to_id_map_entry_get_utf8_string(nkey, buf.get(), len, &error) != 1) {
+      return Decode_error(error, __LINE__);
+    }
+
+// TODO: what is this?
+    std::ostringstream enc;
+    enc << quote((const char*) buf.get());
+
+    prop.key = "maps to entry";
+    prop.value = enc.str();
+  }
+  else {
+    return Decode_error("unknown name-to-id map entry type", __LINE__);
+  }
+
+  // the key tells numeric names from string names
+  const std::string name(prop.key + ('\0' + prop.value));
+
+  std::unordered_map<std::string, uint32_t>::const_iterator j(by_name.find(name));
+
+  uint32_t id;
+  if (j != by_name.end()) {
+    id = j->second;
+  }
+  else {
+    id = props.size();
+    props.push_back(prop);
+    by_name.insert(std::make_pair(name, id));
+  }
+
+  by_entry.insert(std::make_pair(nkey, id));
+  return id;
+}
+
+void Named_properties::write(uint32_t id, JSON_writer& json) const {
+  const Property& prop = props[id];
+  json.object_member_write_raw(prop.key, prop.value);
+}
+
+void Named_properties::write_dictionary(JSON_writer& json) const {
+  json.object_open();
+  json.array_member_open("named properties");
+
+  for (uint32_t id = 0; id < props.size(); ++id) {
+    json.object_open();
+    json.object_member_write("named property", id);
+    write(id, json);
+    json.object_close();
+  }
+
+  json.array_member_close();
+  json.object_close();
+  json.reset();
+}
@@ -0,0 +1,483 @@
+#include <boost/scoped_array.hpp>
+
+#include <libpff/mapi.h>
+
+#include "pff.h"
+#include "trace.h"
+
+libpff_file_t* create_file(const char* filename) {
+  libpff_file_t* file = 0;
+  libpff_error_t* error = 0;
+
+  if (libpff_file_initialize(&file, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  Trace_span span("libpff_file_open", "libpff");
+  if (libpff_file_open(file, filename, LIBPFF_OPEN_READ, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return file;
+}
+
+libpff_file_t* create_file(libbfio_handle_t* handle) {
+  libpff_file_t* file = 0;
+  libpff_error_t* error = 0;
+
+  if (libpff_file_initialize(&file, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  Trace_span span("libpff_file_open_file_io_handle", "libpff");
+  if (libpff_file_open_file_io_handle(file, handle, LIBPFF_OPEN_READ, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return file;
+}
+
+void destroy_file(libpff_file_t* file) {
+  libpff_error_t* error = 0;
+
+  if (libpff_file_close(file, &error) != 0) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  if (libpff_file_free(&file, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+}
+
+libpff_item_t* get_root(libpff_file_t* file) {
+  libpff_item_t* root = 0;
+  libpff_error_t* error = 0;
+
+  Trace_span span("libpff_file_get_root_item", "libpff");
+  if (libpff_file_get_root_item(file, &root, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return root;
+}
+
+libpff_item_t* get_child(libpff_item_t* parent, int pos) {
+  libpff_item_t* child = 0;
+  libpff_error_t* error = 0;
+
+  Trace_span span("libpff_item_get_sub_item", "libpff");
+  if (libpff_item_get_sub_item(parent, pos, &child, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return child;
+}
+
+libpff_item_t* get_sub_folder(libpff_item_t* folder, int pos) {
+  libpff_item_t* sub = 0;
+  libpff_error_t* error = 0;
+
+  Trace_span span("libpff_folder_get_sub_folder", "libpff");
+  if (libpff_folder_get_sub_folder(folder, pos, &sub, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return sub;
+}
+
+libpff_item_t* get_unknowns(libpff_item_t* folder) {
+  libpff_item_t* unknowns = 0;
+  libpff_error_t* error = 0;
+
+  Trace_span span("libpff_folder_get_unknowns", "libpff");
+  if (libpff_folder_get_unknowns(folder, &unknowns, &error) == -1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return unknowns;
+}
+
+libpff_item_t* get_orphan(libpff_file_t* file, int pos) {
+  libpff_item_t* orphan = 0;
+  libpff_error_t* error = 0;
+
+  Trace_span span("libpff_file_get_orphan_item", "libpff");
+  if (libpff_file_get_orphan_item(file, pos, &orphan, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return orphan;
+}
+
+libpff_item_t* get_item(libpff_file_t* file, uint32_t id) {
+  libpff_item_t* item = 0;
+  libpff_error_t* error = 0;
+
+  Trace_span span("libpff_file_get_item_by_identifier", "libpff");
+  if (libpff_file_get_item_by_identifier(file, id, &item, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return item;
+}
+
+libpff_item_t* get_recovered(libpff_file_t* file, int pos) {
+  libpff_item_t* rec = 0;
+  libpff_error_t* error = 0;
+
+  Trace_span span("libpff_file_get_recovered_item", "libpff");
+  if (libpff_file_get_recovered_item(file, pos, &rec, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+
+  return rec;
+}
+
+void destroy_item(libpff_item_t* item) {
+  libpff_error_t* error = 0;
+
+  if (libpff_item_free(&item, &error) != 1) {
+    throw libpff_error(error, __LINE__);
+  }
+}
+
+Decoded<libpff_multi_value_t*> get_multivalue(libpff_item_t* item, uint32_t s, uint32_t etype, uint8_t flags) {
+  libpff_multi_value_t* mv = 0;
+  libpff_error_t* error = 0;
+
+  if (libpff_item_get_entry_multi_value(item, s, etype, &mv, flags, &error) == -1) {
+    return Decode_error(error, __LINE__);
+  }
+
+  return mv;
+}
+
+void destroy_multivalue(libpff_multi_value_t* mv) {
+  libpff_error_t* error = 0;
+
+  // this is a deleter, so it must not throw
+  if (libpff_multi_value_free(&mv, &error) != 1) {
+    libpff_error_free(&error);
+  }
+}
+
+bool get_display_name(libpff_item_t* item, std::string& name) {
+  libpff_error_t* error = 0;
+  size_t len;
+  switch (libpff_item_get_utf8_display_name_size(item, &len, &error)) {
+  case -1:
+    throw libpff_error(error, __LINE__);
+  case  0:
+    break;
+  case  1:
+    {
+      boost::scoped_array<uint8_t> buf(new uint8_t[len]);
+      if (libpff_item_get_utf8_display_name(item, buf.get(), len, &error) != 1) {
+        throw libpff_error(error, __LINE__);
+      }
+
+      name = (const char*) buf.get();
+      return true;
+    }
+  }
+
+  return false;
+}
+
+const char* item_type_string(uint32_t itype) {
+  switch (itype) {
+  case LIBPFF_ITEM_TYPE_UNDEFINED:
+    return "UNDEFINED";
+  case LIBPFF_ITEM_TYPE_ACTIVITY:
+    return "ACTIVITY";
+  case LIBPFF_ITEM_TYPE_APPOINTMENT:
+    return "APPOINTMENT";
+  case LIBPFF_ITEM_TYPE_ATTACHMENT:
+    return "ATTACHMENT";
+  case LIBPFF_ITEM_TYPE_ATTACHMENTS:
+    return "ATTACHMENTS";
+  case LIBPFF_ITEM_TYPE_COMMON:
+    return "COMMON";
+  case LIBPFF_ITEM_TYPE_CONFIGURATION:
+    return "CONFIGURATION";
+  case LIBPFF_ITEM_TYPE_CONFLICT_MESSAGE:
+    return "CONFLICT_MESSAGE";
+  case LIBPFF_ITEM_TYPE_CONTACT:
+    return "CONTACT";
+  case LIBPFF_ITEM_TYPE_DISTRIBUTION_LIST:
+    return "DISTRIBUTION_LIST";
+  case LIBPFF_ITEM_TYPE_DOCUMENT:
+    return "DOCUMENT";
+  case LIBPFF_ITEM_TYPE_EMAIL:
+    return "EMAIL";
+  case LIBPFF_ITEM_TYPE_EMAIL_SMIME:
+    return "EMAIL_SMIME";
+  case LIBPFF_ITEM_TYPE_FAX:
+    return "FAX";
+  case LIBPFF_ITEM_TYPE_FOLDER:
+    return "FOLDER";
+  case LIBPFF_ITEM_TYPE_MEETING:
+    return "MEETING";
+  case LIBPFF_ITEM_TYPE_MMS:
+    return "MMS";
+  case LIBPFF_ITEM_TYPE_NOTE:
+    return "NOTE";
+  case LIBPFF_ITEM_TYPE_POSTING_NOTE:
+    return "POSTING_NOTE";
+  case LIBPFF_ITEM_TYPE_RECIPIENTS:
+    return "RECIPIENTS";
+  case LIBPFF_ITEM_TYPE_RSS_FEED:
+    return "RSS_FEED";
+  case LIBPFF_ITEM_TYPE_SHARING:
+    return "SHARING";
+  case LIBPFF_ITEM_TYPE_SMS:
+    return "SMS";
+  case LIBPFF_ITEM_TYPE_SUB_ASSOCIATED_CONTENTS:
+    return "SUB_ASSOCIATED_CONTENTS";
+  case LIBPFF_ITEM_TYPE_SUB_FOLDERS:
+    return "SUB_FOLDERS";
+  case LIBPFF_ITEM_TYPE_SUB_MESSAGES:
+    return "SUB_MESSAGES";
+  case LIBPFF_ITEM_TYPE_TASK:
+    return "TASK";
+  case LIBPFF_ITEM_TYPE_TASK_REQUEST:
+    return "TASK_REQUEST";
+  case LIBPFF_ITEM_TYPE_VOICEMAIL:
+    return "VOICEMAIL";
+  case LIBPFF_ITEM_TYPE_UNKNOWN:
+    return "UNKNOWN";
+  default:
+    return "UNRECOGNIZED";
+  }
+}
+
+const char* entry_type_string(uint32_t etype) {
+  switch (etype) {
+  case LIBPFF_ENTRY_TYPE_MESSAGE_IMPORTANCE:
+    return "MESSAGE_IMPORTANCE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_CLASS:
+    return "MESSAGE_CLASS";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_PRIORITY:
+    return "MESSAGE_PRIORITY";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENSITIVITY:
+    return "MESSAGE_SENSITIVITY";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SUBJECT:
+    return "MESSAGE_SUBJECT";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_CLIENT_SUBMIT_TIME:
+    return "MESSAGE_CLIENT_SUBMIT_TIME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_SEARCH_KEY:
+    return "MESSAGE_SENT_REPRESENTING_SEARCH_KEY";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_ENTRY_IDENTIFIER:
+    return "MESSAGE_RECEIVED_BY_ENTRY_IDENTIFIER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_NAME:
+    return "MESSAGE_RECEIVED_BY_NAME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_ENTRY_IDENTIFIER:
+    return "MESSAGE_SENT_REPRESENTING_ENTRY_IDENTIFIER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_NAME:
+    return "MESSAGE_SENT_REPRESENTING_NAME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_ENTRY_IDENTIFIER:
+    return "MESSAGE_RECEIVED_REPRESENTING_ENTRY_IDENTIFIER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_NAME:
+    return "MESSAGE_RECEIVED_REPRESENTING_NAME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_REPLY_RECIPIENT_ENTRIES:
+    return "MESSAGE_REPLY_RECIPIENT_ENTRIES";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_REPLY_RECIPIENT_NAMES:
+    return "MESSAGE_REPLY_RECIPIENT_NAMES";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_SEARCH_KEY:
+    return "MESSAGE_RECEIVED_BY_SEARCH_KEY";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_SEARCH_KEY:
+    return "MESSAGE_RECEIVED_REPRESENTING_SEARCH_KEY";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_ADDRESS_TYPE:
+    return "MESSAGE_SENT_REPRESENTING_ADDRESS_TYPE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_EMAIL_ADDRESS:
+    return "MESSAGE_SENT_REPRESENTING_EMAIL_ADDRESS";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_CONVERSATION_TOPIC:
+    return "MESSAGE_CONVERSATION_TOPIC";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_CONVERSATION_INDEX:
+    return "MESSAGE_CONVERSATION_INDEX";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_ADDRESS_TYPE:
+    return "MESSAGE_RECEIVED_BY_ADDRESS_TYPE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_BY_EMAIL_ADDRESS:
+    return "MESSAGE_RECEIVED_BY_EMAIL_ADDRESS";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_ADDRESS_TYPE:
+    return "MESSAGE_RECEIVED_REPRESENTING_ADDRESS_TYPE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_RECEIVED_REPRESENTING_EMAIL_ADDRESS:
+    return "MESSAGE_RECEIVED_REPRESENTING_EMAIL_ADDRESS";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_TRANSPORT_HEADERS:
+    return "MESSAGE_TRANSPORT_HEADERS";
+  case LIBPFF_ENTRY_TYPE_RECIPIENT_TYPE:
+    return "RECIPIENT_TYPE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_ENTRY_IDENTIFIER:
+    return "MESSAGE_SENDER_ENTRY_IDENTIFIER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_NAME:
+    return "MESSAGE_SENDER_NAME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_SEARCH_KEY:
+    return "MESSAGE_SENDER_SEARCH_KEY";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_ADDRESS_TYPE:
+    return "MESSAGE_SENDER_ADDRESS_TYPE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_EMAIL_ADDRESS:
+    return "MESSAGE_SENDER_EMAIL_ADDRESS";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_DISPLAY_TO:
+    return "MESSAGE_DISPLAY_TO";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_DELIVERY_TIME:
+    return "MESSAGE_DELIVERY_TIME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_FLAGS:
+    return "MESSAGE_FLAGS";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_SIZE:
+    return "MESSAGE_SIZE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_STATUS:
+    return "MESSAGE_STATUS";
+  case LIBPFF_ENTRY_TYPE_ATTACHMENT_SIZE:
+    return "ATTACHMENT_SIZE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_INTERNET_ARTICLE_NUMBER:
+    return "MESSAGE_INTERNET_ARTICLE_NUMBER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_PERMISSION:
+    return "MESSAGE_PERMISSION";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_URL_COMPUTER_NAME_SET:
+    return "MESSAGE_URL_COMPUTER_NAME_SET";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_TRUST_SENDER:
+    return "MESSAGE_TRUST_SENDER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_PLAIN_TEXT:
+    return "MESSAGE_BODY_PLAIN_TEXT";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_COMPRESSED_RTF:
+    return "MESSAGE_BODY_COMPRESSED_RTF";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_HTML:
+    return "MESSAGE_BODY_HTML";
+  case LIBPFF_ENTRY_TYPE_EMAIL_EML_FILENAME:
+    return "EMAIL_EML_FILENAME";
+  case LIBPFF_ENTRY_TYPE_DISPLAY_NAME:
+    return "DISPLAY_NAME";
+  case LIBPFF_ENTRY_TYPE_ADDRESS_TYPE:
+    return "ADDRESS_TYPE";
+  case LIBPFF_ENTRY_TYPE_EMAIL_ADDRESS:
+    return "EMAIL_ADDRESS";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_CREATION_TIME:
+    return "MESSAGE_CREATION_TIME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_MODIFICATION_TIME:
+    return "MESSAGE_MODIFICATION_TIME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_STORE_VALID_FOLDER_MASK:
+    return "MESSAGE_STORE_VALID_FOLDER_MASK";
+  case LIBPFF_ENTRY_TYPE_FOLDER_TYPE:
+    return "FOLDER_TYPE";
+  case LIBPFF_ENTRY_TYPE_NUMBER_OF_CONTENT_ITEMS:
+    return "NUMBER_OF_CONTENT_ITEMS";
+  case LIBPFF_ENTRY_TYPE_NUMBER_OF_UNREAD_CONTENT_ITEMS:
+    return "NUMBER_OF_UNREAD_CONTENT_ITEMS";
+  case LIBPFF_ENTRY_TYPE_HAS_SUB_FOLDERS:
+    return "HAS_SUB_FOLDERS";
+  case LIBPFF_ENTRY_TYPE_CONTAINER_CLASS:
+    return "CONTAINER_CLASS";
+  case LIBPFF_ENTRY_TYPE_NUMBER_OF_ASSOCIATED_CONTENT:
+    return "NUMBER_OF_ASSOCIATED_CONTENT";
+  case LIBPFF_ENTRY_TYPE_ATTACHMENT_DATA_OBJECT:
+    return "ATTACHMENT_DATA_OBJECT";
+  case LIBPFF_ENTRY_TYPE_ATTACHMENT_FILENAME_SHORT:
+    return "ATTACHMENT_FILENAME_SHORT";
+  case LIBPFF_ENTRY_TYPE_ATTACHMENT_METHOD:
+    return "ATTACHMENT_METHOD";
+  case LIBPFF_ENTRY_TYPE_ATTACHMENT_FILENAME_LONG:
+    return "ATTACHMENT_FILENAME_LONG";
+  case LIBPFF_ENTRY_TYPE_ATTACHMENT_RENDERING_POSITION:
+    return "ATTACHMENT_RENDERING_POSITION";
+  case LIBPFF_ENTRY_TYPE_CONTACT_CALLBACK_PHONE_NUMBER:
+    return "CONTACT_CALLBACK_PHONE_NUMBER";
+  case LIBPFF_ENTRY_TYPE_CONTACT_GENERATIONAL_ABBREVIATION:
+    return "CONTACT_GENERATIONAL_ABBREVIATION";
+  case LIBPFF_ENTRY_TYPE_CONTACT_GIVEN_NAME:
+    return "CONTACT_GIVEN_NAME";
+  case LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_PHONE_NUMBER_1:
+    return "CONTACT_BUSINESS_PHONE_NUMBER_1";
+  case LIBPFF_ENTRY_TYPE_CONTACT_HOME_PHONE_NUMBER:
+    return "CONTACT_HOME_PHONE_NUMBER";
+  case LIBPFF_ENTRY_TYPE_CONTACT_INITIALS:
+    return "CONTACT_INITIALS";
+  case LIBPFF_ENTRY_TYPE_CONTACT_SURNAME:
+    return "CONTACT_SURNAME";
+  case LIBPFF_ENTRY_TYPE_CONTACT_POSTAL_ADDRESS:
+    return "CONTACT_POSTAL_ADDRESS";
+  case LIBPFF_ENTRY_TYPE_CONTACT_COMPANY_NAME:
+    return "CONTACT_COMPANY_NAME";
+  case LIBPFF_ENTRY_TYPE_CONTACT_JOB_TITLE:
+    return "CONTACT_JOB_TITLE";
+  case LIBPFF_ENTRY_TYPE_CONTACT_DEPARTMENT_NAME:
+    return "CONTACT_DEPARTMENT_NAME";
+  case LIBPFF_ENTRY_TYPE_CONTACT_OFFICE_LOCATION:
+    return "CONTACT_OFFICE_LOCATION";
+  case LIBPFF_ENTRY_TYPE_CONTACT_PRIMARY_PHONE_NUMBER:
+    return "CONTACT_PRIMARY_PHONE_NUMBER";
+  case LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_PHONE_NUMBER_2:
+    return "CONTACT_BUSINESS_PHONE_NUMBER_2";
+  case LIBPFF_ENTRY_TYPE_CONTACT_MOBILE_PHONE_NUMBER:
+    return "CONTACT_MOBILE_PHONE_NUMBER";
+  case LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_FAX_NUMBER:
+    return "CONTACT_BUSINESS_FAX_NUMBER";
+  case LIBPFF_ENTRY_TYPE_CONTACT_COUNTRY:
+    return "CONTACT_COUNTRY";
+  case LIBPFF_ENTRY_TYPE_CONTACT_LOCALITY:
+    return "CONTACT_LOCALITY";
+  case LIBPFF_ENTRY_TYPE_CONTACT_TITLE:
+    return "CONTACT_TITLE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_BODY_CODEPAGE:
+    return "MESSAGE_BODY_CODEPAGE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_CODEPAGE:
+    return "MESSAGE_CODEPAGE";
+  case LIBPFF_ENTRY_TYPE_RECIPIENT_DISPLAY_NAME:
+    return "RECIPIENT_DISPLAY_NAME";
+  case LIBPFF_ENTRY_TYPE_FOLDER_CHILD_COUNT:
+    return "FOLDER_CHILD_COUNT";
+  case LIBPFF_ENTRY_TYPE_SUB_ITEM_IDENTIFIER:
+    return "SUB_ITEM_IDENTIFIER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_STORE_PASSWORD_CHECKSUM:
+    return "MESSAGE_STORE_PASSWORD_CHECKSUM";
+  case LIBPFF_ENTRY_TYPE_ADDRESS_FILE_UNDER:
+    return "ADDRESS_FILE_UNDER";
+  case LIBPFF_ENTRY_TYPE_TASK_STATUS:
+    return "TASK_STATUS";
+  case LIBPFF_ENTRY_TYPE_TASK_PERCENTAGE_COMPLETE:
+    return "TASK_PERCENTAGE_COMPLETE";
+  case LIBPFF_ENTRY_TYPE_TASK_START_DATE:
+    return "TASK_START_DATE";
+  case LIBPFF_ENTRY_TYPE_TASK_DUE_DATE:
+    return "TASK_DUE_DATE";
+  case LIBPFF_ENTRY_TYPE_TASK_ACTUAL_EFFORT:
+    return "TASK_ACTUAL_EFFORT";
+  case LIBPFF_ENTRY_TYPE_TASK_TOTAL_EFFORT:
+    return "TASK_TOTAL_EFFORT";
+  case LIBPFF_ENTRY_TYPE_TASK_VERSION:
+    return "TASK_VERSION";
+  case LIBPFF_ENTRY_TYPE_TASK_IS_COMPLETE:
+    return "TASK_IS_COMPLETE";
+  case LIBPFF_ENTRY_TYPE_TASK_IS_RECURRING:
+    return "TASK_IS_RECURRING";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_BUSY_STATUS:
+    return "APPOINTMENT_BUSY_STATUS";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_LOCATION:
+    return "APPOINTMENT_LOCATION";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_START_TIME:
+    return "APPOINTMENT_START_TIME";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_END_TIME:
+    return "APPOINTMENT_END_TIME";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_DURATION:
+    return "APPOINTMENT_DURATION";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_IS_RECURRING:
+    return "APPOINTMENT_IS_RECURRING";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_RECURRENCE_PATTERN:
+    return "APPOINTMENT_RECURRENCE_PATTERN";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_TIMEZONE_DESCRIPTION:
+    return "APPOINTMENT_TIMEZONE_DESCRIPTION";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_FIRST_EFFECTIVE_TIME:
+    return "APPOINTMENT_FIRST_EFFECTIVE_TIME";
+  case LIBPFF_ENTRY_TYPE_APPOINTMENT_LAST_EFFECTIVE_TIME:
+    return "APPOINTMENT_LAST_EFFECTIVE_TIME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_REMINDER_TIME:
+    return "MESSAGE_REMINDER_TIME";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_IS_REMINDER:
+    return "MESSAGE_IS_REMINDER";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_IS_PRIVATE:
+    return "MESSAGE_IS_PRIVATE";
+  case LIBPFF_ENTRY_TYPE_MESSAGE_REMINDER_SIGNAL_TIME:
+    return "MESSAGE_REMINDER_SIGNAL_TIME";
+  default:
+    return "UNRECOGNIZED";
+  }
+}
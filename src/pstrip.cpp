@@ -0,0 +1,720 @@
+#include <cmath>
+#include <cstring>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "pff.h"
+#include "pstrip.h"
+#include "trace.h"
+#include "utf16.h"
+
+uint32_t Pst_error::line() const {
+  return derr ? derr->line() : lerr->line();
+}
+
+std::string Pst_error::message() const {
+  return derr ? derr->message() : lerr->message();
+}
+
+namespace {
+  // Reads a variable-length value into buf, followed by a NUL; returns
+  // as libpff getters do.
+  template <typename L, typename G> int read_bytes(
+    L length_getter,
+    G value_getter,
+    libpff_item_t* item,
+    uint32_t si,
+    uint32_t etype,
+    std::vector<uint8_t>& buf,
+    Pst_value& v,
+    libpff_error_t** error)
+  {
+    size_t len;
+    const int ret = length_getter(item, si, etype, &len, 0, error);
+    if (ret != 1) {
+      return ret;
+    }
+
+    buf.resize(len + 1);
+    if (value_getter(item, si, etype, buf.data(), len, 0, error) != 1) {
+      return -1;
+    }
+    buf[len] = 0;
+
+    v.data = buf.data();
+    v.size = len;
+    return 1;
+  }
+
+  template <typename L, typename G> int read_bytes_element(
+    L length_getter,
+    G value_getter,
+    libpff_multi_value_t* mv,
+    int i,
+    std::vector<uint8_t>& buf,
+    Pst_value& v,
+    libpff_error_t** error)
+  {
+    size_t len;
+    const int ret = length_getter(mv, i, &len, error);
+    if (ret != 1) {
+      return ret;
+    }
+
+    buf.resize(len + 1);
+    if (value_getter(mv, i, buf.data(), len, error) != 1) {
+      return -1;
+    }
+    buf[len] = 0;
+
+    v.data = buf.data();
+    v.size = len;
+    return 1;
+  }
+
+  // strings come with a terminating NUL
+  void strip_nul(Pst_value& v) {
+    if (v.size > 0) {
+      --v.size;
+    }
+  }
+
+  uint16_t get_le16(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+  }
+
+  uint32_t get_le32(const uint8_t* p) {
+    return get_le16(p) | (uint32_t) get_le16(p + 2) << 16;
+  }
+
+  uint64_t get_le64(const uint8_t* p) {
+    return get_le32(p) | (uint64_t) get_le32(p + 4) << 32;
+  }
+
+  const size_t VARIABLE = (size_t) -1;
+
+  // The size of the elements of a multi-value type, VARIABLE for those
+  // stored with a table of offsets, or 0 for unknown types.
+  size_t element_width(uint32_t value_type) {
+    switch (value_type) {
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_16BIT_SIGNED:
+      return 2;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_32BIT_SIGNED:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_FLOAT_32BIT:
+      return 4;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_DOUBLE_64BIT:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_CURRENCY:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_APPLICATION_TIME:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_64BIT_SIGNED:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_FILETIME:
+      return 8;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_GUID:
+      return 16;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_ASCII:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_UNICODE:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_BINARY_DATA:
+      return VARIABLE;
+    default:
+      return 0;
+    }
+  }
+
+  // Decodes the element at p of a multi-value type of fixed width.
+  void read_fixed_element(uint32_t value_type, const uint8_t* p, Pst_value& v) {
+    switch (value_type) {
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_16BIT_SIGNED:
+      v.kind = Pst_value::INT16;
+      v.integer = (int16_t) get_le16(p);
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_32BIT_SIGNED:
+      v.kind = Pst_value::INT32;
+      v.integer = (int32_t) get_le32(p);
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_FLOAT_32BIT:
+      {
+        const uint32_t bits = get_le32(p);
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        v.kind = Pst_value::FLOAT;
+        v.real = f;
+      }
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_DOUBLE_64BIT:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_APPLICATION_TIME:
+      {
+        const uint64_t bits = get_le64(p);
+        std::memcpy(&v.real, &bits, sizeof(v.real));
+        v.kind = Pst_value::DOUBLE;
+      }
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_CURRENCY:
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_INTEGER_64BIT_SIGNED:
+      v.kind = Pst_value::INT64;
+      v.integer = (int64_t) get_le64(p);
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_FILETIME:
+      v.kind = Pst_value::FILETIME;
+      v.filetime = get_le64(p);
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_GUID:
+      v.kind = Pst_value::GUID;
+      v.data = p;
+      v.size = 16;
+      break;
+    }
+  }
+
+  // splitmix64's finalizer
+  uint64_t mix(uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 27;
+    h *= 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    return h;
+  }
+}
+
+Pst_sample::Pst_sample(double rate, uint64_t seed):
+  key(mix(seed + 0x9E3779B97F4A7C15ULL)),
+  threshold(rate < 1 ? (uint64_t) std::ldexp(rate, 64) : 0),
+  all(rate >= 1) {}
+
+bool Pst_sample::picks(uint32_t identifier) const {
+  return all || mix(key ^ identifier) < threshold;
+}
+
+bool Pst_walker::sampled(libpff_item_t* item) const {
+  if (!sample) {
+    return true;
+  }
+
+  try {
+    const uint8_t type = get_attrib<uint8_t>(
+      boost::bind(&libpff_item_get_type, item, _1, _2)
+    );
+
+    if (type == LIBPFF_ITEM_TYPE_FOLDER) {
+      return true;
+    }
+
+    return sample->picks(get_attrib<uint32_t>(
+      boost::bind(&libpff_item_get_identifier, item, _1, _2)
+    ));
+  }
+  catch (const libpff_error&) {
+    return true;
+  }
+}
+
+std::string display_path(libpff_item_t* item, const std::string& path, const std::string& dpath, uint32_t i, Pst_visitor* visitor) {
+  try {
+    std::string name;
+    if (get_display_name(item, name)) {
+      return dpath + '/' + name;
+    }
+  }
+  catch (const libpff_error& e) {
+    if (visitor) {
+      visitor->error(Pst_error("display name", path, e));
+    }
+  }
+
+  return dpath + '/' + boost::lexical_cast<std::string>(i);
+}
+
+void Pst_walker::walk_tree(libpff_file_t* file, const std::string& name) {
+  ItemPtr rootp(get_root(file), &destroy_item);
+  walk_children(rootp.get(), '/' + name, '/' + name, 0, ALL, true);
+}
+
+void Pst_walker::walk_orphans(libpff_file_t* file, const std::string& name, int begin, int end) {
+  const std::string path('/' + name + "/orphans");
+
+  walk_items(
+    boost::bind(&libpff_file_get_number_of_orphan_items, file, _1, _2),
+    boost::bind(&get_orphan, file, _1),
+    path,
+    path,
+    begin,
+    end,
+    true
+  );
+}
+
+void Pst_walker::walk_recovered(libpff_file_t* file, const std::string& name, int begin, int end) {
+  const std::string path('/' + name + "/recovered");
+
+  walk_items(
+    boost::bind(&libpff_file_get_number_of_recovered_items, file, _1, _2),
+    boost::bind(&get_recovered, file, _1),
+    path,
+    path,
+    begin,
+    end,
+    true
+  );
+}
+
+void Pst_walker::walk_item(libpff_item_t* item, const std::string& path, const std::string& dpath, Scope scope) {
+  Trace_item_span span;
+
+  Pst_item it(item, path, dpath);
+
+  try {
+    it.type = get_attrib<uint8_t>(
+      boost::bind(&libpff_item_get_type, item, _1, _2)
+    );
+    it.type_known = true;
+  }
+  catch (const libpff_error& e) {
+    visitor.error(Pst_error("item type", path, e));
+  }
+
+  try {
+    it.identifier = get_attrib<uint32_t>(
+      boost::bind(&libpff_item_get_identifier, item, _1, _2)
+    );
+    it.identifier_known = true;
+    span.arg("identifier", it.identifier);
+  }
+  catch (const libpff_error& e) {
+    visitor.error(Pst_error("identifier", path, e));
+  }
+
+  const int wanted = visitor.item_begin(it);
+
+  if (wanted & Pst_visitor::VALUES) {
+    try {
+      walk_values(it);
+    }
+    catch (const libpff_error& e) {
+      visitor.error(Pst_error("item values", path, e));
+    }
+
+    visitor.values_end(it);
+  }
+
+  if (scope == SUB_ITEMS && (wanted & Pst_visitor::SUB_ITEMS)) {
+    walk_children(item, path, dpath, 0, ALL, it.type_known && it.type == LIBPFF_ITEM_TYPE_FOLDER);
+  }
+
+  if (scope != ITEM && it.type == LIBPFF_ITEM_TYPE_FOLDER) {
+    walk_unknowns(item, path, dpath);
+  }
+
+  visitor.item_end(it);
+}
+
+void Pst_walker::walk_sub_items(libpff_item_t* item, const std::string& path, const std::string& dpath, int begin, int end) {
+  // if the type can't be read, everything is walked
+  bool folder = false;
+  try {
+    folder = get_attrib<uint8_t>(
+      boost::bind(&libpff_item_get_type, item, _1, _2)
+    ) == LIBPFF_ITEM_TYPE_FOLDER;
+  }
+  catch (const libpff_error&) {
+  }
+
+  walk_children(item, path, dpath, begin, end, folder);
+}
+
+void Pst_walker::walk_children(libpff_item_t* item, const std::string& path, const std::string& dpath, int begin, int end, bool sampling) {
+  walk_items(
+    boost::bind(&libpff_item_get_number_of_sub_items, item, _1, _2),
+    boost::bind(&get_child, item, _1),
+    path,
+    dpath,
+    begin,
+    end,
+    sampling
+  );
+}
+
+template <typename C, typename G> void Pst_walker::walk_items(C item_count_getter, G item_getter, const std::string& path, const std::string& dpath, int begin, int end, bool sampling) {
+  try {
+    int num = get_attrib<int>(item_count_getter);
+    if (end >= 0 && end < num) {
+      num = end;
+    }
+
+    for (int i = begin; i < num; ++i) {
+      if (cancel && *cancel) {
+        throw Cancelled();
+      }
+
+      const std::string cpath(path + '/' + boost::lexical_cast<std::string>(i));
+      try {
+        ItemPtr itemp(item_getter(i), &destroy_item);
+        if (sampling && !sampled(itemp.get())) {
+          continue;
+        }
+
+        walk_item(itemp.get(), cpath, display_path(itemp.get(), cpath, dpath, i));
+      }
+      catch (const libpff_error& e) {
+        visitor.error(Pst_error("item", cpath, e));
+      }
+    }
+  }
+  catch (const libpff_error& e) {
+    visitor.error(Pst_error("item count", path, e));
+  }
+}
+
+void Pst_walker::walk_unknowns(libpff_item_t* folder, const std::string& path, const std::string& dpath) {
+  // TODO: These are known unknowns, in the Rumsfeldian sense.
+  // I.e., we know that we have no idea wtf these are.
+  try {
+    ItemPtr unknownsp(get_unknowns(folder), &destroy_item);
+    if (unknownsp) {
+      walk_item(unknownsp.get(), path + "/unknowns", dpath + "/unknowns");
+    }
+  }
+  catch (const libpff_error& e) {
+    visitor.error(Pst_error("unknowns", path, e));
+  }
+}
+
+void Pst_walker::walk_values(const Pst_item& item) {
+  const uint32_t sets = get_attrib<uint32_t>(
+    boost::bind(&libpff_item_get_number_of_sets, item.handle, _1, _2)
+  );
+
+  const uint32_t entries = get_attrib<uint32_t>(
+    boost::bind(&libpff_item_get_number_of_entries, item.handle, _1, _2)
+  );
+
+  visitor.values_begin(item, sets, entries);
+
+  for (uint32_t s = 0; s < sets; ++s) {
+    visitor.set_begin(item, s);
+
+    for (uint32_t e = 0; e < entries; ++e) {
+      visitor.entry_begin(item, s, e);
+
+      Decode_error err(walk_entry(item, s, e));
+      if (err.failed()) {
+        visitor.error(Pst_error("entry", item.path, err, s, e));
+      }
+
+      visitor.entry_end(item, s, e);
+    }
+
+    visitor.set_end(item, s);
+  }
+}
+
+Decode_error Pst_walker::walk_entry(const Pst_item& item, uint32_t s, uint32_t e) {
+  libpff_error_t* error = 0;
+
+  Pst_entry entry = { s, e, 0, 0, LIBPFF_VALUE_TYPE_UNSPECIFIED, 0 };
+
+  if (libpff_item_get_entry_type(
+    item.handle, s, e, &entry.entry_type, &entry.value_type, &entry.name, &error) != 1)
+  {
+    return Decode_error(error, __LINE__);
+  }
+
+  uint8_t* vdata = 0;
+  size_t len;
+
+  Trace_span lookup("libpff_item_get_entry_value", "libpff");
+  if (libpff_item_get_entry_value(
+    item.handle, s, entry.entry_type, &entry.matched_value_type, &vdata, &len,
+    LIBPFF_ENTRY_VALUE_FLAG_MATCH_ANY_VALUE_TYPE |
+    LIBPFF_ENTRY_VALUE_FLAG_IGNORE_NAME_TO_ID_MAP, &error) != 1)
+  {
+    lookup.end();
+
+    // the type is known, even if the value can't be found
+    entry.matched_value_type = entry.value_type;
+    visitor.entry_type(item, entry);
+    return Decode_error(error, __LINE__);
+  }
+
+  lookup.end();
+
+  if (!visitor.entry_type(item, entry)) {
+    return Decode_error();
+  }
+
+  Decode_error verr(
+    entry.value_type & LIBPFF_VALUE_TYPE_MULTI_VALUE_FLAG ?
+      walk_multi_value(item, entry, vdata, len) :
+      walk_single_value(
+        item, entry,
+        entry.matched_value_type == entry.value_type ? vdata : 0, len
+      )
+  );
+
+  if (verr.failed()) {
+    visitor.error(Pst_error("value", item.path, verr, s, e));
+  }
+
+  return Decode_error();
+}
+
+Decode_error Pst_walker::walk_single_value(const Pst_item& item, const Pst_entry& entry, const uint8_t* raw, size_t raw_size) {
+  Trace_span span("value", "decode", "entry type", entry.entry_type);
+
+  libpff_error_t* error = 0;
+  libpff_item_t* it = item.handle;
+  const uint32_t si = entry.set;
+  const uint32_t etype = entry.entry_type;
+
+  Pst_value v;
+  int ret;
+
+  switch (entry.value_type) {
+  case LIBPFF_VALUE_TYPE_NULL:
+    v.kind = Pst_value::NIL;
+    ret = 1;
+    break;
+  case LIBPFF_VALUE_TYPE_INTEGER_16BIT_SIGNED:
+    {
+      uint16_t val;
+      ret = libpff_item_get_entry_value_16bit(it, si, etype, &val, 0, &error);
+      v.kind = Pst_value::INT16;
+      v.integer = (int16_t) val;
+    }
+    break;
+  case LIBPFF_VALUE_TYPE_INTEGER_32BIT_SIGNED:
+    {
+      uint32_t val;
+      ret = libpff_item_get_entry_value_32bit(it, si, etype, &val, 0, &error);
+      v.kind = Pst_value::INT32;
+      v.integer = (int32_t) val;
+    }
+    break;
+  case LIBPFF_VALUE_TYPE_FLOAT_32BIT:
+  case LIBPFF_VALUE_TYPE_DOUBLE_64BIT:
+    ret = libpff_item_get_entry_value_floating_point(it, si, etype, &v.real, 0, &error);
+    v.kind = entry.value_type == LIBPFF_VALUE_TYPE_FLOAT_32BIT ?
+      Pst_value::FLOAT : Pst_value::DOUBLE;
+    break;
+  case LIBPFF_VALUE_TYPE_BOOLEAN:
+    {
+      uint8_t val;
+      ret = libpff_item_get_entry_value_boolean(it, si, etype, &val, 0, &error);
+      v.kind = Pst_value::BOOLEAN;
+      v.integer = (bool) val;
+    }
+    break;
+  case LIBPFF_VALUE_TYPE_INTEGER_64BIT_SIGNED:
+    {
+      uint64_t val;
+      ret = libpff_item_get_entry_value_64bit(it, si, etype, &val, 0, &error);
+      v.kind = Pst_value::INT64;
+      v.integer = (int64_t) val;
+    }
+    break;
+  case LIBPFF_VALUE_TYPE_STRING_ASCII:
+  case LIBPFF_VALUE_TYPE_STRING_UNICODE:
+    ret = read_string(item, entry, raw, raw_size, v, &error);
+    v.kind = Pst_value::STRING;
+    break;
+  case LIBPFF_VALUE_TYPE_FILETIME:
+    ret = libpff_item_get_entry_value_filetime(it, si, etype, &v.filetime, 0, &error);
+    v.kind = Pst_value::FILETIME;
+    break;
+  case LIBPFF_VALUE_TYPE_GUID:
+    ret = read_bytes(
+      &libpff_item_get_entry_value_size,
+      &libpff_item_get_entry_value_guid,
+      it, si, etype, buf, v, &error
+    );
+    v.kind = Pst_value::GUID;
+    break;
+  case LIBPFF_VALUE_TYPE_BINARY_DATA:
+    ret = read_bytes(
+      &libpff_item_get_entry_value_binary_data_size,
+      &libpff_item_get_entry_value_binary_data,
+      it, si, etype, buf, v, &error
+    );
+    v.kind = Pst_value::BINARY;
+    break;
+  default:
+    return Decode_error(UNSUPPORTED, __LINE__);
+  }
+
+  if (ret == -1) {
+    return Decode_error(error, __LINE__);
+  }
+
+  if (ret == 1) {
+    visitor.value(item, entry, v);
+  }
+
+  return Decode_error();
+}
+
+int Pst_walker::read_string(const Pst_item& item, const Pst_entry& entry, const uint8_t* raw, size_t raw_size, Pst_value& v, libpff_error_t** error) {
+  // like libpff, take Unicode strings without zero bytes for codepage ones
+  if (raw && entry.value_type == LIBPFF_VALUE_TYPE_STRING_UNICODE && std::memchr(raw, 0, raw_size)) {
+    if (visitor.utf16_strings()) {
+      v.data = raw;
+      v.size = raw_size;
+      v.utf16 = true;
+      return 1;
+    }
+
+    buf.clear();
+    v.size = utf16le_to_utf8(raw, raw_size, buf);
+    buf.push_back(0);
+    v.data = buf.data();
+    return 1;
+  }
+
+  if (raw && is_ascii(raw, raw_size)) {
+    // ASCII reads the same in every codepage, and in UTF-8
+    const uint8_t* nul = (const uint8_t*) std::memchr(raw, 0, raw_size);
+    buf.assign(raw, nul ? nul : raw + raw_size);
+    v.size = buf.size();
+    buf.push_back(0);
+    v.data = buf.data();
+    return 1;
+  }
+
+  // libpff knows the codepage
+  const int ret = read_bytes(
+    &libpff_item_get_entry_value_utf8_string_size,
+    &libpff_item_get_entry_value_utf8_string,
+    item.handle, entry.set, entry.entry_type, buf, v, error
+  );
+  strip_nul(v);
+  return ret;
+}
+
+Decode_error Pst_walker::walk_multi_value(const Pst_item& item, const Pst_entry& entry, const uint8_t* raw, size_t raw_size) {
+  Trace_span span("multi value", "decode", "entry type", entry.entry_type);
+
+  if (entry.matched_value_type != entry.value_type) {
+    return Decode_error("multi-value entry stored as another value type", __LINE__);
+  }
+
+  const size_t width = element_width(entry.value_type);
+  if (width == 0) {
+    return Decode_error(UNSUPPORTED, __LINE__);
+  }
+
+  if (width != VARIABLE) {
+    // a plain array of elements
+    if (raw_size % width) {
+      return Decode_error("multi-value size not a multiple of its element size", __LINE__);
+    }
+
+    const size_t count = raw_size / width;
+    visitor.multi_value_begin(item, entry, count);
+
+    for (size_t i = 0; i < count; ++i) {
+      Pst_value v;
+      read_fixed_element(entry.value_type, raw + i * width, v);
+      visitor.element(item, entry, i, v);
+    }
+
+    visitor.multi_value_end(item, entry);
+    return Decode_error();
+  }
+
+  // a count, a table of offsets from the start, and the elements, each
+  // running up to the next one
+  if (raw_size < 4) {
+    return Decode_error("multi-value too short for its count", __LINE__);
+  }
+
+  const uint32_t count = get_le32(raw);
+  if (count > (raw_size - 4) / 4) {
+    return Decode_error("multi-value offset table runs past its end", __LINE__);
+  }
+
+  visitor.multi_value_begin(item, entry, count);
+
+  // for codepage strings, which only libpff can convert
+  MultiValuePtr mvp;
+
+  for (uint32_t i = 0; i < count; ++i) {
+    const uint32_t b = get_le32(raw + 4 + 4 * i);
+    const uint32_t e = i + 1 < count ? get_le32(raw + 8 + 4 * i) : raw_size;
+
+    if (b > e || e > raw_size) {
+      visitor.error(
+        Pst_error("multi-value", item.path, Decode_error("multi-value element offset out of range", __LINE__), entry.set, entry.entry, i)
+      );
+      continue;
+    }
+
+    Pst_value v;
+    libpff_error_t* error = 0;
+    int ret = 1;
+
+    switch (entry.value_type) {
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_UNICODE:
+      v.kind = Pst_value::STRING;
+      if (visitor.utf16_strings()) {
+        v.data = raw + b;
+        v.size = e - b;
+        v.utf16 = true;
+      }
+      else {
+        buf.clear();
+        v.size = utf16le_to_utf8(raw + b, e - b, buf);
+        buf.push_back(0);
+        v.data = buf.data();
+      }
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_STRING_ASCII:
+      v.kind = Pst_value::STRING;
+      if (is_ascii(raw + b, e - b)) {
+        const uint8_t* nul = (const uint8_t*) std::memchr(raw + b, 0, e - b);
+        buf.assign(raw + b, nul ? nul : raw + e);
+        v.size = buf.size();
+        buf.push_back(0);
+        v.data = buf.data();
+        break;
+      }
+
+      if (!mvp) {
+        Decoded<libpff_multi_value_t*> dmv(
+          get_multivalue(
+            item.handle, entry.set, entry.entry_type,
+            LIBPFF_ENTRY_VALUE_FLAG_IGNORE_NAME_TO_ID_MAP
+          )
+        );
+        if (!dmv.ok()) {
+          visitor.error(Pst_error("multi-value", item.path, std::move(dmv.error()), entry.set, entry.entry, i));
+          continue;
+        }
+        mvp.reset(dmv.value(), &destroy_multivalue);
+      }
+
+      ret = read_bytes_element(
+        &libpff_multi_value_get_value_utf8_string_size,
+        &libpff_multi_value_get_value_utf8_string,
+        mvp.get(), i, buf, v, &error
+      );
+      strip_nul(v);
+      break;
+    case LIBPFF_VALUE_TYPE_MULTI_VALUE_BINARY_DATA:
+      v.kind = Pst_value::BINARY;
+      v.data = raw + b;
+      v.size = e - b;
+      break;
+    }
+
+    if (ret == -1) {
+      visitor.error(
+        Pst_error("multi-value", item.path, Decode_error(error, __LINE__), entry.set, entry.entry, i)
+      );
+    }
+    else if (ret == 1) {
+      visitor.element(item, entry, i, v);
+    }
+  }
+
+  visitor.multi_value_end(item, entry);
+
+  return Decode_error();
+}
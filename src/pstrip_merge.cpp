@@ -0,0 +1,406 @@
+#include <cctype>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+//
+// Merges the outputs of pstrip --shard, one for each share, into the
+// output of a whole run: the records of every input, in the order of
+// their paths, then those without a path, in the order of the inputs,
+// and then one error summary, of the counts of them all. Records are
+// those pstrip writes, either over lines from a { to a }, or on a line
+// each, as with --errors. Each share keeps to the limit of errors per
+// category on its own, so together they may report more.
+//
+// Inline error records may also move. Going by path, they follow the
+// record of the item they are about. A whole run writes the errors
+// raised while walking an item's sub-items after those sub-items'
+// records. A share which walks the item without its sub-items writes
+// them right after the item's record, so no merge could put them back.
+//
+
+namespace {
+  void usage(std::ostream& out, const char* argv0) {
+    out << "Usage: " << argv0 << " FILE...\n"
+           "\n"
+           "Merge the outputs of pstrip --shard=I/N, for every I, into the\n"
+           "output of one pstrip run over all the items.\n";
+  }
+
+  struct Record {
+    std::string text;
+    std::string path;
+    bool has_path;
+  };
+
+  // the path of a record, as written, escapes and all
+  bool find_path(const std::string& text, const std::string& key, std::string& path) {
+    const std::string::size_type begin = text.find(key);
+    if (begin == std::string::npos) {
+      return false;
+    }
+
+    std::string::size_type i = begin + key.size();
+    for (; i < text.size() && text[i] != '"'; ++i) {
+      if (text[i] == '\\') {
+        ++i;
+      }
+    }
+
+    path.assign(text, begin + key.size(), i - begin - key.size());
+    return true;
+  }
+
+  class Input {
+  public:
+    Input(const std::string& name): in(name.c_str()), filename(name) {
+      if (!in) {
+        throw std::runtime_error("cannot open " + filename);
+      }
+    }
+
+    // Reads the next record, returning false at the end.
+    bool next(Record& rec) {
+      std::string line;
+      while (std::getline(in, line) && line.empty()) {
+      }
+
+      if (!in) {
+        if (!in.eof()) {
+          throw std::runtime_error("cannot read " + filename);
+        }
+        return false;
+      }
+
+      rec.text = line;
+      rec.text += '\n';
+
+      if (line == "{") {
+        // only a member of the record itself is indented by one
+        while (line != "}") {
+          if (!std::getline(in, line)) {
+            throw std::runtime_error("unterminated record in " + filename);
+          }
+          rec.text += line;
+          rec.text += '\n';
+        }
+
+        rec.has_path = find_path(rec.text, "\n \"path\" : \"", rec.path);
+      }
+      else {
+        rec.has_path = find_path(rec.text, "{\"path\":\"", rec.path) ||
+                       find_path(rec.text, ",\"path\":\"", rec.path);
+      }
+
+      return true;
+    }
+
+  private:
+    std::ifstream in;
+    std::string filename;
+  };
+
+  // The counts of error summaries, added up.
+  class Summary {
+  public:
+    Summary(): seen(false), pretty(false) {}
+
+    // Adds the counts of rec, returning false if it isn't a summary.
+    bool add(const std::string& rec) {
+      // the record without the space between its tokens
+      std::string s;
+      bool quoted = false;
+      for (std::string::size_type i = 0; i < rec.size(); ++i) {
+        if (quoted || !isspace((unsigned char) rec[i])) {
+          s += rec[i];
+        }
+
+        if (rec[i] == '\\' && quoted) {
+          s += rec[++i];
+        }
+        else if (rec[i] == '"') {
+          quoted = !quoted;
+        }
+      }
+
+      const std::string head("{\"error summary\":{");
+      if (s.compare(0, head.size(), head) != 0) {
+        return false;
+      }
+
+      std::string::size_type i = head.size();
+      while (s.compare(i, 1, "\"") == 0) {
+        std::string::size_type end = i + 1;
+        for (; end < s.size() && s[end] != '"'; ++end) {
+          if (s[end] == '\\') {
+            ++end;
+          }
+        }
+
+        Counts& counts = categories[s.substr(i, end + 1 - i)];
+        i = end + 1;
+
+        if (!count(s, i, ":{\"reported\":", counts.reported) ||
+            !count(s, i, ",\"suppressed\":", counts.suppressed) ||
+            s.compare(i, 1, "}") != 0)
+        {
+          throw std::runtime_error("malformed error summary");
+        }
+
+        ++i;
+        if (s.compare(i, 1, ",") == 0) {
+          ++i;
+        }
+      }
+
+      if (!seen) {
+        seen = true;
+        pretty = rec.find('\n') + 1 != rec.size();
+      }
+
+      return true;
+    }
+
+    // Writes the summary, as pstrip would, if there was one.
+    void write(std::ostream& out) const {
+      if (!seen) {
+        return;
+      }
+
+      if (pretty) {
+        out << "{\n \"error summary\" : {";
+        for (Category_map::const_iterator i(categories.begin()); i != categories.end(); ++i) {
+          out << (i == categories.begin() ? "\n" : ",\n")
+              << "  " << i->first << " : {\n"
+              << "   \"reported\" : " << i->second.reported << ",\n"
+              << "   \"suppressed\" : " << i->second.suppressed << "\n"
+              << "  }";
+        }
+        out << "\n }\n}\n";
+      }
+      else {
+        out << "{\"error summary\":{";
+        for (Category_map::const_iterator i(categories.begin()); i != categories.end(); ++i) {
+          if (i != categories.begin()) {
+            out << ',';
+          }
+          out << i->first
+              << ":{\"reported\":" << i->second.reported
+              << ",\"suppressed\":" << i->second.suppressed << '}';
+        }
+        out << "}}\n";
+      }
+    }
+
+  private:
+    struct Counts {
+      Counts(): reported(0), suppressed(0) {}
+
+      unsigned long reported;
+      unsigned long suppressed;
+    };
+
+    // Adds the number after key, at i in s, to n.
+    static bool count(const std::string& s, std::string::size_type& i, const char* key, unsigned long& n) {
+      const std::string k(key);
+      if (s.compare(i, k.size(), k) != 0) {
+        return false;
+      }
+
+      i += k.size();
+      const std::string::size_type begin = i;
+      while (i < s.size() && isdigit((unsigned char) s[i])) {
+        ++i;
+      }
+
+      if (i == begin) {
+        return false;
+      }
+
+      n += std::strtoul(s.c_str() + begin, 0, 10);
+      return true;
+    }
+
+    // by category, quoted as written
+    typedef std::map<std::string, Counts> Category_map;
+
+    Category_map categories;
+    bool seen;
+    bool pretty;
+  };
+
+  bool is_number(const std::string& s, std::string::size_type begin, std::string::size_type end) {
+    if (begin == end) {
+      return false;
+    }
+
+    for (std::string::size_type i = begin; i < end; ++i) {
+      if (s[i] < '0' || s[i] > '9') {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // where pstrip walks a segment among its siblings: sub-items, and then
+  // a folder's unknowns, or the file's orphans, and recovered items
+  int rank(const std::string& s, std::string::size_type begin, std::string::size_type end) {
+    const std::string seg(s, begin, end - begin);
+
+    if (is_number(s, begin, end)) {
+      return 0;
+    }
+    else if (seg == "unknowns") {
+      return 1;
+    }
+    else if (seg == "orphans") {
+      return 2;
+    }
+    else if (seg == "recovered") {
+      return 3;
+    }
+
+    return 4;
+  }
+
+  // Compares paths in the order pstrip walks them, segment by segment,
+  // with an item before the items under it.
+  int compare_paths(const std::string& a, const std::string& b) {
+    std::string::size_type i = 0, j = 0;
+
+    while (i < a.size() && j < b.size()) {
+      std::string::size_type ie = a.find('/', i + 1);
+      std::string::size_type je = b.find('/', j + 1);
+      if (ie == std::string::npos) {
+        ie = a.size();
+      }
+      if (je == std::string::npos) {
+        je = b.size();
+      }
+
+      if (a.compare(i, ie - i, b, j, je - j) != 0) {
+        // past the leading slashes
+        const std::string::size_type ib = a[i] == '/' ? i + 1 : i;
+        const std::string::size_type jb = b[j] == '/' ? j + 1 : j;
+
+        const int ra = rank(a, ib, ie);
+        const int rb = rank(b, jb, je);
+        if (ra != rb) {
+          return ra < rb ? -1 : 1;
+        }
+
+        if (ra == 0) {
+          // numbers without leading zeros, so the longer is the greater
+          const std::string::size_type la = ie - ib, lb = je - jb;
+          if (la != lb) {
+            return la < lb ? -1 : 1;
+          }
+        }
+
+        return a.compare(ib, ie - ib, b, jb, je - jb) < 0 ? -1 : 1;
+      }
+
+      i = ie;
+      j = je;
+    }
+
+    if (i < a.size()) {
+      return 1;
+    }
+    else if (j < b.size()) {
+      return -1;
+    }
+
+    return 0;
+  }
+
+  struct Head {
+    Record rec;
+    size_t input;
+  };
+
+  // for a priority_queue, whose top is its greatest; ties go to the
+  // earlier input, so the merge is stable
+  struct Later {
+    bool operator()(const Head* a, const Head* b) const {
+      const int c = compare_paths(a->rec.path, b->rec.path);
+      return c ? c > 0 : a->input > b->input;
+    }
+  };
+}
+
+int main(int argc, char** argv) {
+  if (argc == 2 && std::string(argv[1]) == "--help") {
+    usage(std::cout, argv[0]);
+    return EXIT_SUCCESS;
+  }
+
+  if (argc < 2) {
+    usage(std::cerr, argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  try {
+    std::vector<boost::shared_ptr<Input> > inputs;
+    std::vector<Head> heads(argc - 1);
+    std::priority_queue<Head*, std::vector<Head*>, Later> queue;
+
+    // records without a path, by input, but for error summaries
+    std::vector<std::string> rest(argc - 1);
+    Summary summary;
+
+    for (int i = 1; i < argc; ++i) {
+      inputs.push_back(boost::shared_ptr<Input>(new Input(argv[i])));
+    }
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+      heads[i].input = i;
+      while (inputs[i]->next(heads[i].rec)) {
+        if (heads[i].rec.has_path) {
+          queue.push(&heads[i]);
+          break;
+        }
+        if (!summary.add(heads[i].rec.text)) {
+          rest[i] += heads[i].rec.text;
+        }
+      }
+    }
+
+    while (!queue.empty()) {
+      Head* head = queue.top();
+      queue.pop();
+
+      std::cout << head->rec.text;
+
+      while (inputs[head->input]->next(head->rec)) {
+        if (head->rec.has_path) {
+          queue.push(head);
+          break;
+        }
+        if (!summary.add(head->rec.text)) {
+          rest[head->input] += head->rec.text;
+        }
+      }
+    }
+
+    for (std::vector<std::string>::const_iterator i(rest.begin()); i != rest.end(); ++i) {
+      std::cout << *i;
+    }
+
+    summary.write(std::cout);
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
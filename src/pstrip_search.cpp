@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "text_index.h"
+
+//
+// Searches an index built by pstrip --index for the items with all the
+// given terms, and writes their identifiers, one per line, for
+// pstrip --item-ids. A term ending in * matches every term it starts.
+//
+
+namespace {
+  void usage(std::ostream& out, const char* argv0) {
+    out << "Usage: " << argv0 << " INDEX TERM...\n"
+           "\n"
+           "Write the identifiers of the items indexed in INDEX with every\n"
+           "TERM, one per line. A TERM ending in * matches any term which\n"
+           "starts with the rest.\n";
+  }
+
+  // Narrows ids to those indexed under every term in arg.
+  void match(Index_reader& index, const std::string& arg, std::vector<uint32_t>& ids, bool& first) {
+    const bool prefix = !arg.empty() && arg[arg.size() - 1] == '*';
+    const std::string text(arg, 0, prefix ? arg.size() - 1 : arg.size());
+
+    // arg is tokenized as indexed text is; only its last term is a prefix
+    Tokenizer tok(text.data(), text.size());
+    std::vector<std::string> terms;
+    std::string term;
+    while (tok.next(term)) {
+      terms.push_back(term);
+    }
+
+    if (terms.empty()) {
+      throw std::runtime_error("no searchable term in " + arg);
+    }
+
+    std::vector<uint32_t> found;
+    std::vector<uint32_t> both;
+    for (std::vector<std::string>::const_iterator i(terms.begin()); i != terms.end(); ++i) {
+      if (prefix && i + 1 == terms.end()) {
+        index.lookup_prefix(*i, found);
+      }
+      else {
+        index.lookup(*i, found);
+      }
+
+      if (first) {
+        ids.swap(found);
+        first = false;
+      }
+      else {
+        both.clear();
+        std::set_intersection(ids.begin(), ids.end(), found.begin(), found.end(), std::back_inserter(both));
+        ids.swap(both);
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc == 2 && std::string(argv[1]) == "--help") {
+    usage(std::cout, argv[0]);
+    return EXIT_SUCCESS;
+  }
+
+  if (argc < 3) {
+    usage(std::cerr, argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  try {
+    Index_reader index(argv[1]);
+
+    std::vector<uint32_t> ids;
+    bool first = true;
+    for (int i = 2; i < argc && (first || !ids.empty()); ++i) {
+      match(index, argv[i], ids, first);
+    }
+
+    for (std::vector<uint32_t>::const_iterator i(ids.begin()); i != ids.end(); ++i) {
+      std::cout << *i << '\n';
+    }
+  }
+  catch (const std::exception& e) {
+    std::cerr << "Error: " << e.what() << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,516 @@
+#include <boost/bind.hpp>
+#include <boost/scoped_array.hpp>
+
+#include "context.h"
+#include "dedup.h"
+#include "filetime.h"
+#include "json_writer.h"
+#include "pff.h"
+#include "semantic.h"
+
+namespace {
+  constexpr JSON_key PATH(JSON_key::plain("path"));
+  constexpr JSON_key DISPLAY_PATH(JSON_key::plain("display path"));
+  constexpr JSON_key ITEM_TYPE(JSON_key::plain("item type"));
+  constexpr JSON_key KIND(JSON_key::plain("kind"));
+  constexpr JSON_key IDENTIFIER(JSON_key::plain("identifier"));
+  constexpr JSON_key FINGERPRINT(JSON_key::plain("fingerprint"));
+  constexpr JSON_key MESSAGE_CLASS(JSON_key::plain("message class"));
+  constexpr JSON_key SUBJECT(JSON_key::plain("subject"));
+  constexpr JSON_key CLIENT_SUBMIT_TIME(JSON_key::plain("client submit time"));
+  constexpr JSON_key DELIVERY_TIME(JSON_key::plain("delivery time"));
+  constexpr JSON_key CREATION_TIME(JSON_key::plain("creation time"));
+  constexpr JSON_key MODIFICATION_TIME(JSON_key::plain("modification time"));
+  constexpr JSON_key BODY(JSON_key::plain("body"));
+  constexpr JSON_key RECIPIENTS(JSON_key::plain("recipients"));
+  constexpr JSON_key ATTACHMENTS(JSON_key::plain("attachments"));
+  constexpr JSON_key TYPE(JSON_key::plain("type"));
+  constexpr JSON_key SIZE(JSON_key::plain("size"));
+
+  enum Kind { STRING, INT32, BOOL, DOUBLE, FILETIME };
+
+  struct Field {
+    uint32_t etype;
+    JSON_key key;
+    Kind kind;
+  };
+
+  constexpr Field EMAIL_FIELDS[] = {
+    { LIBPFF_ENTRY_TYPE_MESSAGE_CONVERSATION_TOPIC, JSON_key::plain("conversation topic"), STRING },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_NAME, JSON_key::plain("sender name"), STRING },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_SENDER_EMAIL_ADDRESS, JSON_key::plain("sender email address"), STRING },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_NAME, JSON_key::plain("sent representing name"), STRING },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_SENT_REPRESENTING_EMAIL_ADDRESS, JSON_key::plain("sent representing email address"), STRING },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_IMPORTANCE, JSON_key::plain("importance"), INT32 },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_PRIORITY, JSON_key::plain("priority"), INT32 },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_SENSITIVITY, JSON_key::plain("sensitivity"), INT32 },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_FLAGS, JSON_key::plain("flags"), INT32 },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_SIZE, JSON_key::plain("size"), INT32 },
+    { LIBPFF_ENTRY_TYPE_MESSAGE_TRANSPORT_HEADERS, JSON_key::plain("transport headers"), STRING }
+  };
+
+  constexpr Field CONTACT_FIELDS[] = {
+    { LIBPFF_ENTRY_TYPE_DISPLAY_NAME, JSON_key::plain("display name"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_TITLE, JSON_key::plain("title"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_GIVEN_NAME, JSON_key::plain("given name"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_INITIALS, JSON_key::plain("initials"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_SURNAME, JSON_key::plain("surname"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_GENERATIONAL_ABBREVIATION, JSON_key::plain("generational abbreviation"), STRING },
+    { LIBPFF_ENTRY_TYPE_ADDRESS_FILE_UNDER, JSON_key::plain("file under"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_COMPANY_NAME, JSON_key::plain("company name"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_DEPARTMENT_NAME, JSON_key::plain("department name"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_JOB_TITLE, JSON_key::plain("job title"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_OFFICE_LOCATION, JSON_key::plain("office location"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_PRIMARY_PHONE_NUMBER, JSON_key::plain("primary phone number"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_PHONE_NUMBER_1, JSON_key::plain("business phone number"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_PHONE_NUMBER_2, JSON_key::plain("business phone number 2"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_BUSINESS_FAX_NUMBER, JSON_key::plain("business fax number"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_HOME_PHONE_NUMBER, JSON_key::plain("home phone number"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_MOBILE_PHONE_NUMBER, JSON_key::plain("mobile phone number"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_CALLBACK_PHONE_NUMBER, JSON_key::plain("callback phone number"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_POSTAL_ADDRESS, JSON_key::plain("postal address"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_LOCALITY, JSON_key::plain("locality"), STRING },
+    { LIBPFF_ENTRY_TYPE_CONTACT_COUNTRY, JSON_key::plain("country"), STRING }
+  };
+
+  constexpr Field APPOINTMENT_FIELDS[] = {
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_START_TIME, JSON_key::plain("start time"), FILETIME },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_END_TIME, JSON_key::plain("end time"), FILETIME },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_DURATION, JSON_key::plain("duration"), INT32 },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_LOCATION, JSON_key::plain("location"), STRING },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_BUSY_STATUS, JSON_key::plain("busy status"), INT32 },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_IS_RECURRING, JSON_key::plain("is recurring"), BOOL },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_RECURRENCE_PATTERN, JSON_key::plain("recurrence pattern"), STRING },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_TIMEZONE_DESCRIPTION, JSON_key::plain("timezone description"), STRING },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_FIRST_EFFECTIVE_TIME, JSON_key::plain("first effective time"), FILETIME },
+    { LIBPFF_ENTRY_TYPE_APPOINTMENT_LAST_EFFECTIVE_TIME, JSON_key::plain("last effective time"), FILETIME }
+  };
+
+  constexpr Field TASK_FIELDS[] = {
+    { LIBPFF_ENTRY_TYPE_TASK_STATUS, JSON_key::plain("status"), INT32 },
+    { LIBPFF_ENTRY_TYPE_TASK_PERCENTAGE_COMPLETE, JSON_key::plain("percentage complete"), DOUBLE },
+    { LIBPFF_ENTRY_TYPE_TASK_START_DATE, JSON_key::plain("start date"), FILETIME },
+    { LIBPFF_ENTRY_TYPE_TASK_DUE_DATE, JSON_key::plain("due date"), FILETIME },
+    { LIBPFF_ENTRY_TYPE_TASK_IS_COMPLETE, JSON_key::plain("is complete"), BOOL },
+    { LIBPFF_ENTRY_TYPE_TASK_ACTUAL_EFFORT, JSON_key::plain("actual effort"), INT32 },
+    { LIBPFF_ENTRY_TYPE_TASK_TOTAL_EFFORT, JSON_key::plain("total effort"), INT32 },
+    { LIBPFF_ENTRY_TYPE_TASK_IS_RECURRING, JSON_key::plain("is recurring"), BOOL },
+    { LIBPFF_ENTRY_TYPE_TASK_VERSION, JSON_key::plain("version"), INT32 }
+  };
+
+  template <size_t N> size_t count(const Field (&)[N]) { return N; }
+
+  template <typename L, typename G> Decode_error write_string(
+    L length_getter,
+    G value_getter,
+    JSON_key key,
+    JSON_writer& json)
+  {
+    libpff_error_t* error = 0;
+    size_t len;
+    switch (length_getter(&len, &error)) {
+    case -1:
+      return Decode_error(error, __LINE__);
+    case  0:
+      break;
+    case  1:
+      {
+        boost::scoped_array<uint8_t> buf(new uint8_t[len]);
+        if (value_getter(buf.get(), len, &error) != 1) {
+          return Decode_error(error, __LINE__);
+        }
+
+        json.object_member_write(key, (const char*) buf.get());
+      }
+      break;
+    }
+
+    return Decode_error();
+  }
+
+  template <typename U, typename S, typename G> Decode_error write_number(
+    G getter,
+    JSON_key key,
+    JSON_writer& json)
+  {
+    libpff_error_t* error = 0;
+    U val;
+    switch (getter(&val, &error)) {
+    case -1:
+      return Decode_error(error, __LINE__);
+    case  0:
+      break;
+    case  1:
+      json.object_member_write(key, (S) val);
+      break;
+    }
+
+    return Decode_error();
+  }
+
+  template <typename G> Decode_error write_time(
+    G getter,
+    JSON_key key,
+    Context& ctx)
+  {
+    libpff_error_t* error = 0;
+    uint64_t val;
+    switch (getter(&val, &error)) {
+    case -1:
+      return Decode_error(error, __LINE__);
+    case  0:
+      break;
+    case  1:
+      {
+        char buf[Filetime_format::MAXLEN];
+        ctx.json.object_member_write_raw(key, buf, ctx.times.format(val, buf));
+      }
+      break;
+    }
+
+    return Decode_error();
+  }
+
+  Decode_error write_field(libpff_item_t* item, uint32_t set, const Field& f, Context& ctx) {
+    const uint32_t et = f.etype;
+
+    switch (f.kind) {
+    case STRING:
+      return write_string(
+        boost::bind(&libpff_item_get_entry_value_utf8_string_size, item, set, et, _1, 0, _2),
+        boost::bind(&libpff_item_get_entry_value_utf8_string, item, set, et, _1, _2, 0, _3),
+        f.key, ctx.json
+      );
+    case INT32:
+      return write_number<uint32_t, int32_t>(
+        boost::bind(&libpff_item_get_entry_value_32bit, item, set, et, _1, 0, _2),
+        f.key, ctx.json
+      );
+    case BOOL:
+      return write_number<uint8_t, bool>(
+        boost::bind(&libpff_item_get_entry_value_boolean, item, set, et, _1, 0, _2),
+        f.key, ctx.json
+      );
+    case DOUBLE:
+      return write_number<double, double>(
+        boost::bind(&libpff_item_get_entry_value_floating_point, item, set, et, _1, 0, _2),
+        f.key, ctx.json
+      );
+    case FILETIME:
+      return write_time(
+        boost::bind(&libpff_item_get_entry_value_filetime, item, set, et, _1, 0, _2),
+        f.key, ctx
+      );
+    }
+
+    return Decode_error();
+  }
+
+  void write_fields(libpff_item_t* item, const Field* fields, size_t n, const std::string& path, Context& ctx) {
+    for (size_t i = 0; i < n; ++i) {
+      Decode_error err(write_field(item, 0, fields[i], ctx));
+      if (err.failed()) {
+        report(ctx, "semantic", path, err);
+      }
+    }
+  }
+
+  void write_message_fields(libpff_item_t* item, const std::string& path, Context& ctx) {
+    JSON_writer& json = ctx.json;
+
+    Decode_error err;
+
+    err = write_string(
+      boost::bind(&libpff_message_get_entry_value_utf8_string_size, item, LIBPFF_ENTRY_TYPE_MESSAGE_CLASS, _1, _2),
+      boost::bind(&libpff_message_get_entry_value_utf8_string, item, LIBPFF_ENTRY_TYPE_MESSAGE_CLASS, _1, _2, _3),
+      MESSAGE_CLASS, json
+    );
+    if (err.failed()) {
+      report(ctx, "semantic", path, err);
+    }
+
+    err = write_string(
+      boost::bind(&libpff_message_get_entry_value_utf8_string_size, item, LIBPFF_ENTRY_TYPE_MESSAGE_SUBJECT, _1, _2),
+      boost::bind(&libpff_message_get_entry_value_utf8_string, item, LIBPFF_ENTRY_TYPE_MESSAGE_SUBJECT, _1, _2, _3),
+      SUBJECT, json
+    );
+    if (err.failed()) {
+      report(ctx, "semantic", path, err);
+    }
+
+    err = write_time(
+      boost::bind(&libpff_message_get_client_submit_time, item, _1, _2),
+      CLIENT_SUBMIT_TIME, ctx
+    );
+    if (err.failed()) {
+      report(ctx, "semantic", path, err);
+    }
+
+    err = write_time(
+      boost::bind(&libpff_message_get_delivery_time, item, _1, _2),
+      DELIVERY_TIME, ctx
+    );
+    if (err.failed()) {
+      report(ctx, "semantic", path, err);
+    }
+
+    err = write_time(
+      boost::bind(&libpff_message_get_creation_time, item, _1, _2),
+      CREATION_TIME, ctx
+    );
+    if (err.failed()) {
+      report(ctx, "semantic", path, err);
+    }
+
+    err = write_time(
+      boost::bind(&libpff_message_get_modification_time, item, _1, _2),
+      MODIFICATION_TIME, ctx
+    );
+    if (err.failed()) {
+      report(ctx, "semantic", path, err);
+    }
+  }
+
+  void write_body(libpff_item_t* item, const std::string& path, Context& ctx) {
+    Decode_error err(write_string(
+      boost::bind(&libpff_message_get_plain_text_body_size, item, _1, _2),
+      boost::bind(&libpff_message_get_plain_text_body, item, _1, _2, _3),
+      BODY, ctx.json
+    ));
+    if (err.failed()) {
+      report(ctx, "semantic", path, err);
+    }
+  }
+
+  const char* recipient_type_string(uint32_t rtype) {
+    // MAPI_TO, MAPI_CC, MAPI_BCC
+    switch (rtype) {
+    case 1:
+      return "to";
+    case 2:
+      return "cc";
+    case 3:
+      return "bcc";
+    default:
+      return 0;
+    }
+  }
+
+  constexpr Field RECIPIENT_FIELDS[] = {
+    { LIBPFF_ENTRY_TYPE_DISPLAY_NAME, JSON_key::plain("name"), STRING },
+    { LIBPFF_ENTRY_TYPE_EMAIL_ADDRESS, JSON_key::plain("email address"), STRING },
+    { LIBPFF_ENTRY_TYPE_ADDRESS_TYPE, JSON_key::plain("address type"), STRING }
+  };
+
+  void write_recipients(libpff_item_t* item, const std::string& path, Context& ctx) {
+    JSON_writer& json = ctx.json;
+    libpff_error_t* error = 0;
+
+    libpff_item_t* recipients = 0;
+    switch (libpff_message_get_recipients(item, &recipients, &error)) {
+    case -1:
+      report(ctx, "semantic", path, Decode_error(error, __LINE__));
+      return;
+    case  0:
+      return;
+    }
+
+    ItemPtr recipientsp(recipients, &destroy_item);
+
+    // each set is a recipient
+    uint32_t n;
+    if (libpff_item_get_number_of_sets(recipients, &n, &error) != 1) {
+      report(ctx, "semantic", path, Decode_error(error, __LINE__));
+      return;
+    }
+
+    json.array_member_open(RECIPIENTS);
+
+    for (uint32_t r = 0; r < n; ++r) {
+      json.object_open();
+
+      uint32_t rtype;
+      switch (libpff_item_get_entry_value_32bit(recipients, r, LIBPFF_ENTRY_TYPE_RECIPIENT_TYPE, &rtype, 0, &error)) {
+      case -1:
+        report(ctx, "semantic", path, Decode_error(error, __LINE__), r);
+        break;
+      case  0:
+        break;
+      case  1:
+        if (const char* rs = recipient_type_string(rtype)) {
+          json.object_member_write(TYPE, rs);
+        }
+        else {
+          json.object_member_write(TYPE, rtype);
+        }
+        break;
+      }
+
+      for (size_t i = 0; i < count(RECIPIENT_FIELDS); ++i) {
+        Decode_error err(write_field(recipients, r, RECIPIENT_FIELDS[i], ctx));
+        if (err.failed()) {
+          report(ctx, "semantic", path, err, r);
+        }
+      }
+
+      json.object_close();
+    }
+
+    json.array_member_close();
+  }
+
+  const char* attachment_type_string(int atype) {
+    switch (atype) {
+    case LIBPFF_ATTACHMENT_TYPE_DATA:
+      return "data";
+    case LIBPFF_ATTACHMENT_TYPE_ITEM:
+      return "item";
+    case LIBPFF_ATTACHMENT_TYPE_REFERENCE:
+      return "reference";
+    default:
+      return "undefined";
+    }
+  }
+
+  constexpr Field ATTACHMENT_FIELDS[] = {
+    { LIBPFF_ENTRY_TYPE_ATTACHMENT_FILENAME_LONG, JSON_key::plain("filename"), STRING },
+    { LIBPFF_ENTRY_TYPE_ATTACHMENT_FILENAME_SHORT, JSON_key::plain("short filename"), STRING },
+    { LIBPFF_ENTRY_TYPE_ATTACHMENT_METHOD, JSON_key::plain("method"), INT32 }
+  };
+
+  void write_attachment(libpff_item_t* att, int a, const std::string& path, Context& ctx) {
+    JSON_writer& json = ctx.json;
+    libpff_error_t* error = 0;
+
+    json.object_open();
+
+    int atype;
+    switch (libpff_attachment_get_type(att, &atype, &error)) {
+    case -1:
+      report(ctx, "semantic", path, Decode_error(error, __LINE__), Error_log::NONE, Error_log::NONE, a);
+      break;
+    case  0:
+      break;
+    case  1:
+      json.object_member_write(TYPE, attachment_type_string(atype));
+      break;
+    }
+
+    for (size_t i = 0; i < count(ATTACHMENT_FIELDS); ++i) {
+      Decode_error err(write_field(att, 0, ATTACHMENT_FIELDS[i], ctx));
+      if (err.failed()) {
+        report(ctx, "semantic", path, err, Error_log::NONE, Error_log::NONE, a);
+      }
+    }
+
+    size64_t size;
+    switch (libpff_attachment_get_data_size(att, &size, &error)) {
+    case -1:
+      report(ctx, "semantic", path, Decode_error(error, __LINE__), Error_log::NONE, Error_log::NONE, a);
+      break;
+    case  0:
+      break;
+    case  1:
+      json.object_member_write(SIZE, (uint64_t) size);
+      break;
+    }
+
+    json.object_close();
+  }
+
+  void write_attachments(libpff_item_t* item, const std::string& path, Context& ctx) {
+    JSON_writer& json = ctx.json;
+    libpff_error_t* error = 0;
+
+    int n;
+    if (libpff_message_get_number_of_attachments(item, &n, &error) != 1) {
+      report(ctx, "semantic", path, Decode_error(error, __LINE__));
+      return;
+    }
+
+    if (n == 0) {
+      return;
+    }
+
+    json.array_member_open(ATTACHMENTS);
+
+    for (int a = 0; a < n; ++a) {
+      libpff_item_t* att = 0;
+      if (libpff_message_get_attachment(item, a, &att, &error) != 1) {
+        report(ctx, "semantic", path, Decode_error(error, __LINE__), Error_log::NONE, Error_log::NONE, a);
+        continue;
+      }
+
+      ItemPtr attp(att, &destroy_item);
+      write_attachment(att, a, path, ctx);
+    }
+
+    json.array_member_close();
+  }
+}
+
+bool write_semantic_record(const Pst_item& item, Context& ctx, const Fingerprint* fp) {
+  if (!item.type_known) {
+    return false;
+  }
+
+  const Field* fields;
+  size_t n;
+  const char* tname;
+
+  switch (item.type) {
+  case LIBPFF_ITEM_TYPE_EMAIL:
+  case LIBPFF_ITEM_TYPE_EMAIL_SMIME:
+    fields = EMAIL_FIELDS;
+    n = count(EMAIL_FIELDS);
+    tname = "email";
+    break;
+  case LIBPFF_ITEM_TYPE_CONTACT:
+    fields = CONTACT_FIELDS;
+    n = count(CONTACT_FIELDS);
+    tname = "contact";
+    break;
+  case LIBPFF_ITEM_TYPE_APPOINTMENT:
+  case LIBPFF_ITEM_TYPE_MEETING:
+    fields = APPOINTMENT_FIELDS;
+    n = count(APPOINTMENT_FIELDS);
+    tname = "appointment";
+    break;
+  case LIBPFF_ITEM_TYPE_TASK:
+  case LIBPFF_ITEM_TYPE_TASK_REQUEST:
+    fields = TASK_FIELDS;
+    n = count(TASK_FIELDS);
+    tname = "task";
+    break;
+  default:
+    return false;
+  }
+
+  JSON_writer& json = ctx.json;
+
+  json.object_open();
+
+  json.object_member_write(PATH, item.path);
+  json.object_member_write(DISPLAY_PATH, item.dpath);
+  json.object_member_write(ITEM_TYPE, (uint32_t) item.type);
+  json.object_member_write(KIND, tname);
+
+  if (item.identifier_known) {
+    json.object_member_write(IDENTIFIER, item.identifier);
+  }
+
+  if (fp) {
+    json.object_member_write(FINGERPRINT, fp->hex());
+  }
+
+  write_message_fields(item.handle, item.path, ctx);
+  write_fields(item.handle, fields, n, item.path, ctx);
+  write_body(item.handle, item.path, ctx);
+  write_recipients(item.handle, item.path, ctx);
+  write_attachments(item.handle, item.path, ctx);
+
+  json.object_close();
+  json.reset();
+
+  return true;
+}
@@ -0,0 +1,294 @@
+#include <algorithm>
+#include <stdexcept>
+#include <unordered_set>
+
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+
+#include "context.h"
+#include "pff.h"
+#include "pstrip.h"
+#include "shard.h"
+
+// A folder, or the root, and the folders in it.
+struct Pst_shard::Node {
+  Node(): index(0), identifier(0), count(0), weight(1) {}
+
+  int index;
+  uint32_t identifier;
+  std::string dpath;
+
+  // sub-items, and items in all, this one included
+  int count;
+  uint64_t weight;
+
+  std::vector<Node> inner;
+};
+
+namespace {
+  // units per share, at least, for shares to come out about even
+  const uint64_t UNITS_PER_SHARE = 16;
+
+  int sub_item_count(libpff_item_t* item) {
+    return get_attrib<int>(
+      boost::bind(&libpff_item_get_number_of_sub_items, item, _1, _2)
+    );
+  }
+
+  // the identifiers of a folder's sub-folders, from its own table of
+  // them, without opening the rest of its sub-items
+  void sub_folders(libpff_item_t* folder, std::unordered_set<uint32_t>& ids) {
+    const int n = get_attrib<int>(
+      boost::bind(&libpff_folder_get_number_of_sub_folders, folder, _1, _2)
+    );
+
+    for (int i = 0; i < n; ++i) {
+      ItemPtr subp(get_sub_folder(folder, i), &destroy_item);
+      ids.insert(get_attrib<uint32_t>(
+        boost::bind(&libpff_item_get_identifier, subp.get(), _1, _2)
+      ));
+    }
+  }
+
+  // Weighs the folder of node, or the root, whose count it has, by its
+  // sub-items, one each, and keeps its sub-folders, weighed the same way.
+  // Messages are leaves, and aren't opened: only the identifiers of the
+  // sub-items of folders with sub-folders are read, to find those, and
+  // for the root, which isn't a folder to libpff, the types of its few
+  // sub-items. A folder which can't be read weighs as if it had none.
+  template <typename N> void measure(libpff_item_t* item, N& node, bool root) {
+    node.weight += node.count;
+
+    std::unordered_set<uint32_t> folders;
+    if (!root) {
+      try {
+        sub_folders(item, folders);
+      }
+      catch (const libpff_error&) {
+      }
+
+      if (folders.empty()) {
+        return;
+      }
+    }
+
+    for (int i = 0; i < node.count; ++i) {
+      try {
+        ItemPtr childp(get_child(item, i), &destroy_item);
+
+        const uint32_t id = get_attrib<uint32_t>(
+          boost::bind(&libpff_item_get_identifier, childp.get(), _1, _2)
+        );
+
+        const bool folder = root ?
+          get_attrib<uint8_t>(
+            boost::bind(&libpff_item_get_type, childp.get(), _1, _2)
+          ) == LIBPFF_ITEM_TYPE_FOLDER :
+          folders.count(id) > 0;
+
+        if (!folder) {
+          continue;
+        }
+
+        N child;
+        child.index = i;
+        child.identifier = id;
+        child.count = sub_item_count(childp.get());
+        // quietly, since walking the folder reports any errors
+        child.dpath = display_path(childp.get(), std::string(), node.dpath, i);
+
+        measure(childp.get(), child, false);
+
+        // the one it weighed as a sub-item is in the folder's weight
+        node.weight += child.weight - 1;
+        node.inner.push_back(child);
+      }
+      catch (const libpff_error&) {
+      }
+    }
+  }
+
+  int count_of(int (*getter)(libpff_file_t*, int*, libpff_error_t**), libpff_file_t* file) {
+    try {
+      return get_attrib<int>(boost::bind(getter, file, _1, _2));
+    }
+    catch (const libpff_error&) {
+      // the share with everything reports this
+      return -1;
+    }
+  }
+}
+
+Pst_shard::Pst_shard(libpff_file_t* file, const std::string& n, unsigned int s, unsigned int ss):
+  name(n), share(s), shares(ss), target(1), total(0), done(0)
+{
+  ItemPtr rootp(get_root(file), &destroy_item);
+
+  Node root;
+  root.dpath = '/' + name;
+  root.count = sub_item_count(rootp.get());
+  measure(rootp.get(), root, true);
+
+  // the root itself is never walked
+  total = root.weight - 1;
+  target = std::max<uint64_t>(1, total / (shares * UNITS_PER_SHARE));
+
+  cut(root, '/' + name, std::string(), true);
+}
+
+void Pst_shard::cut(const Node& node, const std::string& path, const std::string& parent_dpath, bool root) {
+  Unit unit = { Unit::ITEM, root, node.identifier, path, parent_dpath, node.index, 0, 0 };
+
+  if (!root) {
+    add(unit, 1);
+  }
+
+  std::vector<Node>::const_iterator inner(node.inner.begin());
+  int begin = -1;
+  uint64_t weight = 0;
+
+  for (int i = 0; i < node.count; ++i) {
+    const Node* child = 0;
+    if (inner != node.inner.end() && inner->index == i) {
+      child = &*inner++;
+    }
+
+    if (child && child->weight > target) {
+      if (begin >= 0) {
+        add_range(node, path, root, begin, i, weight);
+        begin = -1;
+        weight = 0;
+      }
+
+      cut(*child, path + '/' + boost::lexical_cast<std::string>(i), node.dpath, false);
+      continue;
+    }
+
+    if (begin < 0) {
+      begin = i;
+    }
+
+    weight += child ? child->weight : 1;
+    if (weight >= target) {
+      add_range(node, path, root, begin, i + 1, weight);
+      begin = -1;
+      weight = 0;
+    }
+  }
+
+  if (begin >= 0) {
+    add_range(node, path, root, begin, node.count, weight);
+  }
+
+  if (!root) {
+    unit.kind = Unit::UNKNOWNS;
+    unit.dpath = node.dpath;
+    add(unit, 0);
+  }
+}
+
+void Pst_shard::add_range(const Node& node, const std::string& path, bool root, int begin, int end, uint64_t weight) {
+  const Unit unit = { Unit::SUB_ITEMS, root, node.identifier, path, node.dpath, node.index, begin, end };
+  add(unit, weight);
+}
+
+void Pst_shard::add(const Unit& unit, uint64_t weight) {
+  // the share whose part of all the items this unit starts in
+  const uint64_t owner = std::min<uint64_t>(shares - 1, (uint64_t) ((long double) done * shares / total));
+
+  if (owner == share) {
+    units.push_back(unit);
+  }
+
+  done += weight;
+}
+
+void Pst_shard::walk(libpff_file_t* file, Pst_walker& walker, Context& ctx) const {
+  for (std::vector<Unit>::const_iterator i(units.begin()); i != units.end(); ++i) {
+    check_cancel(ctx);
+
+    try {
+      // folders, whose identifiers can be looked up, and which the
+      // sample always keeps
+      ItemPtr itemp(i->root ? get_root(file) : get_item(file, i->identifier), &destroy_item);
+
+      switch (i->kind) {
+      case Unit::ITEM:
+        walker.walk_item(
+          itemp.get(), i->path,
+          walker.display_path(itemp.get(), i->path, i->dpath, i->index),
+          Pst_walker::ITEM
+        );
+        break;
+      case Unit::SUB_ITEMS:
+        walker.walk_sub_items(itemp.get(), i->path, i->dpath, i->begin, i->end);
+        break;
+      case Unit::UNKNOWNS:
+        // the item's unit reports it if its type can't be read
+        try {
+          const uint8_t type = get_attrib<uint8_t>(
+            boost::bind(&libpff_item_get_type, itemp.get(), _1, _2)
+          );
+
+          if (type == LIBPFF_ITEM_TYPE_FOLDER) {
+            walker.walk_unknowns(itemp.get(), i->path, i->dpath);
+          }
+        }
+        catch (const libpff_error&) {
+        }
+        break;
+      }
+    }
+    catch (const libpff_error& e) {
+      // the item was there when planning, so it isn't skipped quietly
+      report(ctx, "shard", i->path, e);
+    }
+  }
+
+  int begin, end;
+  share_of(count_of(&libpff_file_get_number_of_orphan_items, file), begin, end);
+  if (begin != end) {
+    walker.walk_orphans(file, name, begin, end);
+  }
+}
+
+void Pst_shard::walk_recovered(libpff_file_t* file, Pst_walker& walker) const {
+  int begin, end;
+  share_of(count_of(&libpff_file_get_number_of_recovered_items, file), begin, end);
+  if (begin != end) {
+    walker.walk_recovered(file, name, begin, end);
+  }
+}
+
+void Pst_shard::share_of(int count, int& begin, int& end) const {
+  if (count < 0) {
+    // unknown, so the first share takes them all, and reports why
+    begin = 0;
+    end = share == 0 ? Pst_walker::ALL : 0;
+    return;
+  }
+
+  begin = (int) ((uint64_t) count * share / shares);
+  end = (int) ((uint64_t) count * (share + 1) / shares);
+}
+
+void Pst_shard::parse(const std::string& arg, unsigned int& share, unsigned int& shares) {
+  const std::string::size_type slash = arg.find('/');
+
+  try {
+    if (slash != std::string::npos) {
+      const unsigned int i = boost::lexical_cast<unsigned int>(arg.substr(0, slash));
+      const unsigned int n = boost::lexical_cast<unsigned int>(arg.substr(slash + 1));
+
+      if (i >= 1 && i <= n) {
+        share = i - 1;
+        shares = n;
+        return;
+      }
+    }
+  }
+  catch (const boost::bad_lexical_cast&) {
+  }
+
+  throw std::runtime_error("--shard must be I/N, with I from 1 to N: " + arg);
+}
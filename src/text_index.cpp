@@ -0,0 +1,385 @@
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "text_index.h"
+
+namespace {
+  const char MAGIC[] = "PSTIDX1\n";
+  const size_t MAGIC_LEN = 8;
+
+  const size_t TRAILER_LEN = 16;
+
+  bool is_term_char(char c) {
+    return (unsigned char) c >= 0x80 ||
+      (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+  }
+
+  void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+      out += (char) (v | 0x80);
+      v >>= 7;
+    }
+    out += (char) v;
+  }
+
+  uint64_t get_varint(const char*& p, const char* end) {
+    uint64_t v = 0;
+    for (unsigned int shift = 0; p < end && shift < 64; shift += 7) {
+      const uint8_t b = *p++;
+      v |= (uint64_t) (b & 0x7F) << shift;
+      if (!(b & 0x80)) {
+        return v;
+      }
+    }
+
+    throw std::runtime_error("corrupt index");
+  }
+
+  void put_le64(std::string& out, uint64_t v) {
+    for (int i = 0; i < 8; ++i) {
+      out += (char) (v >> (8 * i));
+    }
+  }
+
+  uint64_t get_le64(const char* p) {
+    uint64_t v = 0;
+    for (int i = 0; i < 8; ++i) {
+      v |= (uint64_t) (uint8_t) p[i] << (8 * i);
+    }
+    return v;
+  }
+
+  void sort_unique(std::vector<uint32_t>& ids) {
+    std::sort(ids.begin(), ids.end());
+    ids.erase(std::unique(ids.begin(), ids.end()), ids.end());
+  }
+
+  // Writes an index file, a term at a time, in ascending term order.
+  class Index_file {
+  public:
+    explicit Index_file(const std::string& filename):
+      out(filename.c_str(), std::ios::binary), position(MAGIC_LEN),
+      last_offset(0), count(0)
+    {
+      if (!out) {
+        throw std::runtime_error("cannot open " + filename);
+      }
+
+      out.write(MAGIC, MAGIC_LEN);
+    }
+
+    // ids must be in ascending order, without repeats
+    void add(const std::string& term, const std::vector<uint32_t>& ids) {
+      buf.clear();
+      put_varint(buf, ids.size());
+
+      uint32_t prev = 0;
+      for (std::vector<uint32_t>::const_iterator i(ids.begin()); i != ids.end(); ++i) {
+        put_varint(buf, *i - prev);
+        prev = *i;
+      }
+
+      size_t shared = 0;
+      const size_t max = std::min(term.size(), last.size());
+      while (shared < max && term[shared] == last[shared]) {
+        ++shared;
+      }
+
+      put_varint(dictionary, shared);
+      put_varint(dictionary, term.size() - shared);
+      dictionary.append(term, shared, std::string::npos);
+      put_varint(dictionary, position - last_offset);
+
+      last_offset = position;
+      last = term;
+      ++count;
+
+      out.write(buf.data(), buf.size());
+      position += buf.size();
+    }
+
+    void close() {
+      put_le64(dictionary, position);
+      put_le64(dictionary, count);
+      out.write(dictionary.data(), dictionary.size());
+
+      out.close();
+      if (!out) {
+        throw std::runtime_error("cannot write index");
+      }
+    }
+
+  private:
+    std::ofstream out;
+    uint64_t position;
+    uint64_t last_offset;
+    uint64_t count;
+    std::string last;
+    std::string dictionary;
+    std::string buf;
+  };
+
+  // Merges segments, term by term, into filename.
+  void merge(const std::vector<std::string>& segments, const std::string& filename) {
+    std::vector<boost::shared_ptr<Index_reader> > readers;
+    for (std::vector<std::string>::const_iterator i(segments.begin()); i != segments.end(); ++i) {
+      readers.push_back(boost::shared_ptr<Index_reader>(new Index_reader(*i)));
+    }
+
+    std::vector<size_t> next(readers.size(), 0);
+
+    Index_file out(filename);
+    std::vector<uint32_t> ids;
+    std::vector<uint32_t> part;
+
+    for (;;) {
+      const std::string* term = 0;
+      for (size_t r = 0; r < readers.size(); ++r) {
+        if (next[r] < readers[r]->term_count() &&
+            (!term || readers[r]->term(next[r]) < *term)) {
+          term = &readers[r]->term(next[r]);
+        }
+      }
+
+      if (!term) {
+        break;
+      }
+
+      // term refers into a reader which is about to move past it
+      const std::string t(*term);
+
+      ids.clear();
+      for (size_t r = 0; r < readers.size(); ++r) {
+        if (next[r] < readers[r]->term_count() && readers[r]->term(next[r]) == t) {
+          readers[r]->postings(next[r]++, part);
+          ids.insert(ids.end(), part.begin(), part.end());
+        }
+      }
+
+      // an item is in more than one segment only if it was extracted twice
+      sort_unique(ids);
+      out.add(t, ids);
+    }
+
+    out.close();
+  }
+}
+
+bool Tokenizer::next(std::string& term) {
+  while (p < end) {
+    while (p < end && !is_term_char(*p)) {
+      ++p;
+    }
+
+    const char* b = p;
+    while (p < end && is_term_char(*p)) {
+      ++p;
+    }
+
+    const size_t len = p - b;
+    if (len >= 2 && len <= MAX_TERM) {
+      term.assign(b, len);
+      for (std::string::iterator i(term.begin()); i != term.end(); ++i) {
+        if (*i >= 'A' && *i <= 'Z') {
+          *i += 'a' - 'A';
+        }
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
+
+Index_writer::Index_writer(const std::string& f, size_t sp):
+  filename(f), segment_postings(sp), count(0), closed(false) {}
+
+Index_writer::~Index_writer() {
+  // merged, or abandoned
+  for (std::vector<std::string>::const_iterator i(segments.begin()); i != segments.end(); ++i) {
+    std::remove(i->c_str());
+  }
+}
+
+void Index_writer::add(uint32_t id, const char* text, size_t len) {
+  Tokenizer tok(text, len);
+  std::string term;
+  while (tok.next(term)) {
+    std::vector<uint32_t>& ids = postings[term];
+    if (ids.empty() || ids.back() != id) {
+      ids.push_back(id);
+      ++count;
+    }
+  }
+
+  if (count >= segment_postings) {
+    segments.push_back(filename + '.' + boost::lexical_cast<std::string>(segments.size()));
+    write_segment(segments.back());
+  }
+}
+
+void Index_writer::write_segment(const std::string& name) {
+  std::vector<Postings::iterator> sorted;
+  sorted.reserve(postings.size());
+  for (Postings::iterator i(postings.begin()); i != postings.end(); ++i) {
+    sorted.push_back(i);
+  }
+
+  std::sort(sorted.begin(), sorted.end(), &by_term);
+
+  Index_file out(name);
+  for (std::vector<Postings::iterator>::const_iterator i(sorted.begin()); i != sorted.end(); ++i) {
+    sort_unique((*i)->second);
+    out.add((*i)->first, (*i)->second);
+  }
+  out.close();
+
+  postings.clear();
+  count = 0;
+}
+
+void Index_writer::close() {
+  if (closed) {
+    return;
+  }
+  closed = true;
+
+  if (segments.empty()) {
+    // it all fit in one segment, which is the index
+    write_segment(filename);
+    return;
+  }
+
+  if (count > 0) {
+    segments.push_back(filename + '.' + boost::lexical_cast<std::string>(segments.size()));
+    write_segment(segments.back());
+  }
+
+  merge(segments, filename);
+}
+
+bool Index_writer::by_term(const Postings::iterator& a, const Postings::iterator& b) {
+  return a->first < b->first;
+}
+
+Index_reader::Index_reader(const std::string& f):
+  filename(f), in(f.c_str(), std::ios::binary)
+{
+  if (!in) {
+    throw std::runtime_error("cannot open " + filename);
+  }
+
+  char magic[MAGIC_LEN];
+  in.read(magic, MAGIC_LEN);
+  if (!in || !std::equal(magic, magic + MAGIC_LEN, MAGIC)) {
+    throw std::runtime_error(filename + ": not an index");
+  }
+
+  in.seekg(0, std::ios::end);
+  const uint64_t size = in.tellg();
+  if (size < MAGIC_LEN + TRAILER_LEN) {
+    throw std::runtime_error(filename + ": corrupt index");
+  }
+
+  char trailer[TRAILER_LEN];
+  in.seekg(size - TRAILER_LEN);
+  in.read(trailer, TRAILER_LEN);
+
+  const uint64_t dict_offset = get_le64(trailer);
+  const uint64_t count = get_le64(trailer + 8);
+  if (!in || dict_offset < MAGIC_LEN || dict_offset > size - TRAILER_LEN) {
+    throw std::runtime_error(filename + ": corrupt index");
+  }
+
+  std::string dict(size - TRAILER_LEN - dict_offset, '\0');
+  in.seekg(dict_offset);
+  in.read(&dict[0], dict.size());
+  if (!in) {
+    throw std::runtime_error("cannot read " + filename);
+  }
+
+  const char* p = dict.data();
+  const char* end = p + dict.size();
+
+  terms.reserve(count);
+  offsets.reserve(count + 1);
+
+  uint64_t offset = 0;
+  for (uint64_t t = 0; t < count; ++t) {
+    const uint64_t shared = get_varint(p, end);
+    const uint64_t rest = get_varint(p, end);
+    if (shared > (terms.empty() ? 0 : terms.back().size()) || rest > (uint64_t) (end - p)) {
+      throw std::runtime_error(filename + ": corrupt index");
+    }
+
+    std::string term(terms.empty() ? std::string() : terms.back().substr(0, shared));
+    term.append(p, rest);
+    p += rest;
+
+    offset += get_varint(p, end);
+
+    terms.push_back(term);
+    offsets.push_back(offset);
+  }
+
+  offsets.push_back(dict_offset);
+}
+
+void Index_reader::postings(size_t t, std::vector<uint32_t>& ids) {
+  ids.clear();
+
+  if (offsets[t] > offsets[t + 1]) {
+    throw std::runtime_error(filename + ": corrupt index");
+  }
+
+  std::string buf(offsets[t + 1] - offsets[t], '\0');
+  in.clear();
+  in.seekg(offsets[t]);
+  in.read(&buf[0], buf.size());
+  if (!in) {
+    throw std::runtime_error("cannot read " + filename);
+  }
+
+  const char* p = buf.data();
+  const char* end = p + buf.size();
+
+  const uint64_t n = get_varint(p, end);
+  ids.reserve(n);
+
+  uint32_t id = 0;
+  for (uint64_t i = 0; i < n; ++i) {
+    id += get_varint(p, end);
+    ids.push_back(id);
+  }
+}
+
+void Index_reader::lookup(const std::string& term, std::vector<uint32_t>& ids) {
+  std::vector<std::string>::const_iterator i(
+    std::lower_bound(terms.begin(), terms.end(), term)
+  );
+
+  if (i == terms.end() || *i != term) {
+    ids.clear();
+    return;
+  }
+
+  postings(i - terms.begin(), ids);
+}
+
+void Index_reader::lookup_prefix(const std::string& prefix, std::vector<uint32_t>& ids) {
+  ids.clear();
+
+  std::vector<uint32_t> part;
+  for (std::vector<std::string>::const_iterator i(
+         std::lower_bound(terms.begin(), terms.end(), prefix));
+       i != terms.end() && i->compare(0, prefix.size(), prefix) == 0; ++i) {
+    postings(i - terms.begin(), part);
+    ids.insert(ids.end(), part.begin(), part.end());
+  }
+
+  sort_unique(ids);
+}
@@ -0,0 +1,162 @@
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+#include <boost/shared_ptr.hpp>
+
+#include "trace.h"
+
+std::atomic<bool> Trace::enabled(false);
+
+namespace {
+  struct Event {
+    const char* name;
+    const char* cat;
+    const char* arg_name;
+    uint64_t arg_value;
+    uint64_t begin;
+    uint64_t dur;
+  };
+
+  // one thread's spans, written only by that thread
+  struct Ring {
+    Ring(size_t capacity, uint32_t t): events(capacity), head(0), tid(t) {}
+
+    std::vector<Event> events;
+
+    // spans recorded, overwritten ones included
+    std::atomic<uint64_t> head;
+
+    uint32_t tid;
+  };
+
+  unsigned int sample = 1;
+  size_t capacity = 0;
+  std::chrono::steady_clock::time_point epoch;
+
+  // every thread's ring, kept past the thread for Trace::write
+  std::mutex rings_mutex;
+  std::vector<boost::shared_ptr<Ring> > rings;
+
+  thread_local Ring* ring = 0;
+
+  // whether the current item is sampled; outside items, everything is
+  thread_local bool in_sampled_item = true;
+  thread_local uint64_t items = 0;
+
+  // ns since the trace started, plus one, so 0 can mean not recording
+  uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - epoch
+    ).count() + 1;
+  }
+
+  Ring& this_ring() {
+    if (!ring) {
+      // once per thread
+      std::lock_guard<std::mutex> lock(rings_mutex);
+      rings.push_back(boost::shared_ptr<Ring>(new Ring(capacity, rings.size() + 1)));
+      ring = rings.back().get();
+    }
+
+    return *ring;
+  }
+
+  void record(const char* name, const char* cat, const char* arg_name, uint64_t arg_value, uint64_t begin) {
+    const uint64_t end = now();
+
+    Ring& r = this_ring();
+    const uint64_t h = r.head.load(std::memory_order_relaxed);
+
+    Event& e = r.events[h % r.events.size()];
+    e.name = name;
+    e.cat = cat;
+    e.arg_name = arg_name;
+    e.arg_value = arg_value;
+    e.begin = begin - 1;
+    e.dur = end - begin;
+
+    r.head.store(h + 1, std::memory_order_release);
+  }
+
+  // as microseconds, which is what the format wants
+  void write_us(std::ostream& out, uint64_t ns) {
+    const char frac[] = {
+      char('0' + ns / 100 % 10), char('0' + ns / 10 % 10), char('0' + ns % 10), 0
+    };
+    out << ns / 1000 << '.' << frac;
+  }
+}
+
+void Trace::start(unsigned int s, size_t c) {
+  sample = s ? s : 1;
+  capacity = c ? c : 1;
+  epoch = std::chrono::steady_clock::now();
+  enabled.store(true, std::memory_order_relaxed);
+}
+
+void Trace::write(std::ostream& out) {
+  const pid_t pid = getpid();
+  bool first = true;
+
+  out << "{\"traceEvents\":[";
+
+  std::lock_guard<std::mutex> lock(rings_mutex);
+  for (std::vector<boost::shared_ptr<Ring> >::const_iterator i(rings.begin()); i != rings.end(); ++i) {
+    const Ring& r = **i;
+    const uint64_t n = r.head.load(std::memory_order_acquire);
+    const uint64_t size = r.events.size();
+
+    // what is left of the oldest has been overwritten
+    for (uint64_t j = n > size ? n - size : 0; j < n; ++j) {
+      const Event& e = r.events[j % size];
+
+      out << (first ? "\n" : ",\n")
+          << "{\"name\":\"" << e.name << "\",\"cat\":\"" << e.cat
+          << "\",\"ph\":\"X\",\"ts\":";
+      write_us(out, e.begin);
+      out << ",\"dur\":";
+      write_us(out, e.dur);
+      out << ",\"pid\":" << pid << ",\"tid\":" << r.tid;
+
+      if (e.arg_name) {
+        out << ",\"args\":{\"" << e.arg_name << "\":" << e.arg_value << '}';
+      }
+
+      out << '}';
+      first = false;
+    }
+  }
+
+  out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
+
+void Trace_span::start() {
+  if (in_sampled_item) {
+    begin = now();
+  }
+}
+
+void Trace_span::finish() {
+  record(name, cat, arg_name, arg_value, begin);
+}
+
+void Trace_item_span::enter() {
+  active = true;
+  outer_sampled = in_sampled_item;
+
+  in_sampled_item = items++ % sample == 0;
+  if (in_sampled_item) {
+    begin = now();
+  }
+}
+
+void Trace_item_span::leave() {
+  if (begin) {
+    record("item", "walk", arg_name, arg_value, begin);
+  }
+
+  in_sampled_item = outer_sampled;
+}
@@ -0,0 +1,556 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// io_uring is used through its system calls, so the kernel's header is
+// all it takes to build; without it, opening a Uring_file fails
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define PSTRIP_IO_URING 1
+#endif
+
+#include "trace.h"
+#include "uring_file.h"
+
+#ifdef PSTRIP_IO_URING
+
+namespace {
+
+// the unit of reading and caching, which spans several PST pages
+const uint64_t CACHE_BLOCK_SIZE = 64 * 1024;
+
+// blocks cached, at least, and per read in flight
+const size_t MIN_CACHE_BLOCKS = 256;
+const size_t CACHE_BLOCKS_PER_READ = 4;
+
+std::runtime_error sys_error(const std::string& what, const char* filename) {
+  return std::runtime_error(
+    what + ' ' + filename + ": " + std::strerror(errno)
+  );
+}
+
+int io_uring_setup(unsigned int entries, io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int io_uring_enter(int ring, unsigned int to_submit, unsigned int min_complete, unsigned int flags) {
+  return syscall(__NR_io_uring_enter, ring, to_submit, min_complete, flags, 0, 0);
+}
+
+void* map_ring(int ring, size_t size, off_t offset) {
+  void* p = mmap(0, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring, offset);
+  return p == MAP_FAILED ? 0 : p;
+}
+
+unsigned int* field(void* ring, uint32_t offset) {
+  return reinterpret_cast<unsigned int*>(static_cast<uint8_t*>(ring) + offset);
+}
+
+}
+
+Uring_file::Uring_file(const char* filename, unsigned int d):
+  fd(-1), len(0), depth(d), ring(-1),
+  sq_ring(0), sq_ring_size(0), cq_ring(0), cq_ring_size(0), sqes(0), sqes_size(0),
+  sq_tail(0), sq_mask(0), sq_array(0), cq_head(0), cq_tail(0), cq_mask(0), cqes(0),
+  reaping(false), queued(0), in_flight(0), broken(0), buffer(0), clock(0)
+{
+  fd = open(filename, O_RDONLY | O_CLOEXEC);
+  if (fd == -1) {
+    throw sys_error("cannot open", filename);
+  }
+
+  // fstat reports no size for block devices, so seek to the end instead
+  const off_t end = lseek(fd, 0, SEEK_END);
+  if (end == -1) {
+    const int err = errno;
+    close_all();
+    errno = err;
+    throw sys_error("cannot size", filename);
+  }
+
+  len = end;
+
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+
+  ring = io_uring_setup(depth, &params);
+  if (ring == -1) {
+    const int err = errno;
+    close_all();
+    errno = err;
+    throw sys_error("cannot set up io_uring for", filename);
+  }
+
+  sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+  cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+
+  // newer kernels map both rings at once
+  if (params.features & IORING_FEAT_SINGLE_MMAP) {
+    sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+  }
+
+  sq_ring = map_ring(ring, sq_ring_size, IORING_OFF_SQ_RING);
+  cq_ring = (params.features & IORING_FEAT_SINGLE_MMAP) ? sq_ring : map_ring(ring, cq_ring_size, IORING_OFF_CQ_RING);
+  sqes = map_ring(ring, sqes_size, IORING_OFF_SQES);
+
+  if (!sq_ring || !cq_ring || !sqes) {
+    const int err = errno;
+    close_all();
+    errno = err;
+    throw sys_error("cannot map io_uring for", filename);
+  }
+
+  sq_tail = field(sq_ring, params.sq_off.tail);
+  sq_mask = field(sq_ring, params.sq_off.ring_mask);
+  sq_array = field(sq_ring, params.sq_off.array);
+  cq_head = field(cq_ring, params.cq_off.head);
+  cq_tail = field(cq_ring, params.cq_off.tail);
+  cq_mask = field(cq_ring, params.cq_off.ring_mask);
+  cqes = static_cast<uint8_t*>(cq_ring) + params.cq_off.cqes;
+
+  const size_t count = std::max(MIN_CACHE_BLOCKS, CACHE_BLOCKS_PER_READ * depth);
+
+  void* b = 0;
+  if (posix_memalign(&b, 4096, count * CACHE_BLOCK_SIZE) != 0) {
+    close_all();
+    throw std::bad_alloc();
+  }
+
+  buffer = static_cast<uint8_t*>(b);
+  blocks.resize(count);
+  iovecs.resize(count);
+
+  for (size_t i = 0; i < count; ++i) {
+    iovecs[i].iov_base = buffer + i * CACHE_BLOCK_SIZE;
+    iovecs[i].iov_len = CACHE_BLOCK_SIZE;
+  }
+}
+
+Uring_file::~Uring_file() {
+  // the kernel writes into the buffer until the reads are done
+  while (in_flight && !broken) {
+    if (io_uring_enter(ring, 0, 1, IORING_ENTER_GETEVENTS) == -1 && errno != EINTR) {
+      broken = errno;
+    }
+    reap();
+  }
+
+  close_all();
+}
+
+void Uring_file::close_all() {
+  if (sqes) {
+    munmap(sqes, sqes_size);
+  }
+
+  if (cq_ring && cq_ring != sq_ring) {
+    munmap(cq_ring, cq_ring_size);
+  }
+
+  if (sq_ring) {
+    munmap(sq_ring, sq_ring_size);
+  }
+
+  if (ring != -1) {
+    close(ring);
+  }
+
+  if (fd != -1) {
+    close(fd);
+  }
+
+  // if the reads could not be waited for, the kernel may yet write here
+  if (!in_flight) {
+    free(buffer);
+  }
+}
+
+ssize_t Uring_file::read(Stream& stream, uint64_t offset, uint8_t* buf, size_t size) {
+  if (offset >= len) {
+    return 0;
+  }
+
+  size = std::min<uint64_t>(size, len - offset);
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  // take in what has completed since, to make room in the queue, unless
+  // a thread waiting for completions is about to
+  if (!reaping) {
+    reap();
+  }
+
+  size_t done = 0;
+  while (done < size) {
+    const uint64_t pos = offset + done;
+    const uint64_t index = pos / CACHE_BLOCK_SIZE;
+
+    long slot = find(index);
+    read_ahead(stream, index, slot >= 0);
+
+    while ((slot = find(index)) < 0 || blocks[slot].state != Block::READY) {
+      if (broken) {
+        errno = broken;
+        return -1;
+      }
+
+      // the queue may be full, or the block evicted while waiting
+      if (slot < 0) {
+        submit(index);
+      }
+
+      flush();
+      if (!broken) {
+        wait(lock);
+      }
+    }
+
+    Block& block = blocks[slot];
+    const size_t at = pos - index * CACHE_BLOCK_SIZE;
+
+    if (block.error || at >= block.length) {
+      // forget the block, so that the read can be tried again
+      errno = block.error ? block.error : EIO;
+      slots.erase(index);
+      block.state = Block::EMPTY;
+      return -1;
+    }
+
+    const size_t n = std::min(size - done, block.length - at);
+    std::memcpy(buf + done, buffer + slot * CACHE_BLOCK_SIZE + at, n);
+    block.used = ++clock;
+    done += n;
+  }
+
+  return done;
+}
+
+long Uring_file::find(uint64_t index) const {
+  std::unordered_map<uint64_t, size_t>::const_iterator i(slots.find(index));
+  return i == slots.end() ? -1 : (long) i->second;
+}
+
+void Uring_file::read_ahead(Stream& stream, uint64_t index, bool hit) {
+  uint64_t from;
+
+  if (hit) {
+    // halfway through the window, read the next one, twice as big
+    if (!stream.window || index >= stream.next || index + stream.window / 2 < stream.next) {
+      return;
+    }
+
+    from = stream.next;
+    stream.window = std::min(2 * stream.window, depth);
+  }
+  else {
+    // reading on from the window grows it; jumping elsewhere resets it
+    stream.window = stream.window && index == stream.next ? std::min(2 * stream.window, depth) : 1;
+    from = index;
+  }
+
+  const uint64_t blocks_in_file = (len + CACHE_BLOCK_SIZE - 1) / CACHE_BLOCK_SIZE;
+  const uint64_t to = std::min(from + stream.window, blocks_in_file);
+
+  for (uint64_t i = from; i < to && submit(i); ++i) {
+    stream.next = i + 1;
+  }
+
+  flush();
+}
+
+bool Uring_file::submit(uint64_t index) {
+  if (find(index) >= 0) {
+    return true;
+  }
+
+  if (broken || in_flight + queued >= depth) {
+    return false;
+  }
+
+  // an empty slot, or else the one read longest ago; there are more
+  // slots than reads in flight, so there is always one
+  size_t victim = 0;
+  for (size_t i = 0; i < blocks.size(); ++i) {
+    if (blocks[i].state == Block::EMPTY) {
+      victim = i;
+      break;
+    }
+
+    if (blocks[i].state == Block::READY &&
+        (blocks[victim].state != Block::READY || blocks[i].used < blocks[victim].used))
+    {
+      victim = i;
+    }
+  }
+
+  Block& block = blocks[victim];
+  if (block.state == Block::READY) {
+    slots.erase(block.index);
+  }
+
+  block.index = index;
+  block.state = Block::PENDING;
+  block.length = 0;
+  block.error = 0;
+  // as if read now, so that it isn't evicted before it is
+  block.used = ++clock;
+  slots[index] = victim;
+
+  const unsigned int tail = *sq_tail;
+  const unsigned int at = tail & *sq_mask;
+
+  io_uring_sqe* sqe = static_cast<io_uring_sqe*>(sqes) + at;
+  std::memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_READV;
+  sqe->fd = fd;
+  sqe->off = index * CACHE_BLOCK_SIZE;
+  sqe->addr = reinterpret_cast<uintptr_t>(&iovecs[victim]);
+  sqe->len = 1;
+  sqe->user_data = victim;
+
+  sq_array[at] = at;
+  __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+  ++queued;
+  return true;
+}
+
+void Uring_file::flush() {
+  while (queued && !broken) {
+    const int ret = io_uring_enter(ring, queued, 0, 0);
+
+    if (ret >= 0) {
+      queued -= ret;
+      in_flight += ret;
+    }
+    else if (errno == EAGAIN || errno == EBUSY) {
+      // out of resources for now; reads in flight will free some
+      if (!in_flight) {
+        broken = errno;
+      }
+      return;
+    }
+    else if (errno != EINTR) {
+      // what is queued can't be taken back, so the ring is unusable
+      broken = errno;
+    }
+  }
+}
+
+void Uring_file::wait(std::unique_lock<std::mutex>& lock) {
+  if (reaping) {
+    reaped.wait(lock);
+    return;
+  }
+
+  if (!in_flight) {
+    // a read could not be submitted, for want of resources
+    flush();
+    if (!in_flight) {
+      broken = broken ? broken : EAGAIN;
+      return;
+    }
+  }
+
+  reaping = true;
+  lock.unlock();
+
+  Trace_span span("io_uring wait", "read");
+  const int ret = io_uring_enter(ring, 0, 1, IORING_ENTER_GETEVENTS);
+  const int err = errno;
+  span.end();
+
+  lock.lock();
+  reaping = false;
+
+  if (ret == -1 && err != EINTR) {
+    broken = err;
+  }
+
+  reap();
+  reaped.notify_all();
+}
+
+void Uring_file::reap() {
+  unsigned int head = *cq_head;
+  const unsigned int tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; ++head) {
+    const io_uring_cqe* cqe = static_cast<const io_uring_cqe*>(cqes) + (head & *cq_mask);
+    Block& block = blocks[cqe->user_data];
+
+    block.state = Block::READY;
+    if (cqe->res < 0) {
+      block.error = -cqe->res;
+    }
+    else {
+      block.length = cqe->res;
+    }
+
+    --in_flight;
+  }
+
+  __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+#else
+
+Uring_file::Uring_file(const char*, unsigned int) {
+  throw std::runtime_error("this build has no io_uring support");
+}
+
+Uring_file::~Uring_file() {
+}
+
+ssize_t Uring_file::read(Stream&, uint64_t, uint8_t*, size_t) {
+  errno = ENOSYS;
+  return -1;
+}
+
+#endif
+
+//
+// libbfio io handle callbacks
+//
+
+namespace {
+
+struct Uring_io {
+  Uring_io(const UringFilePtr& f): file(f), offset(0), is_open(false) {}
+
+  UringFilePtr file;
+  Uring_file::Stream stream;
+  off64_t offset;
+  bool is_open;
+};
+
+Uring_io* io(intptr_t* io_handle) {
+  return reinterpret_cast<Uring_io*>(io_handle);
+}
+
+int uring_free(intptr_t** io_handle, libbfio_error_t**) {
+  delete io(*io_handle);
+  *io_handle = 0;
+  return 1;
+}
+
+int uring_clone(intptr_t** dst, intptr_t* src, libbfio_error_t**) {
+  *dst = reinterpret_cast<intptr_t*>(new Uring_io(io(src)->file));
+  return 1;
+}
+
+int uring_open(intptr_t* io_handle, int access_flags, libbfio_error_t**) {
+  if (access_flags & LIBBFIO_ACCESS_FLAG_WRITE) {
+    return -1;
+  }
+
+  io(io_handle)->offset = 0;
+  io(io_handle)->is_open = true;
+  return 1;
+}
+
+int uring_close(intptr_t* io_handle, libbfio_error_t**) {
+  io(io_handle)->is_open = false;
+  return 0;
+}
+
+ssize_t uring_read(intptr_t* io_handle, uint8_t* buf, size_t size,
+                   libbfio_error_t**)
+{
+  Uring_io* u = io(io_handle);
+
+  if (!u->is_open || u->offset < 0) {
+    return -1;
+  }
+
+  const ssize_t n = u->file->read(u->stream, u->offset, buf, size);
+  if (n > 0) {
+    u->offset += n;
+  }
+
+  return n;
+}
+
+ssize_t uring_write(intptr_t*, const uint8_t*, size_t, libbfio_error_t**) {
+  return -1;
+}
+
+off64_t uring_seek(intptr_t* io_handle, off64_t offset, int whence,
+                   libbfio_error_t**)
+{
+  Uring_io* u = io(io_handle);
+
+  switch (whence) {
+  case SEEK_SET:
+    break;
+  case SEEK_CUR:
+    offset += u->offset;
+    break;
+  case SEEK_END:
+    offset += u->file->size();
+    break;
+  default:
+    return -1;
+  }
+
+  if (offset < 0) {
+    return -1;
+  }
+
+  u->offset = offset;
+  return offset;
+}
+
+int uring_exists(intptr_t*, libbfio_error_t**) {
+  return 1;
+}
+
+int uring_is_open(intptr_t* io_handle, libbfio_error_t**) {
+  return io(io_handle)->is_open ? 1 : 0;
+}
+
+int uring_get_size(intptr_t* io_handle, size64_t* size, libbfio_error_t**) {
+  *size = io(io_handle)->file->size();
+  return 1;
+}
+
+}
+
+libbfio_handle_t* create_uring_handle(const UringFilePtr& file) {
+  Uring_io* u = new Uring_io(file);
+
+  libbfio_handle_t* handle = 0;
+  libbfio_error_t* error = 0;
+
+  if (libbfio_handle_initialize(
+    &handle,
+    reinterpret_cast<intptr_t*>(u),
+    &uring_free,
+    &uring_clone,
+    &uring_open,
+    &uring_close,
+    &uring_read,
+    &uring_write,
+    &uring_seek,
+    &uring_exists,
+    &uring_is_open,
+    &uring_get_size,
+    LIBBFIO_FLAG_IO_HANDLE_MANAGED | LIBBFIO_FLAG_IO_HANDLE_CLONE_BY_FUNCTION,
+    &error) != 1)
+  {
+    libbfio_error_free(&error);
+    delete u;
+    throw std::runtime_error("cannot create libbfio handle");
+  }
+
+  return handle;
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "json_writer.h"
+#include "utf16.h"
+
+namespace {
+  // code units converted per chunk, into a buffer on the stack
+  const size_t CHUNK = 1024;
+
+  // the most a code unit becomes, \u001F in JSON, and the most a SIMD
+  // store writes past the output
+  const size_t MAX_JSON = 6;
+  const size_t MAX_UTF8 = 3;
+  const size_t SLACK = 8;
+
+  const char REPLACEMENT[] = "\xEF\xBF\xBD";
+
+  uint16_t unit(const uint8_t* p) {
+    return p[0] | p[1] << 8;
+  }
+
+#ifdef __SSE2__
+  // Writes the 8 code units at p to out as bytes, and returns how many of
+  // them, from the first, are ASCII and not NUL, and if json, need no
+  // escaping; the rest of what is written is to be overwritten.
+  unsigned int ascii_run(const uint8_t* p, bool json, char* out) {
+    const __m128i v = _mm_loadu_si128((const __m128i*) p);
+    const __m128i zero = _mm_setzero_si128();
+
+    __m128i bad = _mm_or_si128(
+      _mm_andnot_si128(
+        _mm_cmpeq_epi16(_mm_and_si128(v, _mm_set1_epi16((short) 0xFF80)), zero),
+        _mm_set1_epi16(-1)
+      ),
+      _mm_cmpeq_epi16(v, zero)
+    );
+
+    if (json) {
+      bad = _mm_or_si128(bad, _mm_cmplt_epi16(v, _mm_set1_epi16(0x20)));
+      bad = _mm_or_si128(bad, _mm_cmpeq_epi16(v, _mm_set1_epi16('"')));
+      bad = _mm_or_si128(bad, _mm_cmpeq_epi16(v, _mm_set1_epi16('\\')));
+    }
+
+    _mm_storel_epi64((__m128i*) out, _mm_packus_epi16(v, v));
+
+    const unsigned int mask = _mm_movemask_epi8(bad);
+    return mask ? __builtin_ctz(mask) / 2 : 8;
+  }
+#endif
+
+  //
+  // Converts code units from p up to limit, into out, which must have
+  // room for MAX_JSON or MAX_UTF8 bytes per unit, and SLACK. A surrogate
+  // pair may straddle limit, but not end. Stops after limit, or at a NUL,
+  // setting done; returns the end of the output.
+  //
+  char* convert(const uint8_t*& p, const uint8_t* limit, const uint8_t* end, bool json, char* out, bool& done) {
+    while (limit - p >= 2) {
+#ifdef __SSE2__
+      if (limit - p >= 16) {
+        const unsigned int n = ascii_run(p, json, out);
+        out += n;
+        p += 2 * n;
+        if (n == 8) {
+          continue;
+        }
+      }
+#endif
+
+      const uint16_t u = unit(p);
+      p += 2;
+
+      if (u < 0x80) {
+        if (u == 0) {
+          done = true;
+          return out;
+        }
+
+        const size_t n = json ? json_escape(u, out) : 0;
+        if (n) {
+          out += n;
+        }
+        else {
+          *out++ = u;
+        }
+      }
+      else if (u < 0x800) {
+        *out++ = 0xC0 | u >> 6;
+        *out++ = 0x80 | (u & 0x3F);
+      }
+      else if (u >= 0xD800 && u <= 0xDBFF && end - p >= 2 && unit(p) >= 0xDC00 && unit(p) <= 0xDFFF) {
+        const uint32_t cp = 0x10000 + ((u - 0xD800) << 10) + (unit(p) - 0xDC00);
+        p += 2;
+
+        *out++ = 0xF0 | cp >> 18;
+        *out++ = 0x80 | (cp >> 12 & 0x3F);
+        *out++ = 0x80 | (cp >> 6 & 0x3F);
+        *out++ = 0x80 | (cp & 0x3F);
+      }
+      else if (u >= 0xD800 && u <= 0xDFFF) {
+        out = std::copy(REPLACEMENT, REPLACEMENT + 3, out);
+      }
+      else {
+        *out++ = 0xE0 | u >> 12;
+        *out++ = 0x80 | (u >> 6 & 0x3F);
+        *out++ = 0x80 | (u & 0x3F);
+      }
+    }
+
+    return out;
+  }
+}
+
+size_t utf16le_to_utf8(const uint8_t* in, size_t size, std::vector<uint8_t>& out) {
+  const size_t old = out.size();
+  out.resize(old + size / 2 * MAX_UTF8 + 3 + SLACK);
+
+  const uint8_t* p = in;
+  const uint8_t* end = in + size;
+  bool done = false;
+
+  char* begin = (char*) out.data() + old;
+  char* o = convert(p, in + (size & ~(size_t) 1), end, false, begin, done);
+
+  if (!done && p < end) {
+    o = std::copy(REPLACEMENT, REPLACEMENT + 3, o);
+  }
+
+  out.resize(old + (o - begin));
+  return o - begin;
+}
+
+void write_json_utf16le(std::ostream& out, const uint8_t* in, size_t size) {
+  char buf[CHUNK * MAX_JSON + SLACK];
+
+  const uint8_t* p = in;
+  const uint8_t* even = in + (size & ~(size_t) 1);
+  const uint8_t* end = in + size;
+  bool done = false;
+
+  out << '"';
+
+  while (!done && p < even) {
+    const uint8_t* limit = p + std::min((size_t) (even - p), 2 * CHUNK);
+    out.write(buf, convert(p, limit, end, true, buf, done) - buf);
+  }
+
+  if (!done && p < end) {
+    out.write(REPLACEMENT, 3);
+  }
+
+  out << '"';
+}
+
+bool is_ascii(const uint8_t* in, size_t size) {
+  size_t i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= size; i += 16) {
+    if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i*) (in + i)))) {
+      return false;
+    }
+  }
+#endif
+
+  for (; i < size; ++i) {
+    if (in[i] & 0x80) {
+      return false;
+    }
+  }
+
+  return true;
+}